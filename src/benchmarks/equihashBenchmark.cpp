@@ -0,0 +1,167 @@
+// Equihash (200,9) share check: reference Zcash code (previous implementation) vs CEquihashVerifier
+// Vectors are serialized block headers with solution, one per line in hex ('#' starts comment line)
+// Default vector file contains solver generated headers; mainnet headers can be exported by
+// 'zcash-cli getblockheader <hash> false' and passed as first argument
+// Every vector and its mutations checked by both implementations, any mismatch fails benchmark
+
+#include "blockmaker/equihash.h"
+#include "poolcommon/hex.h"
+#include "equihashReference.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static constexpr size_t InputSize = 140;
+static constexpr size_t SolutionSize = CEquihashVerifier<200, 9>::SolutionWidth;
+// Header without solution, compact size of solution (0xFD 0x40 0x05), solution
+static constexpr size_t HeaderSize = InputSize + 3 + SolutionSize;
+
+struct CTestCase {
+  std::vector<uint8_t> Input;
+  std::vector<uint8_t> Solution;
+  bool Valid;
+};
+
+static bool referenceVerify(const CTestCase &testCase)
+{
+  static EquihashReference::Equihash<200, 9> equihash;
+  crypto_generichash_blake2b_state state;
+  equihash.InitialiseState(state);
+  crypto_generichash_blake2b_update(&state, testCase.Input.data(), testCase.Input.size());
+  std::vector<unsigned char> solution(testCase.Solution);
+  return equihash.IsValidSolution(state, solution);
+}
+
+static bool verify(const CTestCase &testCase)
+{
+  return CEquihashVerifier<200, 9>::verify(testCase.Input.data(), testCase.Input.size(), testCase.Solution.data(), testCase.Solution.size());
+}
+
+static bool loadVectors(const char *path, std::vector<CTestCase> &cases)
+{
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+
+  std::string line;
+  unsigned lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+      line.pop_back();
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    uint8_t header[HeaderSize];
+    if (line.size() != HeaderSize*2 || !hexDecode(line.data(), line.size(), header) ||
+        header[InputSize] != 0xFD || header[InputSize+1] != (SolutionSize & 0xFF) || header[InputSize+2] != (SolutionSize >> 8)) {
+      fprintf(stderr, "%s:%u: invalid block header\n", path, lineNumber);
+      return false;
+    }
+
+    CTestCase testCase;
+    testCase.Input.assign(header, header + InputSize);
+    testCase.Solution.assign(header + InputSize + 3, header + HeaderSize);
+    testCase.Valid = true;
+    cases.push_back(std::move(testCase));
+  }
+
+  return true;
+}
+
+// Invalid solutions: changed solution bit, swapped indices, changed header
+static void addMutations(const CTestCase &source, std::vector<CTestCase> &cases)
+{
+  for (unsigned i = 0; i < 8; i++) {
+    CTestCase testCase = source;
+    testCase.Solution[(i * 167 + 11) % SolutionSize] ^= 1u << (i % 8);
+    testCase.Valid = false;
+    cases.push_back(std::move(testCase));
+  }
+
+  {
+    // First two indices (21 bits each) exchanged, breaks ordering
+    CTestCase testCase = source;
+    uint64_t bits = 0;
+    for (unsigned i = 0; i < 6; i++)
+      bits = (bits << 8) | testCase.Solution[i];
+    uint64_t first = (bits >> 27) & 0x1FFFFF;
+    uint64_t second = (bits >> 6) & 0x1FFFFF;
+    bits = (bits & 0x3F) | (second << 27) | (first << 6);
+    for (unsigned i = 0; i < 6; i++)
+      testCase.Solution[i] = static_cast<uint8_t>(bits >> (8 * (5 - i)));
+    testCase.Valid = false;
+    cases.push_back(std::move(testCase));
+  }
+
+  {
+    CTestCase testCase = source;
+    testCase.Input[InputSize - 1] ^= 0x80;
+    testCase.Valid = false;
+    cases.push_back(std::move(testCase));
+  }
+}
+
+template<typename Function>
+static double measure(const std::vector<const CTestCase*> &cases, unsigned iterations, Function function)
+{
+  volatile unsigned sink = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    for (const CTestCase *testCase: cases)
+      sink = sink + function(*testCase);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+  return static_cast<double>(elapsed) / (1000.0 * iterations * cases.size());
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = argc >= 2 ? argv[1] : EQUIHASH_VECTORS_PATH;
+  std::vector<CTestCase> vectors;
+  if (!loadVectors(path, vectors))
+    return 1;
+  if (vectors.empty()) {
+    fprintf(stderr, "%s: no block headers\n", path);
+    return 1;
+  }
+
+  std::vector<CTestCase> cases;
+  for (const CTestCase &testCase: vectors) {
+    cases.push_back(testCase);
+    addMutations(testCase, cases);
+  }
+
+  unsigned mismatches = 0;
+  std::vector<const CTestCase*> validCases;
+  std::vector<const CTestCase*> invalidCases;
+  for (size_t i = 0; i < cases.size(); i++) {
+    const CTestCase &testCase = cases[i];
+    bool referenceResult = referenceVerify(testCase);
+    bool result = verify(testCase);
+    if (referenceResult != result || referenceResult != testCase.Valid) {
+      fprintf(stderr, "case %zu: expected %s, reference %s, verifier %s\n",
+              i, testCase.Valid ? "valid" : "invalid", referenceResult ? "valid" : "invalid", result ? "valid" : "invalid");
+      mismatches++;
+    }
+
+    (testCase.Valid ? validCases : invalidCases).push_back(&testCase);
+  }
+
+  if (mismatches) {
+    fprintf(stderr, "%u mismatches in %zu cases\n", mismatches, cases.size());
+    return 1;
+  }
+
+  printf("%zu block headers, %zu cases, results identical\n", vectors.size(), cases.size());
+  printf("%10s %14s %14s\n", "solutions", "reference", "verifier");
+  printf("%10s %11.2f us %11.2f us\n", "valid", measure(validCases, 20, referenceVerify), measure(validCases, 20, verify));
+  printf("%10s %11.2f us %11.2f us\n", "invalid", measure(invalidCases, 20, referenceVerify), measure(invalidCases, 20, verify));
+  return 0;
+}
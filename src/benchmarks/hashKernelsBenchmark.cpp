@@ -0,0 +1,140 @@
+// DGB Qubit chain functions: sph_* (previous implementation) vs selected hash kernels
+// Every kernel is checked against sph_* output first: fixed patterns (zero, 0xFF, counter, single bits)
+// and pseudo random inputs; Luffa also for input sizes 0..200. Any mismatch fails benchmark
+
+#include "blockmaker/hashKernels.h"
+#include "blockmaker/sph_luffa.h"
+#include "blockmaker/sph_cubehash.h"
+#include "blockmaker/sph_shavite.h"
+#include "blockmaker/sph_simd.h"
+#include "blockmaker/sph_echo.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+template<typename Context, void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+static void sphHash(const void *input, size_t size, void *output)
+{
+  Context ctx;
+  Init(&ctx);
+  Update(&ctx, input, size);
+  Close(&ctx, output);
+}
+
+struct CKernel {
+  const char *Name;
+  void (*Reference)(const void *input, size_t size, void *output);
+  void (*Kernel)(const void *input, size_t size, void *output);
+  // Input size of share check (80-byte header for Luffa, previous hash for others)
+  size_t Size;
+  bool VariableSize;
+};
+
+static void luffa512(const void *input, size_t size, void *output) { hashKernels().Luffa512(input, size, output); }
+static void cubehash512(const void *input, size_t, void *output) { hashKernels().CubeHash512(input, output); }
+static void shavite512(const void *input, size_t, void *output) { hashKernels().Shavite512(input, output); }
+static void simd512(const void *input, size_t, void *output) { hashKernels().Simd512(input, output); }
+static void echo512(const void *input, size_t, void *output) { hashKernels().Echo512(input, output); }
+
+static const CKernel Kernels[] = {
+  {"luffa", sphHash<sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close>, luffa512, 80, true},
+  {"cubehash", sphHash<sph_cubehash512_context, sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>, cubehash512, 64, false},
+  {"shavite", sphHash<sph_shavite512_context, sph_shavite512_init, sph_shavite512, sph_shavite512_close>, shavite512, 64, false},
+  {"simd", sphHash<sph_simd512_context, sph_simd512_init, sph_simd512, sph_simd512_close>, simd512, 64, false},
+  {"echo", sphHash<sph_echo512_context, sph_echo512_init, sph_echo512, sph_echo512_close>, echo512, 64, false}
+};
+
+static constexpr size_t MaxInputSize = 200;
+
+// Input of first mismatches printed
+static void check(const CKernel &kernel, const uint8_t *input, size_t size, unsigned &mismatches)
+{
+  uint8_t expected[64];
+  uint8_t result[64];
+  kernel.Reference(input, size, expected);
+  kernel.Kernel(input, size, result);
+  if (memcmp(expected, result, sizeof(result)) == 0)
+    return;
+
+  if (mismatches++ < 4) {
+    fprintf(stderr, "%s: mismatch for %zu bytes input: ", kernel.Name, size);
+    for (size_t i = 0; i < size; i++)
+      fprintf(stderr, "%02x", input[i]);
+    fprintf(stderr, "\n");
+  }
+}
+
+static unsigned checkKernel(const CKernel &kernel, std::mt19937 &random)
+{
+  std::vector<size_t> sizes;
+  if (kernel.VariableSize) {
+    for (size_t size = 0; size <= MaxInputSize; size++)
+      sizes.push_back(size);
+  } else {
+    sizes.push_back(kernel.Size);
+  }
+
+  unsigned mismatches = 0;
+  uint8_t input[MaxInputSize];
+  for (size_t size: sizes) {
+    memset(input, 0, sizeof(input));
+    check(kernel, input, size, mismatches);
+    memset(input, 0xFF, sizeof(input));
+    check(kernel, input, size, mismatches);
+    for (size_t i = 0; i < sizeof(input); i++)
+      input[i] = static_cast<uint8_t>(i);
+    check(kernel, input, size, mismatches);
+    for (size_t bit = 0; bit < size*8; bit += 7) {
+      memset(input, 0, sizeof(input));
+      input[bit / 8] = 1 << (bit % 8);
+      check(kernel, input, size, mismatches);
+    }
+    for (unsigned i = 0; i < 1000; i++) {
+      for (auto &byte: input)
+        byte = static_cast<uint8_t>(random());
+      check(kernel, input, size, mismatches);
+    }
+  }
+
+  return mismatches;
+}
+
+template<typename Function>
+static double measure(unsigned iterations, Function function)
+{
+  auto begin = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < iterations; i++)
+    function();
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+  return static_cast<double>(elapsed) / iterations;
+}
+
+int main()
+{
+  printf("implementation: %s\n", hashKernels().Description);
+
+  std::mt19937 random(1);
+  unsigned mismatches = 0;
+  for (const CKernel &kernel: Kernels)
+    mismatches += checkKernel(kernel, random);
+  if (mismatches) {
+    fprintf(stderr, "%u mismatches\n", mismatches);
+    return 1;
+  }
+
+  printf("all kernels match sph\n");
+  printf("%10s %6s %11s %11s\n", "function", "bytes", "sph", "kernel");
+  for (const CKernel &kernel: Kernels) {
+    // Output of previous call is input of next one, as in chained hash
+    uint8_t data[80] = {};
+    uint8_t output[64];
+    double reference = measure(100000, [&]() { kernel.Reference(data, kernel.Size, output); memcpy(data, output, sizeof(output)); });
+    double selected = measure(100000, [&]() { kernel.Kernel(data, kernel.Size, output); memcpy(data, output, sizeof(output)); });
+    printf("%10s %6zu %8.0f ns %8.0f ns\n", kernel.Name, kernel.Size, reference, selected);
+  }
+
+  return 0;
+}
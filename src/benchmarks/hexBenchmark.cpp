@@ -0,0 +1,78 @@
+// Hex encoding and decoding throughput: byte loop (previous implementation) vs selected implementation
+// Sizes cover stratum fields (32-byte hashes, 80-byte headers), coinbase transactions and full blocks
+
+#include "poolcommon/hex.h"
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint8_t hexDigit2binLoop(char c)
+{
+  uint8_t digit = c - '0';
+  if (digit >= 10)
+    digit -= ('A' - '0' - 10);
+  if (digit >= 16)
+    digit -= ('a' - 'A');
+  return digit;
+}
+
+static void hexEncodeLoop(const void *in, char *out, size_t size)
+{
+  const uint8_t *pIn = static_cast<const uint8_t*>(in);
+  for (size_t i = 0; i < size; i++) {
+    out[i*2] = (pIn[i] >> 4) < 10 ? '0' + (pIn[i] >> 4) : 'a' + (pIn[i] >> 4) - 10;
+    out[i*2+1] = (pIn[i] & 0xF) < 10 ? '0' + (pIn[i] & 0xF) : 'a' + (pIn[i] & 0xF) - 10;
+  }
+}
+
+static bool hexDecodeLoop(const char *in, size_t inSize, void *out)
+{
+  uint8_t *pOut = static_cast<uint8_t*>(out);
+  for (size_t i = 0; i < inSize/2; i++)
+    pOut[i] = (hexDigit2binLoop(in[i*2]) << 4) | hexDigit2binLoop(in[i*2+1]);
+  return true;
+}
+
+template<typename Function>
+static double measure(size_t size, Function function)
+{
+  // At least 64MB processed for every size
+  size_t iterations = (64u << 20) / size + 1;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++)
+    function();
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+  return static_cast<double>(elapsed) / (static_cast<double>(iterations) * size);
+}
+
+int main()
+{
+  static const size_t sizes[] = {4, 32, 80, 256, 4096, 1u << 20};
+  printf("implementation: %s\n", hexImplementation());
+  printf("%10s %14s %14s %14s %14s\n", "bytes", "encode loop", "encode", "decode loop", "decode");
+
+  std::vector<uint8_t> data(sizes[sizeof(sizes)/sizeof(sizes[0]) - 1]);
+  std::vector<uint8_t> decoded(data.size());
+  std::vector<char> hex(data.size() * 2);
+  for (auto &byte: data)
+    byte = static_cast<uint8_t>(rand());
+
+  volatile uint8_t sink = 0;
+  for (size_t size: sizes) {
+    double encodeLoop = measure(size, [&]() { hexEncodeLoop(data.data(), hex.data(), size); sink = sink + hex[size]; });
+    double encode = measure(size, [&]() { hexEncode(data.data(), hex.data(), size); sink = sink + hex[size]; });
+    double decodeLoop = measure(size, [&]() { hexDecodeLoop(hex.data(), size*2, decoded.data()); sink = sink + decoded[size/2]; });
+    double decode = measure(size, [&]() { sink = sink + hexDecode(hex.data(), size*2, decoded.data()); });
+    if (memcmp(decoded.data(), data.data(), size) != 0) {
+      fprintf(stderr, "decode mismatch at size %zu\n", size);
+      return 1;
+    }
+
+    printf("%10zu %11.3f ns %11.3f ns %11.3f ns %11.3f ns\n", size, encodeLoop, encode, decodeLoop, decode);
+  }
+
+  return 0;
+}
@@ -141,14 +141,18 @@ size_t Proto::Transaction::getFirstScriptSigOffset(bool serializeWitness)
   return result;
 }
 
-bool Proto::checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, ChainParams&, double *shareDiff)
+bool Proto::checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, ChainParams&, double *shareDiff, const arith_uint256 *shareTarget)
 {
+  arith_uint256 hash = UintToArith256(header.GetHash());
+  if (shareTarget && hash.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   bool fNegative;
   bool fOverflow;
   arith_uint256 bnTarget;
   bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
-
-  arith_uint256 hash = UintToArith256(header.GetHash());
   *shareDiff = difficultyFromBits(hash.GetCompact(), 29);
 
   // Check range
@@ -398,12 +402,12 @@ void Stratum::Notify::build(CWork *source, typename Proto::BlockHeader &header,
 
       // Previous block
       {
-        std::string hash;
+        // Stratum sends hash as 32-bit words with swapped bytes
+        uint32_t hash[8];
         const uint32_t *data = reinterpret_cast<const uint32_t*>(header.hashPrevBlock.begin());
-        for (unsigned i = 0; i < 8; i++) {
-          hash.append(writeHexBE(data[i], 4));
-        }
-        params.addString(hash);
+        for (unsigned i = 0; i < 8; i++)
+          hash[i] = xswap(data[i]);
+        params.addHex(hash, sizeof(hash));
       }
 
       {
@@ -459,8 +463,8 @@ bool Stratum::Prepare::prepare(BTC::Proto::BlockHeader &header, uint32_t jobVers
     memcpy(scriptSig + miningCfg.FixedExtraNonceSize, msg.Submit.MutableExtraNonce.data(), msg.Submit.MutableExtraNonce.size());
   }
 
-  // Calculate merkle root and build header
-  header.hashMerkleRoot = calculateMerkleRoot(legacy.Data.data(), legacy.Data.sizeOf(), merklePath);
+  // Calculate merkle root and build header, coinbase prefix before extra nonce hashed once per work
+  header.hashMerkleRoot = calculateMerkleRoot(legacy.Midstate, legacy.MidstateSize, legacy.Data.data(), legacy.Data.sizeOf(), merklePath);
   header.nTime = msg.Submit.Time;
   header.nNonce = msg.Submit.Nonce;
   if (workerCfg.AsicBoostEnabled)
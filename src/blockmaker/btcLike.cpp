@@ -73,7 +73,8 @@ EStratumDecodeStatusTy StratumMessage::decodeStratumMessage(const char *in, size
       {
         // extra nonce mutable part
         Submit.MutableExtraNonce.resize(params[2].GetStringLength() / 2);
-        hex2bin(params[2].GetString(), params[2].GetStringLength(), Submit.MutableExtraNonce.data());
+        if (!hex2bin(params[2].GetString(), params[2].GetStringLength(), Submit.MutableExtraNonce.data()))
+          return EStratumStatusFormatError;
       }
       Submit.Time = readHexBE<uint32_t>(params[3].GetString(), 4);
       Submit.Nonce = readHexBE<uint32_t>(params[4].GetString(), 4);
@@ -219,7 +220,10 @@ bool calculateWitnessCommitment(rapidjson::Value &blockTemplate, bool txFilter,
   rapidjson::SizeType originalWitnessCommitmentSize = blockTemplate["default_witness_commitment"].GetStringLength();
 
   if (!txFilter) {
-    hex2bin(originalWitnessCommitment, originalWitnessCommitmentSize, witnessCommitment.reserve(originalWitnessCommitmentSize/2));
+    if (!hex2bin(originalWitnessCommitment, originalWitnessCommitmentSize, witnessCommitment.reserve(originalWitnessCommitmentSize/2))) {
+      error = "default_witness_commitment invalid";
+      return false;
+    }
   } else {
     // Collect witness hashes to array
     std::vector<uint256> witnessHashes;
@@ -1,11 +1,7 @@
 #include "poolcommon/arith_uint256.h"
 #include "blockmaker/dgb.h"
 #include "blockmaker/sph_skein.h"
-#include "blockmaker/sph_luffa.h"
-#include "blockmaker/sph_cubehash.h"
-#include "blockmaker/sph_shavite.h"
-#include "blockmaker/sph_simd.h"
-#include "blockmaker/sph_echo.h"
+#include "blockmaker/hashKernels.h"
 #include "blockmaker/odocrypt.h"
 #include "blockmaker/KeccakP-800-SnP.h"
 
@@ -17,38 +13,25 @@ static uint32_t OdoKey(uint32_t nOdoShapechangeInterval, uint32_t nTime)
 
 namespace DGB {
 
-template<> bool Proto<DGB::Algo::EQubit>::checkConsensus(const Proto<DGB::Algo::EQubit>::BlockHeader &header, CheckConsensusCtx&, DGB::Proto<DGB::Algo::EQubit>::ChainParams&, double *shareDiff)
+template<> bool Proto<DGB::Algo::EQubit>::checkConsensus(const Proto<DGB::Algo::EQubit>::BlockHeader &header, CheckConsensusCtx&, DGB::Proto<DGB::Algo::EQubit>::ChainParams&, double *shareDiff, const arith_uint256 *shareTarget)
 {
   arith_uint256 result;
-  sph_luffa512_context	 ctx_luffa;
-  sph_cubehash512_context  ctx_cubehash;
-  sph_shavite512_context	 ctx_shavite;
-  sph_simd512_context		 ctx_simd;
-  sph_echo512_context		 ctx_echo;
   uint512 hash[5];
+  const CHashKernels &kernels = hashKernels();
 
-  sph_luffa512_init(&ctx_luffa);
-  sph_luffa512(&ctx_luffa, &header, sizeof(Proto<DGB::Algo::ESkein>::BlockHeader));
-  sph_luffa512_close(&ctx_luffa, &hash[0]);
-
-  sph_cubehash512_init(&ctx_cubehash);
-  sph_cubehash512 (&ctx_cubehash, static_cast<const void*>(&hash[0]), 64);
-  sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[1]));
-
-  sph_shavite512_init(&ctx_shavite);
-  sph_shavite512(&ctx_shavite, static_cast<const void*>(&hash[1]), 64);
-  sph_shavite512_close(&ctx_shavite, static_cast<void*>(&hash[2]));
-
-  sph_simd512_init(&ctx_simd);
-  sph_simd512 (&ctx_simd, static_cast<const void*>(&hash[2]), 64);
-  sph_simd512_close(&ctx_simd, static_cast<void*>(&hash[3]));
-
-  sph_echo512_init(&ctx_echo);
-  sph_echo512 (&ctx_echo, static_cast<const void*>(&hash[3]), 64);
-  sph_echo512_close(&ctx_echo, static_cast<void*>(&hash[4]));
+  kernels.Luffa512(&header, sizeof(Proto<DGB::Algo::ESkein>::BlockHeader), hash[0].begin());
+  kernels.CubeHash512(hash[0].begin(), hash[1].begin());
+  kernels.Shavite512(hash[1].begin(), hash[2].begin());
+  kernels.Simd512(hash[2].begin(), hash[3].begin());
+  kernels.Echo512(hash[3].begin(), hash[4].begin());
 
   memcpy(result.begin(), hash[4].begin(), 32);
 
+  if (shareTarget && result.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   *shareDiff = BTC::difficultyFromBits(result.GetCompact(), 29);
 
   bool fNegative;
@@ -68,7 +51,7 @@ template<> bool Proto<DGB::Algo::EQubit>::checkConsensus(const Proto<DGB::Algo::
   return true;
 }
 
-template<> bool Proto<DGB::Algo::ESkein>::checkConsensus(const Proto<DGB::Algo::ESkein>::BlockHeader &header, CheckConsensusCtx&, DGB::Proto<DGB::Algo::ESkein>::ChainParams&, double *shareDiff)
+template<> bool Proto<DGB::Algo::ESkein>::checkConsensus(const Proto<DGB::Algo::ESkein>::BlockHeader &header, CheckConsensusCtx&, DGB::Proto<DGB::Algo::ESkein>::ChainParams&, double *shareDiff, const arith_uint256 *shareTarget)
 {
   SHA256_CTX sha256Context;
   sph_skein512_context skeinContext;
@@ -83,6 +66,11 @@ template<> bool Proto<DGB::Algo::ESkein>::checkConsensus(const Proto<DGB::Algo::
   SHA256_Update(&sha256Context, skeinHash.begin(), skeinHash.size());
   SHA256_Final(result.begin(), &sha256Context);
 
+  if (shareTarget && result.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   *shareDiff = BTC::difficultyFromBits(result.GetCompact(), 29);
 
   bool fNegative;
@@ -102,7 +90,7 @@ template<> bool Proto<DGB::Algo::ESkein>::checkConsensus(const Proto<DGB::Algo::
   return true;
 }
 
-template<> bool Proto<DGB::Algo::EOdo>::checkConsensus(const Proto<DGB::Algo::EOdo>::BlockHeader &header, CheckConsensusCtx &ctx, DGB::Proto<DGB::Algo::EOdo>::ChainParams&, double *shareDiff)
+template<> bool Proto<DGB::Algo::EOdo>::checkConsensus(const Proto<DGB::Algo::EOdo>::BlockHeader &header, CheckConsensusCtx &ctx, DGB::Proto<DGB::Algo::EOdo>::ChainParams&, double *shareDiff, const arith_uint256 *shareTarget)
 {
   uint32_t key = OdoKey(ctx.OdoShapechangeInterval, header.nTime);
 
@@ -117,6 +105,11 @@ template<> bool Proto<DGB::Algo::EOdo>::checkConsensus(const Proto<DGB::Algo::EO
   KeccakP800_Permute_12rounds(cipher);
   memcpy(result.begin(), cipher, result.size());
 
+  if (shareTarget && result.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   *shareDiff = BTC::difficultyFromBits(result.GetCompact(), 29);
 
   bool fNegative;
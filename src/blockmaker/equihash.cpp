@@ -0,0 +1,337 @@
+#include "blockmaker/equihash.h"
+#include <algorithm>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define EQUIHASH_AVX2
+#include <immintrin.h>
+#endif
+
+static constexpr uint64_t Blake2bIV[8] = {
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static constexpr uint8_t Blake2bSigma[12][16] = {
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+  {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+  {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+  {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+  {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+  {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+  {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+  {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+  {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+  {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}
+};
+
+static inline uint64_t load64le(const uint8_t *p)
+{
+  uint64_t result = 0;
+  for (unsigned i = 0; i < 8; i++)
+    result |= static_cast<uint64_t>(p[i]) << (8*i);
+  return result;
+}
+
+static inline void store64le(uint8_t *p, uint64_t value)
+{
+  for (unsigned i = 0; i < 8; i++)
+    p[i] = static_cast<uint8_t>(value >> (8*i));
+}
+
+static inline uint64_t load64be(const uint8_t *p)
+{
+  uint64_t result = 0;
+  for (unsigned i = 0; i < 8; i++)
+    result = (result << 8) | p[i];
+  return result;
+}
+
+static inline uint64_t rotr64(uint64_t x, unsigned n)
+{
+  return (x >> n) | (x << (64 - n));
+}
+
+static void blake2bCompress(uint64_t *h, const uint64_t *m, uint64_t counter, bool last)
+{
+  uint64_t v[16];
+  for (unsigned i = 0; i < 8; i++) {
+    v[i] = h[i];
+    v[i+8] = Blake2bIV[i];
+  }
+  v[12] ^= counter;
+  if (last)
+    v[14] = ~v[14];
+
+#define G(a, b, c, d, x, y)       \
+  a = a + b + x;                  \
+  d = rotr64(d ^ a, 32);          \
+  c = c + d;                      \
+  b = rotr64(b ^ c, 24);          \
+  a = a + b + y;                  \
+  d = rotr64(d ^ a, 16);          \
+  c = c + d;                      \
+  b = rotr64(b ^ c, 63);
+
+  for (unsigned r = 0; r < 12; r++) {
+    const uint8_t *s = Blake2bSigma[r];
+    G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+    G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+    G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+    G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+    G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+    G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+    G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+    G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+  }
+#undef G
+
+  for (unsigned i = 0; i < 8; i++)
+    h[i] ^= v[i] ^ v[i+8];
+}
+
+#ifdef EQUIHASH_AVX2
+// 4 independent compressions, lane k uses message blocks[k]
+__attribute__((target("avx2")))
+static void blake2bCompress4(uint64_t h[4][8], const uint64_t *h0, const uint64_t blocks[4][16], uint64_t counter)
+{
+  const __m256i rot16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+  const __m256i rot24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+
+  __m256i m[16];
+  for (unsigned i = 0; i < 16; i++)
+    m[i] = _mm256_setr_epi64x(blocks[0][i], blocks[1][i], blocks[2][i], blocks[3][i]);
+
+  __m256i v[16];
+  for (unsigned i = 0; i < 8; i++) {
+    v[i] = _mm256_set1_epi64x(h0[i]);
+    v[i+8] = _mm256_set1_epi64x(Blake2bIV[i]);
+  }
+  v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x(counter));
+  v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x(-1));
+
+#define G(a, b, c, d, x, y)                                                       \
+  a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);                                \
+  d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2, 3, 0, 1));      \
+  c = _mm256_add_epi64(c, d);                                                     \
+  b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), rot24);                         \
+  a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);                                \
+  d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);                         \
+  c = _mm256_add_epi64(c, d);                                                     \
+  b = _mm256_xor_si256(b, c);                                                     \
+  b = _mm256_or_si256(_mm256_srli_epi64(b, 63), _mm256_add_epi64(b, b));
+
+  for (unsigned r = 0; r < 12; r++) {
+    const uint8_t *s = Blake2bSigma[r];
+    G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+    G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+    G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+    G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+    G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+    G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+    G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+    G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+  }
+#undef G
+
+  alignas(32) uint64_t out[8][4];
+  for (unsigned i = 0; i < 8; i++) {
+    __m256i x = _mm256_xor_si256(_mm256_set1_epi64x(h0[i]), _mm256_xor_si256(v[i], v[i+8]));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(out[i]), x);
+  }
+
+  for (unsigned lane = 0; lane < 4; lane++) {
+    for (unsigned i = 0; i < 8; i++)
+      h[lane][i] = out[i][lane];
+  }
+}
+
+static bool hasAVX2()
+{
+  static const bool result = __builtin_cpu_supports("avx2");
+  return result;
+}
+#endif
+
+namespace {
+
+// BLAKE2b state after personalization and all full blocks of header
+// Leaf hash is one compression of header tail with 32-bit index appended
+struct CLeafHasher {
+  uint64_t H[8];
+  uint8_t Tail[128];
+  unsigned TailSize;
+  uint64_t Counter;
+
+  bool init(unsigned n, unsigned k, unsigned outLength, const uint8_t *input, size_t inputSize) {
+    uint8_t personalization[16] = {'Z', 'c', 'a', 's', 'h', 'P', 'o', 'W'};
+    for (unsigned i = 0; i < 4; i++) {
+      personalization[8+i] = static_cast<uint8_t>(n >> (8*i));
+      personalization[12+i] = static_cast<uint8_t>(k >> (8*i));
+    }
+
+    for (unsigned i = 0; i < 8; i++)
+      H[i] = Blake2bIV[i];
+    H[0] ^= 0x01010000ULL ^ outLength;
+    H[6] ^= load64le(personalization);
+    H[7] ^= load64le(personalization + 8);
+
+    // All full header blocks are not last, index always follows them
+    size_t offset = 0;
+    uint64_t m[16];
+    while (inputSize - offset >= 128) {
+      for (unsigned i = 0; i < 16; i++)
+        m[i] = load64le(input + offset + i*8);
+      offset += 128;
+      blake2bCompress(H, m, offset, false);
+    }
+
+    // Index must fit into last block
+    TailSize = static_cast<unsigned>(inputSize - offset);
+    if (TailSize + 4 > 128)
+      return false;
+    memset(Tail, 0, sizeof(Tail));
+    memcpy(Tail, input + offset, TailSize);
+    Counter = inputSize + 4;
+    return true;
+  }
+
+  void makeBlock(uint64_t *m, uint32_t index) const {
+    uint8_t block[128];
+    memcpy(block, Tail, sizeof(block));
+    for (unsigned i = 0; i < 4; i++)
+      block[TailSize+i] = static_cast<uint8_t>(index >> (8*i));
+    for (unsigned i = 0; i < 16; i++)
+      m[i] = load64le(block + i*8);
+  }
+
+  // Computes 4 hashes, output buffers must have 64 bytes
+  void hash4(const uint32_t *indices, uint8_t out[4][64]) const {
+    uint64_t blocks[4][16];
+    uint64_t h[4][8];
+    for (unsigned lane = 0; lane < 4; lane++)
+      makeBlock(blocks[lane], indices[lane]);
+
+#ifdef EQUIHASH_AVX2
+    if (hasAVX2()) {
+      blake2bCompress4(h, H, blocks, Counter);
+    } else
+#endif
+    {
+      for (unsigned lane = 0; lane < 4; lane++) {
+        memcpy(h[lane], H, sizeof(H));
+        blake2bCompress(h[lane], blocks[lane], Counter, true);
+      }
+    }
+
+    for (unsigned lane = 0; lane < 4; lane++) {
+      for (unsigned i = 0; i < 8; i++)
+        store64le(out[lane] + i*8, h[lane][i]);
+    }
+  }
+};
+
+}
+
+template<unsigned N, unsigned K>
+bool CEquihashVerifier<N, K>::verify(const uint8_t *input, size_t inputSize, const uint8_t *solution, size_t solutionSize)
+{
+  static_assert(CollisionBitLength + 1 <= 32, "index must fit into 32 bit");
+  static_assert(CollisionBitLength + 7 <= 64, "digit must fit into 64 bit window");
+  static_assert(IndicesNum % 4 == 0, "leaves hashed by 4");
+  constexpr unsigned IndexBitLength = CollisionBitLength + 1;
+  constexpr uint32_t DigitMask = (1u << CollisionBitLength) - 1;
+  constexpr unsigned LeafSize = N/8;
+
+  if (solutionSize != SolutionWidth)
+    return false;
+
+  // Unpack indices (big-endian bit stream)
+  uint32_t indices[IndicesNum];
+  {
+    uint64_t acc = 0;
+    unsigned accBits = 0;
+    unsigned indexNum = 0;
+    for (size_t i = 0; i < solutionSize; i++) {
+      acc = (acc << 8) | solution[i];
+      accBits += 8;
+      if (accBits >= IndexBitLength) {
+        accBits -= IndexBitLength;
+        indices[indexNum++] = static_cast<uint32_t>(acc >> accBits) & ((1u << IndexBitLength) - 1);
+      }
+    }
+  }
+
+  // Left subtree must start with smaller index at each level
+  for (unsigned level = 0; level < K; level++) {
+    unsigned half = 1u << level;
+    for (unsigned i = 0; i < IndicesNum; i += 2*half) {
+      if (indices[i] >= indices[i+half])
+        return false;
+    }
+  }
+
+  // All indices must be distinct
+  {
+    uint32_t sorted[IndicesNum];
+    memcpy(sorted, indices, sizeof(sorted));
+    std::sort(sorted, sorted + IndicesNum);
+    if (std::adjacent_find(sorted, sorted + IndicesNum) != sorted + IndicesNum)
+      return false;
+  }
+
+  CLeafHasher hasher;
+  if (!hasher.init(N, K, HashOutput, input, inputSize))
+    return false;
+
+  // Depth-first merge: stack holds subtrees of decreasing size, digits below level are already zero
+  struct CRow {
+    uint32_t Digits[K+1];
+  };
+  CRow stack[K+1];
+  unsigned levels[K+1];
+  unsigned depth = 0;
+
+  for (unsigned i = 0; i < IndicesNum; i += 4) {
+    uint32_t hashIndices[4];
+    uint8_t hashes[4][64];
+    for (unsigned lane = 0; lane < 4; lane++)
+      hashIndices[lane] = indices[i+lane] / IndicesPerHashOutput;
+    hasher.hash4(hashIndices, hashes);
+
+    for (unsigned lane = 0; lane < 4; lane++) {
+      // Leaf is N bits of hash output, split into K+1 digits
+      uint8_t leaf[LeafSize + 8] = {};
+      memcpy(leaf, hashes[lane] + (indices[i+lane] % IndicesPerHashOutput) * LeafSize, LeafSize);
+      CRow row;
+      for (unsigned d = 0; d <= K; d++) {
+        unsigned bit = d*CollisionBitLength;
+        uint64_t window = load64be(leaf + bit/8);
+        row.Digits[d] = static_cast<uint32_t>(window >> (64 - bit%8 - CollisionBitLength)) & DigitMask;
+      }
+
+      unsigned level = 0;
+      while (depth && levels[depth-1] == level) {
+        CRow &left = stack[--depth];
+        if (left.Digits[level] != row.Digits[level])
+          return false;
+        for (unsigned d = level + 1; d <= K; d++)
+          row.Digits[d] ^= left.Digits[d];
+        level++;
+      }
+
+      stack[depth] = row;
+      levels[depth] = level;
+      depth++;
+    }
+  }
+
+  return depth == 1 && stack[0].Digits[K] == 0;
+}
+
+template class CEquihashVerifier<200, 9>;
+template class CEquihashVerifier<48, 5>;
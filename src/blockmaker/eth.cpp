@@ -179,8 +179,13 @@ void Stratum::Work::buildBlock(size_t, xmstream &blockHexData)
   data->MixHash[64+2] = 0;
 }
 
-bool Stratum::Work::checkConsensus(size_t, double *shareDiff)
+bool Stratum::Work::checkConsensus(size_t, double *shareDiff, const arith_uint256 *shareTarget)
 {
+  if (shareTarget && FinalHash_.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   // Get difficulty
   *shareDiff = getDifficulty(FinalHash_.GetCompact());
   return FinalHash_ <= Target_;
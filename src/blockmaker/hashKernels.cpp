@@ -0,0 +1,796 @@
+#include "blockmaker/hashKernels.h"
+#include "blockmaker/sph_luffa.h"
+#include "blockmaker/sph_cubehash.h"
+#include "blockmaker/sph_shavite.h"
+#include "blockmaker/sph_simd.h"
+#include "blockmaker/sph_echo.h"
+#include "loguru.hpp"
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HASH_KERNELS_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static void luffa512Generic(const void *input, size_t size, void *output)
+{
+  sph_luffa512_context ctx;
+  sph_luffa512_init(&ctx);
+  sph_luffa512(&ctx, input, size);
+  sph_luffa512_close(&ctx, output);
+}
+
+static void cubehash512Generic(const void *input, void *output)
+{
+  sph_cubehash512_context ctx;
+  sph_cubehash512_init(&ctx);
+  sph_cubehash512(&ctx, input, 64);
+  sph_cubehash512_close(&ctx, output);
+}
+
+static void shavite512Generic(const void *input, void *output)
+{
+  sph_shavite512_context ctx;
+  sph_shavite512_init(&ctx);
+  sph_shavite512(&ctx, input, 64);
+  sph_shavite512_close(&ctx, output);
+}
+
+static void simd512Generic(const void *input, void *output)
+{
+  sph_simd512_context ctx;
+  sph_simd512_init(&ctx);
+  sph_simd512(&ctx, input, 64);
+  sph_simd512_close(&ctx, output);
+}
+
+static void echo512Generic(const void *input, void *output)
+{
+  sph_echo512_context ctx;
+  sph_echo512_init(&ctx);
+  sph_echo512(&ctx, input, 64);
+  sph_echo512_close(&ctx, output);
+}
+
+#ifdef HASH_KERNELS_X86
+
+// CubeHash16/32-512, state is 32 words in 4 registers: (x0 x1) (x2 x3) (x4 x5) (x6 x7) by 128 bit
+__attribute__((target("avx2")))
+static inline __m256i rotl32x8(__m256i x, int n)
+{
+  return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+static inline void cubehashRounds(__m256i &x01, __m256i &x23, __m256i &x45, __m256i &x67, unsigned rounds)
+{
+  for (unsigned r = 0; r < rounds; r++) {
+    x45 = _mm256_add_epi32(x01, x45);
+    x67 = _mm256_add_epi32(x23, x67);
+    __m256i y01 = rotl32x8(x23, 7);
+    __m256i y23 = rotl32x8(x01, 7);
+    x01 = _mm256_xor_si256(y01, x45);
+    x23 = _mm256_xor_si256(y23, x67);
+    x45 = _mm256_shuffle_epi32(x45, 0x4E);
+    x67 = _mm256_shuffle_epi32(x67, 0x4E);
+
+    x45 = _mm256_add_epi32(x01, x45);
+    x67 = _mm256_add_epi32(x23, x67);
+    x01 = rotl32x8(_mm256_permute4x64_epi64(x01, 0x4E), 11);
+    x23 = rotl32x8(_mm256_permute4x64_epi64(x23, 0x4E), 11);
+    x01 = _mm256_xor_si256(x01, x45);
+    x23 = _mm256_xor_si256(x23, x67);
+    x45 = _mm256_shuffle_epi32(x45, 0xB1);
+    x67 = _mm256_shuffle_epi32(x67, 0xB1);
+  }
+}
+
+__attribute__((target("avx2")))
+static void cubehash512AVX2(const void *input, void *output)
+{
+  // State after initialization rounds for 512-bit output
+  alignas(32) static const uint32_t IV512[32] = {
+    0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E, 0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+    0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537, 0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+    0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532, 0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+    0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576, 0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+  };
+
+  const __m256i *iv = reinterpret_cast<const __m256i*>(IV512);
+  __m256i x01 = _mm256_load_si256(iv + 0);
+  __m256i x23 = _mm256_load_si256(iv + 1);
+  __m256i x45 = _mm256_load_si256(iv + 2);
+  __m256i x67 = _mm256_load_si256(iv + 3);
+
+  // Two 32-byte message blocks
+  const __m256i *data = static_cast<const __m256i*>(input);
+  x01 = _mm256_xor_si256(x01, _mm256_loadu_si256(data));
+  cubehashRounds(x01, x23, x45, x67, 16);
+  x01 = _mm256_xor_si256(x01, _mm256_loadu_si256(data + 1));
+  cubehashRounds(x01, x23, x45, x67, 16);
+
+  // Padding block
+  x01 = _mm256_xor_si256(x01, _mm256_setr_epi32(0x80, 0, 0, 0, 0, 0, 0, 0));
+  cubehashRounds(x01, x23, x45, x67, 16);
+
+  // Finalization
+  x67 = _mm256_xor_si256(x67, _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 1));
+  cubehashRounds(x01, x23, x45, x67, 160);
+
+  __m256i *out = static_cast<__m256i*>(output);
+  _mm256_storeu_si256(out, x01);
+  _mm256_storeu_si256(out + 1, x23);
+}
+
+// Luffa-512, 5 lanes of 8 words; register k holds word k of lanes 0..4 (lanes 5..7 unused)
+alignas(32) static const uint32_t LuffaIV[8][8] = {
+  {0x6D251E69, 0xC3B44B95, 0xF7EFC89D, 0x858075D5, 0x6C68E9BE, 0, 0, 0},
+  {0x44B051E0, 0xD9D2F256, 0x5DBA5781, 0x36D79CCE, 0x5EC41E22, 0, 0, 0},
+  {0x4EAA6FB4, 0x70EEE9A0, 0x04016CE5, 0xE571F7D7, 0xC825B7C7, 0, 0, 0},
+  {0xDBF78465, 0xDE099FA3, 0xAD659C05, 0x204B1F67, 0xAFFB4363, 0, 0, 0},
+  {0x6E292011, 0x5D9B0557, 0x0306194F, 0x35870C6A, 0xF5DF3999, 0, 0, 0},
+  {0x90152DF4, 0x8FC944B3, 0x666D1836, 0x57E9E923, 0x0FC688F1, 0, 0, 0},
+  {0xEE058139, 0xCF1CCF0E, 0x24AA230A, 0x14BCB808, 0xB07224CC, 0, 0, 0},
+  {0xDEF610BB, 0x746CD581, 0x8B264AE7, 0x7CDE72CE, 0x03E86CEA, 0, 0, 0}
+};
+
+// Step constants for words 0 and 4 of each lane
+alignas(32) static const uint32_t LuffaRC0[8][8] = {
+  {0x303994A6, 0xB6DE10ED, 0xFC20D9D2, 0xB213AFA5, 0xF0D2E9E3, 0, 0, 0},
+  {0xC0E65299, 0x70F47AAE, 0x34552E25, 0xC84EBE95, 0xAC11D7FA, 0, 0, 0},
+  {0x6CC33A12, 0x0707A3D4, 0x7AD8818F, 0x4E608A22, 0x1BCB66F2, 0, 0, 0},
+  {0xDC56983E, 0x1C1E8F51, 0x8438764A, 0x56D858FE, 0x6F2D9BC9, 0, 0, 0},
+  {0x1E00108F, 0x707A3D45, 0xBB6DE032, 0x343B138F, 0x78602649, 0, 0, 0},
+  {0x7800423D, 0xAEB28562, 0xEDB780C8, 0xD0EC4E3D, 0x8EDAE952, 0, 0, 0},
+  {0x8F5B7882, 0xBACA1589, 0xD9847356, 0x2CEB4882, 0x3B6BA548, 0, 0, 0},
+  {0x96E1DB12, 0x40A46F3E, 0xA2C78434, 0xB3AD2208, 0xEDAE9520, 0, 0, 0}
+};
+
+alignas(32) static const uint32_t LuffaRC4[8][8] = {
+  {0xE0337818, 0x01685F3D, 0xE25E72C1, 0xE028C9BF, 0x5090D577, 0, 0, 0},
+  {0x441BA90D, 0x05A17CF4, 0xE623BB72, 0x44756F91, 0x2D1925AB, 0, 0, 0},
+  {0x7F34D442, 0xBD09CACA, 0x5C58A4A4, 0x7E8FCE32, 0xB46496AC, 0, 0, 0},
+  {0x9389217F, 0xF4272B28, 0x1E38E2E7, 0x956548BE, 0xD1925AB0, 0, 0, 0},
+  {0xE5A8BCE6, 0x144AE5CC, 0x78E38B9D, 0xFE191BE2, 0x29131AB6, 0, 0, 0},
+  {0x5274BAF4, 0xFAA7AE2B, 0x27586719, 0x3CB226E5, 0x0FC053C3, 0, 0, 0},
+  {0x26889BA7, 0x2E48F1C1, 0x36EDA57F, 0x5944A28E, 0x3F014F0C, 0, 0, 0},
+  {0x9A226E9D, 0xB923C704, 0x703AACE7, 0xA1C4C355, 0xFC053C31, 0, 0, 0}
+};
+
+static inline uint32_t readBE32(const uint8_t *data)
+{
+  return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+static inline void writeBE32(uint8_t *data, uint32_t value)
+{
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
+
+// Multiplication by x in GF(2^32)^8, applied to all lanes
+__attribute__((target("avx2")))
+static inline void luffaM2(__m256i *x)
+{
+  __m256i t = x[7];
+  x[7] = x[6];
+  x[6] = x[5];
+  x[5] = x[4];
+  x[4] = _mm256_xor_si256(x[3], t);
+  x[3] = _mm256_xor_si256(x[2], t);
+  x[2] = x[1];
+  x[1] = _mm256_xor_si256(x[0], t);
+  x[0] = t;
+}
+
+__attribute__((target("avx2")))
+static inline void luffaSubCrumb(__m256i &a0, __m256i &a1, __m256i &a2, __m256i &a3)
+{
+  const __m256i ones = _mm256_set1_epi32(-1);
+  __m256i t = a0;
+  a0 = _mm256_or_si256(a0, a1);
+  a2 = _mm256_xor_si256(a2, a3);
+  a1 = _mm256_xor_si256(a1, ones);
+  a0 = _mm256_xor_si256(a0, a3);
+  a3 = _mm256_and_si256(a3, t);
+  a1 = _mm256_xor_si256(a1, a3);
+  a3 = _mm256_xor_si256(a3, a2);
+  a2 = _mm256_and_si256(a2, a0);
+  a0 = _mm256_xor_si256(a0, ones);
+  a2 = _mm256_xor_si256(a2, a1);
+  a1 = _mm256_or_si256(a1, a3);
+  t = _mm256_xor_si256(t, a1);
+  a3 = _mm256_xor_si256(a3, a2);
+  a2 = _mm256_and_si256(a2, a1);
+  a1 = _mm256_xor_si256(a1, a0);
+  a0 = t;
+}
+
+__attribute__((target("avx2")))
+static inline void luffaMixWord(__m256i &u, __m256i &v)
+{
+  v = _mm256_xor_si256(v, u);
+  u = _mm256_xor_si256(rotl32x8(u, 2), v);
+  v = _mm256_xor_si256(rotl32x8(v, 14), u);
+  u = _mm256_xor_si256(rotl32x8(u, 10), v);
+  v = rotl32x8(v, 1);
+}
+
+// Message injection MI5: lane j gets M2^j(message) after two rounds of lane mixing
+__attribute__((target("avx2")))
+static inline void luffaInject(__m256i *x, const uint8_t *block)
+{
+  const __m256i next = _mm256_setr_epi32(1, 2, 3, 4, 0, 5, 6, 7);
+  const __m256i next2 = _mm256_setr_epi32(2, 3, 4, 0, 1, 5, 6, 7);
+  const __m256i previous = _mm256_setr_epi32(4, 0, 1, 2, 3, 5, 6, 7);
+
+  // Xor of all lanes in every lane
+  __m256i a[8];
+  for (unsigned k = 0; k < 8; k++) {
+    __m256i t = _mm256_xor_si256(x[k], _mm256_permutevar8x32_epi32(x[k], next));
+    t = _mm256_xor_si256(t, _mm256_permutevar8x32_epi32(t, next2));
+    a[k] = _mm256_xor_si256(t, _mm256_permutevar8x32_epi32(x[k], previous));
+  }
+  luffaM2(a);
+  for (unsigned k = 0; k < 8; k++)
+    x[k] = _mm256_xor_si256(x[k], a[k]);
+
+  // V[j] = M2(V[j]) ^ V[j+1], then V[j] = M2(V[j]) ^ V[j-1]
+  __m256i t[8];
+  for (unsigned k = 0; k < 8; k++)
+    t[k] = x[k];
+  luffaM2(t);
+  for (unsigned k = 0; k < 8; k++)
+    x[k] = _mm256_xor_si256(t[k], _mm256_permutevar8x32_epi32(x[k], next));
+  for (unsigned k = 0; k < 8; k++)
+    t[k] = x[k];
+  luffaM2(t);
+  for (unsigned k = 0; k < 8; k++)
+    x[k] = _mm256_xor_si256(t[k], _mm256_permutevar8x32_epi32(x[k], previous));
+
+  __m256i m[8];
+  __m256i r[8];
+  for (unsigned k = 0; k < 8; k++)
+    m[k] = r[k] = _mm256_set1_epi32(readBE32(block + 4*k));
+  luffaM2(r);
+  for (unsigned k = 0; k < 8; k++)
+    m[k] = _mm256_blend_epi32(m[k], r[k], 0xFE);
+  luffaM2(r);
+  for (unsigned k = 0; k < 8; k++)
+    m[k] = _mm256_blend_epi32(m[k], r[k], 0xFC);
+  luffaM2(r);
+  for (unsigned k = 0; k < 8; k++)
+    m[k] = _mm256_blend_epi32(m[k], r[k], 0xF8);
+  luffaM2(r);
+  for (unsigned k = 0; k < 8; k++)
+    x[k] = _mm256_xor_si256(x[k], _mm256_blend_epi32(m[k], r[k], 0xF0));
+}
+
+// Permutation P5: tweak (words 4..7 of lane j rotated by j) and 8 steps for all lanes
+__attribute__((target("avx2")))
+static inline void luffaPermute(__m256i *x)
+{
+  const __m256i tweak = _mm256_setr_epi32(0, 1, 2, 3, 4, 0, 0, 0);
+  const __m256i tweakRight = _mm256_sub_epi32(_mm256_set1_epi32(32), tweak);
+  for (unsigned k = 4; k < 8; k++)
+    x[k] = _mm256_or_si256(_mm256_sllv_epi32(x[k], tweak), _mm256_srlv_epi32(x[k], tweakRight));
+
+  for (unsigned r = 0; r < 8; r++) {
+    luffaSubCrumb(x[0], x[1], x[2], x[3]);
+    luffaSubCrumb(x[5], x[6], x[7], x[4]);
+    luffaMixWord(x[0], x[4]);
+    luffaMixWord(x[1], x[5]);
+    luffaMixWord(x[2], x[6]);
+    luffaMixWord(x[3], x[7]);
+    x[0] = _mm256_xor_si256(x[0], _mm256_load_si256(reinterpret_cast<const __m256i*>(LuffaRC0[r])));
+    x[4] = _mm256_xor_si256(x[4], _mm256_load_si256(reinterpret_cast<const __m256i*>(LuffaRC4[r])));
+  }
+}
+
+// Xor of lanes 0..4 as 32 big endian bytes
+__attribute__((target("avx2")))
+static inline void luffaOutput(const __m256i *x, uint8_t *output)
+{
+  alignas(32) uint32_t words[8][8];
+  for (unsigned k = 0; k < 8; k++)
+    _mm256_store_si256(reinterpret_cast<__m256i*>(words[k]), x[k]);
+  for (unsigned k = 0; k < 8; k++)
+    writeBE32(output + 4*k, words[k][0] ^ words[k][1] ^ words[k][2] ^ words[k][3] ^ words[k][4]);
+}
+
+__attribute__((target("avx2")))
+static void luffa512AVX2(const void *input, size_t size, void *output)
+{
+  __m256i x[8];
+  for (unsigned k = 0; k < 8; k++)
+    x[k] = _mm256_load_si256(reinterpret_cast<const __m256i*>(LuffaIV[k]));
+
+  const uint8_t *data = static_cast<const uint8_t*>(input);
+  for (; size >= 32; data += 32, size -= 32) {
+    luffaInject(x, data);
+    luffaPermute(x);
+  }
+
+  // Padding block, then two blank blocks producing the output halves
+  alignas(32) uint8_t block[32] = {};
+  memcpy(block, data, size);
+  block[size] = 0x80;
+  luffaInject(x, block);
+  luffaPermute(x);
+
+  memset(block, 0, sizeof(block));
+  uint8_t *out = static_cast<uint8_t*>(output);
+  luffaInject(x, block);
+  luffaPermute(x);
+  luffaOutput(x, out);
+  luffaInject(x, block);
+  luffaPermute(x);
+  luffaOutput(x, out + 32);
+}
+
+// SHAvite-3-512, one 128-byte block (message, padding, bit counter 512 and digest size)
+__attribute__((target("aes")))
+static void shavite512AESNI(const void *input, void *output)
+{
+  static const uint32_t IV512[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC, 0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47, 0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+  };
+
+  const __m128i zero = _mm_setzero_si128();
+  const uint32_t count0 = 512;
+
+  // Round keys
+  __m128i rk[112];
+  alignas(16) uint8_t block[128] = {};
+  memcpy(block, input, 64);
+  block[64] = 0x80;
+  block[110] = count0 & 0xFF;
+  block[111] = (count0 >> 8) & 0xFF;
+  block[126] = (16 << 5) & 0xFF;
+  block[127] = 16 >> 3;
+  for (unsigned i = 0; i < 8; i++)
+    rk[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(block) + i);
+
+  unsigned u = 8;
+  for (;;) {
+    for (unsigned s = 0; s < 8; s++) {
+      __m128i x = _mm_aesenc_si128(_mm_shuffle_epi32(rk[u-8], _MM_SHUFFLE(0, 3, 2, 1)), zero);
+      rk[u] = _mm_xor_si128(x, rk[u-1]);
+      if (u == 8)
+        rk[u] = _mm_xor_si128(rk[u], _mm_setr_epi32(count0, 0, 0, ~0));
+      else if (u == 41)
+        rk[u] = _mm_xor_si128(rk[u], _mm_setr_epi32(0, 0, 0, ~count0));
+      else if (u == 79)
+        rk[u] = _mm_xor_si128(rk[u], _mm_setr_epi32(0, 0, count0, ~0));
+      else if (u == 110)
+        rk[u] = _mm_xor_si128(rk[u], _mm_setr_epi32(0, count0, 0, ~0));
+      u++;
+    }
+
+    if (u == 112)
+      break;
+
+    for (unsigned s = 0; s < 8; s++) {
+      __m128i shifted = _mm_or_si128(_mm_srli_si128(rk[u-2], 4), _mm_slli_si128(rk[u-1], 12));
+      rk[u] = _mm_xor_si128(rk[u-8], shifted);
+      u++;
+    }
+  }
+
+  const __m128i *iv = reinterpret_cast<const __m128i*>(IV512);
+  __m128i h0 = _mm_loadu_si128(iv + 0);
+  __m128i h1 = _mm_loadu_si128(iv + 1);
+  __m128i h2 = _mm_loadu_si128(iv + 2);
+  __m128i h3 = _mm_loadu_si128(iv + 3);
+  __m128i p0 = h0, p1 = h1, p2 = h2, p3 = h3;
+  for (unsigned r = 0; r < 14; r++) {
+    const __m128i *k = rk + r*8;
+    __m128i x = _mm_xor_si128(p1, k[0]);
+    x = _mm_aesenc_si128(x, k[1]);
+    x = _mm_aesenc_si128(x, k[2]);
+    x = _mm_aesenc_si128(x, k[3]);
+    x = _mm_aesenc_si128(x, zero);
+    p0 = _mm_xor_si128(p0, x);
+
+    x = _mm_xor_si128(p3, k[4]);
+    x = _mm_aesenc_si128(x, k[5]);
+    x = _mm_aesenc_si128(x, k[6]);
+    x = _mm_aesenc_si128(x, k[7]);
+    x = _mm_aesenc_si128(x, zero);
+    p2 = _mm_xor_si128(p2, x);
+
+    __m128i t = p3;
+    p3 = p2;
+    p2 = p1;
+    p1 = p0;
+    p0 = t;
+  }
+
+  __m128i *out = static_cast<__m128i*>(output);
+  _mm_storeu_si128(out + 0, _mm_xor_si128(h0, p0));
+  _mm_storeu_si128(out + 1, _mm_xor_si128(h1, p1));
+  _mm_storeu_si128(out + 2, _mm_xor_si128(h2, p2));
+  _mm_storeu_si128(out + 3, _mm_xor_si128(h3, p3));
+}
+
+// SIMD-512, 64-byte message in one 128-byte block followed by the length block
+// Message expansion is NTT of block bytes modulo 257 (root 41); computed as 16x16 transforms in 16-bit lanes
+// using 41^16 = 2, values kept in -128..128 between steps
+alignas(32) static const uint32_t SimdIV512[32] = {
+  0x0BA16B95, 0x72F999AD, 0x9FECC2AE, 0xBA3264FC, 0x5E894929, 0x8E9F30E5, 0x2F1DAA37, 0xF0F2C558,
+  0xAC506643, 0xA90635A5, 0xE25B878B, 0xAAB7878F, 0x88817F7A, 0x0A02892B, 0x559A7550, 0x598F657E,
+  0x7EEF60A1, 0x6B70E3E8, 0x9C1714D1, 0xB958E2A8, 0xAB02675E, 0xED1C014F, 0xCD8D65BB, 0xFDB7A257,
+  0x09254899, 0xD699C7BC, 0x9019B6DC, 0x2B9022E4, 0x8FA14956, 0x21BF9BD3, 0xB94D0943, 0x6FFDDC22
+};
+
+// Word permutations of step functions (index xor 1, 6, 2, 3, 5, 7, 4)
+alignas(32) static const int32_t SimdPermutations[7][8] = {
+  {1, 0, 3, 2, 5, 4, 7, 6},
+  {6, 7, 4, 5, 2, 3, 0, 1},
+  {2, 3, 0, 1, 6, 7, 4, 5},
+  {3, 2, 1, 0, 7, 6, 5, 4},
+  {5, 4, 7, 6, 1, 0, 3, 2},
+  {7, 6, 5, 4, 3, 2, 1, 0},
+  {4, 5, 6, 7, 0, 1, 2, 3}
+};
+
+struct CSimdTables {
+  // 41^(k*j), k and j in 0..15
+  alignas(32) int16_t Twiddles[16][16];
+  // Expansion offsets of message block: 41^(255*i)
+  alignas(32) int16_t Offsets[256];
+  // Step words of length block (bit length 512)
+  alignas(32) uint32_t LengthBlockWords[32][8];
+};
+
+// x = 256*h + l = l - h (mod 257), result in -127..383
+__attribute__((target("avx2")))
+static inline __m256i simdReduce(__m256i x)
+{
+  return _mm256_sub_epi16(_mm256_and_si256(x, _mm256_set1_epi16(0xFF)), _mm256_srai_epi16(x, 8));
+}
+
+// Any 16-bit value to -128..128
+__attribute__((target("avx2")))
+static inline __m256i simdNormalize(__m256i x)
+{
+  x = simdReduce(x);
+  return _mm256_sub_epi16(x, _mm256_and_si256(_mm256_cmpgt_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257)));
+}
+
+// y[k] = sum x[j] * 2^(j*k), j < n; inputs in -256..255, outputs in -5104..5104
+__attribute__((target("avx2")))
+static inline void simdTransform16(const __m256i *x, unsigned n, __m256i *y)
+{
+  // x[j] * 2^s, s = 0..7 (2^8 = -1)
+  __m256i shifted[16][8];
+  for (unsigned j = 0; j < n; j++) {
+    for (unsigned s = 0; s < 8; s++)
+      shifted[j][s] = simdReduce(_mm256_slli_epi16(x[j], s));
+  }
+
+  for (unsigned k = 0; k < 16; k++) {
+    __m256i sum = _mm256_setzero_si256();
+    for (unsigned j = 0; j < n; j++) {
+      unsigned e = (j*k) % 16;
+      sum = e < 8 ? _mm256_add_epi16(sum, shifted[j][e]) : _mm256_sub_epi16(sum, shifted[j][e-8]);
+    }
+    y[k] = sum;
+  }
+}
+
+__attribute__((target("avx2")))
+static inline void transpose16x16(__m256i *x)
+{
+  // 16-bit pairs, 32-bit quads, 64-bit octets of rows within 128-bit lanes; then swap lanes
+  __m256i t[16];
+  __m256i u[16];
+  for (unsigned i = 0; i < 8; i++) {
+    t[i] = _mm256_unpacklo_epi16(x[2*i], x[2*i+1]);
+    t[i+8] = _mm256_unpackhi_epi16(x[2*i], x[2*i+1]);
+  }
+  for (unsigned h = 0; h < 16; h += 8) {
+    for (unsigned i = 0; i < 4; i++) {
+      u[h+i] = _mm256_unpacklo_epi32(t[h+2*i], t[h+2*i+1]);
+      u[h+i+4] = _mm256_unpackhi_epi32(t[h+2*i], t[h+2*i+1]);
+    }
+  }
+  for (unsigned h = 0; h < 16; h += 4) {
+    t[h] = _mm256_unpacklo_epi64(u[h], u[h+1]);
+    t[h+1] = _mm256_unpackhi_epi64(u[h], u[h+1]);
+    t[h+2] = _mm256_unpacklo_epi64(u[h+2], u[h+3]);
+    t[h+3] = _mm256_unpackhi_epi64(u[h+2], u[h+3]);
+  }
+  // t[4*(c/2) + c%2] is column c of rows 0..7, next by two is column c of rows 8..15 (c+8 in high lanes)
+  for (unsigned c = 0; c < 8; c++) {
+    unsigned i = 4*(c/2) + c%2;
+    x[c] = _mm256_permute2x128_si256(t[i], t[i+2], 0x20);
+    x[c+8] = _mm256_permute2x128_si256(t[i], t[i+2], 0x31);
+  }
+}
+
+// q[i] = sum x[j] * 41^(i*j) + offsets[i] in -128..128, vector b holds i = 16*b..16*b+15
+// Only first 'size' bytes of 128-byte block are nonzero (multiple of 16)
+__attribute__((target("avx2")))
+static void simdExpand(const uint8_t *block, size_t size, const int16_t *offsets, const CSimdTables &tables, __m256i *q)
+{
+  // i = k1 + 16*k2, j = 16*j1 + j2: 41^(i*j) = 2^(k1*j1) * 41^(k1*j2) * 2^(k2*j2)
+  __m256i x[8];
+  for (unsigned j1 = 0; j1 < size/16; j1++)
+    x[j1] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16*j1)));
+
+  __m256i z[16];
+  simdTransform16(x, size/16, z);
+  for (unsigned k1 = 0; k1 < 16; k1++) {
+    __m256i twiddle = _mm256_load_si256(reinterpret_cast<const __m256i*>(tables.Twiddles[k1]));
+    z[k1] = simdNormalize(_mm256_mullo_epi16(simdNormalize(z[k1]), twiddle));
+  }
+
+  transpose16x16(z);
+  simdTransform16(z, 16, q);
+  for (unsigned k2 = 0; k2 < 16; k2++)
+    q[k2] = simdNormalize(_mm256_add_epi16(q[k2], _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets + 16*k2))));
+}
+
+// Step words: pairs of q values multiplied by 185 (rounds 0, 1) or 233 (rounds 2, 3) as 16-bit halves
+__attribute__((target("avx2")))
+static void simdMessageWords(const __m256i *q, __m256i *w)
+{
+  static const uint8_t blocks[32] = {
+    4, 6, 0, 2, 7, 5, 3, 1,
+    15, 11, 12, 8, 9, 13, 10, 14,
+    17, 18, 23, 20, 22, 21, 16, 19,
+    30, 24, 25, 31, 27, 29, 28, 26
+  };
+
+  __m256i q233[16];
+  for (unsigned i = 0; i < 16; i++)
+    q233[i] = _mm256_mullo_epi16(q[i], _mm256_set1_epi16(233));
+  for (unsigned i = 0; i < 16; i++)
+    w[i] = _mm256_mullo_epi16(q[blocks[i]], _mm256_set1_epi16(185));
+  // Low halves from even values of vector b-16, high halves from even values of vector b-8
+  for (unsigned i = 16; i < 24; i++)
+    w[i] = _mm256_blend_epi16(q233[blocks[i]-16], _mm256_slli_epi32(q233[blocks[i]-8], 16), 0xAA);
+  // Low halves from odd values of vector b-24, high halves from odd values of vector b-16
+  for (unsigned i = 24; i < 32; i++)
+    w[i] = _mm256_blend_epi16(_mm256_srli_epi32(q233[blocks[i]-24], 16), q233[blocks[i]-16], 0xAA);
+}
+
+__attribute__((target("avx2")))
+static inline void simdStep(__m256i &a, __m256i &b, __m256i &c, __m256i &d, __m256i w, bool majority, int r, int s, unsigned permutation)
+{
+  __m256i f = majority ?
+    _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(_mm256_or_si256(a, b), c)) :
+    _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(b, c), a), c);
+  __m256i ta = rotl32x8(a, r);
+  __m256i tt = _mm256_add_epi32(_mm256_add_epi32(d, w), f);
+  a = _mm256_add_epi32(rotl32x8(tt, s),
+                       _mm256_permutevar8x32_epi32(ta, _mm256_load_si256(reinterpret_cast<const __m256i*>(SimdPermutations[permutation]))));
+  d = c;
+  c = b;
+  b = ta;
+}
+
+__attribute__((target("avx2")))
+static void simdCompress(__m256i *state, const __m256i *w, const __m256i *message)
+{
+  static const int rotations[4][4] = {{3, 23, 17, 27}, {28, 19, 22, 7}, {29, 9, 15, 5}, {4, 13, 10, 25}};
+  __m256i a = _mm256_xor_si256(state[0], message[0]);
+  __m256i b = _mm256_xor_si256(state[1], message[1]);
+  __m256i c = _mm256_xor_si256(state[2], message[2]);
+  __m256i d = _mm256_xor_si256(state[3], message[3]);
+  for (unsigned round = 0; round < 4; round++) {
+    for (unsigned i = 0; i < 8; i++)
+      simdStep(a, b, c, d, w[8*round + i], i >= 4, rotations[round][i % 4], rotations[round][(i+1) % 4], (round + i) % 7);
+  }
+
+  simdStep(a, b, c, d, state[0], false, 4, 13, 4);
+  simdStep(a, b, c, d, state[1], false, 13, 10, 5);
+  simdStep(a, b, c, d, state[2], false, 10, 25, 6);
+  simdStep(a, b, c, d, state[3], false, 25, 4, 0);
+  state[0] = a;
+  state[1] = b;
+  state[2] = c;
+  state[3] = d;
+}
+
+__attribute__((target("avx2")))
+static CSimdTables simdMakeTables()
+{
+  CSimdTables tables;
+  int powers[256];
+  powers[0] = 1;
+  for (unsigned i = 1; i < 256; i++)
+    powers[i] = powers[i-1] * 41 % 257;
+
+  for (unsigned k = 0; k < 16; k++) {
+    for (unsigned j = 0; j < 16; j++) {
+      int power = powers[k*j % 256];
+      tables.Twiddles[k][j] = static_cast<int16_t>(power > 128 ? power - 257 : power);
+    }
+  }
+
+  // Last block offsets: 41^(255*i) + 41^(253*i)
+  alignas(32) int16_t lengthBlockOffsets[256];
+  for (unsigned i = 0; i < 256; i++) {
+    tables.Offsets[i] = static_cast<int16_t>(powers[255*i % 256]);
+    lengthBlockOffsets[i] = static_cast<int16_t>((powers[255*i % 256] + powers[253*i % 256]) % 257);
+  }
+
+  alignas(32) uint8_t block[128] = {};
+  block[1] = 512 >> 8;
+  __m256i q[16];
+  __m256i w[32];
+  simdExpand(block, 16, lengthBlockOffsets, tables, q);
+  simdMessageWords(q, w);
+  for (unsigned i = 0; i < 32; i++)
+    _mm256_store_si256(reinterpret_cast<__m256i*>(tables.LengthBlockWords[i]), w[i]);
+  return tables;
+}
+
+__attribute__((target("avx2")))
+static void simd512AVX2(const void *input, void *output)
+{
+  static const CSimdTables tables = simdMakeTables();
+  const __m256i *iv = reinterpret_cast<const __m256i*>(SimdIV512);
+  __m256i state[4] = {_mm256_load_si256(iv), _mm256_load_si256(iv + 1), _mm256_load_si256(iv + 2), _mm256_load_si256(iv + 3)};
+
+  // Message block, zero padded
+  const __m256i *data = static_cast<const __m256i*>(input);
+  __m256i q[16];
+  __m256i w[32];
+  __m256i message[4] = {_mm256_loadu_si256(data), _mm256_loadu_si256(data + 1), _mm256_setzero_si256(), _mm256_setzero_si256()};
+  simdExpand(static_cast<const uint8_t*>(input), 64, tables.Offsets, tables, q);
+  simdMessageWords(q, w);
+  simdCompress(state, w, message);
+
+  // Length block
+  for (unsigned i = 0; i < 32; i++)
+    w[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(tables.LengthBlockWords[i]));
+  message[0] = _mm256_setr_epi32(512, 0, 0, 0, 0, 0, 0, 0);
+  message[1] = _mm256_setzero_si256();
+  simdCompress(state, w, message);
+
+  __m256i *out = static_cast<__m256i*>(output);
+  _mm256_storeu_si256(out, state[0]);
+  _mm256_storeu_si256(out + 1, state[1]);
+}
+
+// Multiplication by 2 in GF(2^8) for each byte
+__attribute__((target("aes")))
+static inline __m128i gfDouble(__m128i x)
+{
+  __m128i reduce = _mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x), _mm_set1_epi8(0x1B));
+  return _mm_xor_si128(_mm_add_epi8(x, x), reduce);
+}
+
+__attribute__((target("aes")))
+static inline void echoMixColumn(__m128i *W, unsigned ia, unsigned ib, unsigned ic, unsigned id)
+{
+  __m128i a = W[ia];
+  __m128i b = W[ib];
+  __m128i c = W[ic];
+  __m128i d = W[id];
+  __m128i ab = _mm_xor_si128(a, b);
+  __m128i bc = _mm_xor_si128(b, c);
+  __m128i cd = _mm_xor_si128(c, d);
+  __m128i abx = gfDouble(ab);
+  __m128i bcx = gfDouble(bc);
+  __m128i cdx = gfDouble(cd);
+  W[ia] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+  W[ib] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+  W[ic] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+  W[id] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(_mm_xor_si128(cdx, ab), c));
+}
+
+// ECHO-512, one 128-byte block: 8 chaining words, message, padding, digest size and bit counter 512
+__attribute__((target("aes")))
+static void echo512AESNI(const void *input, void *output)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i *data = static_cast<const __m128i*>(input);
+
+  __m128i W[16];
+  __m128i V[8];
+  for (unsigned i = 0; i < 8; i++)
+    V[i] = W[i] = _mm_set_epi64x(0, 512);
+  for (unsigned i = 0; i < 4; i++)
+    W[8+i] = _mm_loadu_si128(data + i);
+  W[12] = _mm_setr_epi32(0x80, 0, 0, 0);
+  W[13] = zero;
+  W[14] = _mm_setr_epi32(0, 0, 0, 512 << 16);
+  W[15] = _mm_setr_epi32(512, 0, 0, 0);
+
+  __m128i message[8];
+  for (unsigned i = 0; i < 8; i++)
+    message[i] = W[8+i];
+
+  uint32_t counter = 512;
+  for (unsigned round = 0; round < 10; round++) {
+    // SubWords
+    for (unsigned i = 0; i < 16; i++) {
+      W[i] = _mm_aesenc_si128(W[i], _mm_setr_epi32(counter++, 0, 0, 0));
+      W[i] = _mm_aesenc_si128(W[i], zero);
+    }
+
+    // ShiftRows
+    __m128i t = W[1];
+    W[1] = W[5];
+    W[5] = W[9];
+    W[9] = W[13];
+    W[13] = t;
+    t = W[2];
+    W[2] = W[10];
+    W[10] = t;
+    t = W[6];
+    W[6] = W[14];
+    W[14] = t;
+    t = W[15];
+    W[15] = W[11];
+    W[11] = W[7];
+    W[7] = W[3];
+    W[3] = t;
+
+    // MixColumns
+    echoMixColumn(W, 0, 1, 2, 3);
+    echoMixColumn(W, 4, 5, 6, 7);
+    echoMixColumn(W, 8, 9, 10, 11);
+    echoMixColumn(W, 12, 13, 14, 15);
+  }
+
+  __m128i *out = static_cast<__m128i*>(output);
+  for (unsigned i = 0; i < 4; i++)
+    _mm_storeu_si128(out + i, _mm_xor_si128(_mm_xor_si128(V[i], message[i]), _mm_xor_si128(W[i], W[i+8])));
+}
+
+static bool cpuHasAES()
+{
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return ecx & bit_AES;
+}
+
+#endif
+
+static CHashKernels selectKernels()
+{
+  CHashKernels kernels = {
+    luffa512Generic, cubehash512Generic, shavite512Generic, simd512Generic, echo512Generic,
+    "luffa: sph, cubehash: sph, shavite: sph, simd: sph, echo: sph"
+  };
+#ifdef HASH_KERNELS_X86
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+  bool aes = cpuHasAES();
+  if (avx2) {
+    kernels.Luffa512 = luffa512AVX2;
+    kernels.CubeHash512 = cubehash512AVX2;
+    kernels.Simd512 = simd512AVX2;
+  }
+  if (aes) {
+    kernels.Shavite512 = shavite512AESNI;
+    kernels.Echo512 = echo512AESNI;
+  }
+
+  if (avx2 && aes)
+    kernels.Description = "luffa: avx2, cubehash: avx2, shavite: aes-ni, simd: avx2, echo: aes-ni";
+  else if (avx2)
+    kernels.Description = "luffa: avx2, cubehash: avx2, shavite: sph, simd: avx2, echo: sph";
+  else if (aes)
+    kernels.Description = "luffa: sph, cubehash: sph, shavite: aes-ni, simd: sph, echo: aes-ni";
+#endif
+  LOG_F(INFO, "Hash kernels: %s", kernels.Description);
+  return kernels;
+}
+
+const CHashKernels &hashKernels()
+{
+  static const CHashKernels kernels = selectKernels();
+  return kernels;
+}
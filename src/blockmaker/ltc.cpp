@@ -2,10 +2,15 @@
 #include "blockmaker/ltc.h"
 #include "blockmaker/scrypt.h"
 
-bool LTC::Proto::checkPow(const Proto::BlockHeader &header, uint32_t nBits, double *shareDiff)
+bool LTC::Proto::checkPow(const Proto::BlockHeader &header, uint32_t nBits, double *shareDiff, const arith_uint256 *shareTarget)
 {
   arith_uint256 scryptHash;
   scrypt_1024_1_1_256(reinterpret_cast<const char*>(&header), reinterpret_cast<char*>(scryptHash.begin()));
+  if (shareTarget && scryptHash.GreaterThan(*shareTarget)) {
+    *shareDiff = 0.0;
+    return false;
+  }
+
   *shareDiff = BTC::difficultyFromBits(scryptHash.GetCompact(), 29);
 
   bool fNegative;
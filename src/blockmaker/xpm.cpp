@@ -286,121 +286,60 @@ static int64_t targetGetMint(unsigned int nBits)
   return nMint;
 }
 
-static unsigned getSmallestDivisor(const CDivisionChecker &checker32,
-                                   mpz_t origin,
-                                   Proto::EChainType type,
-                                   unsigned chainLength,
-                                   unsigned target,
-                                   unsigned rangeBegin,
-                                   unsigned rangeEnd)
+// Position of first element divisible by prime in chain n, 2n+1, ... (sophieGermain) or n, 2n-1, ... (limited by target)
+static inline unsigned firstDivisibleElement(int prime, int remainder, bool isSophieGermain, unsigned target)
+{
+  for (unsigned i = 0; i < target; i++) {
+    if (remainder == 0)
+      return i;
+    remainder = isSophieGermain ? remainder * 2 + 1 : remainder * 2 - 1;
+    if (remainder >= prime)
+      remainder -= prime;
+  }
+
+  return target;
+}
+
+// Returns mask of chain types (1 << EChainType) having divisor in primes [rangeBegin, rangeEnd) at first 'target' elements
+// All chain types checked with one pass over primes
+static unsigned getDivisibleChainTypes(const CDivisionChecker &checker32,
+                                       mpz_t origin,
+                                       unsigned target,
+                                       unsigned rangeBegin,
+                                       unsigned rangeEnd)
 {
-  mpz_class localOrigin(origin);
+  constexpr unsigned AllTypes = (1u << Proto::ECunninghamChain1) | (1u << Proto::ECunninghamChain2) | (1u << Proto::EBiTwin);
+  unsigned c1Target = target/2 + (target % 2);
+  unsigned c2Target = target/2;
+  unsigned mask = 0;
 
-  unsigned divisor = -1U;
   size_t limbsNumber;
   uint32_t limbs[2048 / 32];
   mpz_export(limbs, &limbsNumber, -1, 4, 0, 0, origin);
 
   unsigned lastPrimeIndex = rangeEnd == -1U ? 131072 : rangeEnd;
-  if (type == Proto::ECunninghamChain1) {
-    for (unsigned primeIdx = rangeBegin; primeIdx < lastPrimeIndex; primeIdx++) {
-      int prime = checker32.prime(primeIdx);
-      int remainder = checker32.mod32(limbs, limbsNumber, primeIdx);
-
-      remainder--;
-      if (remainder < 0)
-        remainder = prime - 1;
-
-      bool isDivisor = false;
-      for (unsigned i = 0; i < target; i++) {
-        if (remainder == 0) {
-          isDivisor = true;
-          break;
-        }
-        remainder = remainder * 2 + 1;
-        if (remainder >= prime)
-          remainder -= prime;
-      }
-
-      if (isDivisor) {
-        divisor = primeIdx;
-        break;
-      }
-    }
-  } else if (type == Proto::ECunninghamChain2) {
-    for (unsigned primeIdx = rangeBegin; primeIdx < lastPrimeIndex; primeIdx++) {
-      int prime = checker32.prime(primeIdx);
-      int remainder = checker32.mod32(limbs, limbsNumber, primeIdx);
-
-      remainder++;
-      if (remainder >= prime)
-        remainder -= prime;
-
-      bool isDivisor = false;
-      for (unsigned i = 0; i < target; i++) {
-        if (remainder == 0) {
-          isDivisor = true;
-          break;
-        }
-        remainder = remainder * 2 - 1;
-        if (remainder >= prime)
-          remainder -= prime;
-      }
-
-      if (isDivisor) {
-        divisor = primeIdx;
-        break;
-      }
-    }
-  } else {
-    for (unsigned primeIdx = rangeBegin; primeIdx < lastPrimeIndex; primeIdx++) {
-      unsigned c1Target = target/2 + (target % 2);
-      unsigned c2Target = target/2;
-      int prime = checker32.prime(primeIdx);
-      int remOrigin = checker32.mod32(limbs, limbsNumber, primeIdx);
-      bool isDivisor = false;
-      {
-        int remainder = remOrigin - 1;
-        if (remainder < 0)
-          remainder = prime - 1;
-        for (unsigned i = 0; i < c1Target; i++) {
-          if (remainder == 0) {
-            isDivisor = true;
-            break;
-          }
-          remainder = remainder * 2 + 1;
-          if (remainder >= prime)
-            remainder -= prime;
-        }
-
-        if (isDivisor) {
-          divisor = primeIdx;
-          break;
-        }
-      }
-      {
-        int remainder = remOrigin + 1;
-        if (remainder >= prime)
-          remainder -= prime;
-        for (unsigned i = 0; i < c2Target; i++) {
-          if (remainder == 0) {
-            isDivisor = true;
-            break;
-          }
-          remainder = remainder * 2 - 1;
-          if (remainder >= prime)
-            remainder -= prime;
-        }
-
-        if (isDivisor) {
-          divisor = primeIdx;
-          break;
-        }
-      }
-    }
+  for (unsigned primeIdx = rangeBegin; primeIdx < lastPrimeIndex && mask != AllTypes; primeIdx++) {
+    int prime = checker32.prime(primeIdx);
+    int remOrigin = checker32.mod32(limbs, limbsNumber, primeIdx);
+
+    int c1Remainder = remOrigin - 1;
+    if (c1Remainder < 0)
+      c1Remainder = prime - 1;
+    int c2Remainder = remOrigin + 1;
+    if (c2Remainder >= prime)
+      c2Remainder -= prime;
+
+    unsigned c1Divisible = firstDivisibleElement(prime, c1Remainder, true, target);
+    unsigned c2Divisible = firstDivisibleElement(prime, c2Remainder, false, target);
+    if (c1Divisible < target)
+      mask |= 1u << Proto::ECunninghamChain1;
+    if (c2Divisible < target)
+      mask |= 1u << Proto::ECunninghamChain2;
+    if (c1Divisible < c1Target || c2Divisible < c2Target)
+      mask |= 1u << Proto::EBiTwin;
   }
 
-  return divisor;
+  return mask;
 }
 
 void Proto::checkConsensusInitialize(Proto::CheckConsensusCtx &ctx)
@@ -737,10 +676,22 @@ double Zmq::Work::expectedWork()
   return expectedWork;
 }
 
+unsigned Zmq::Work::divisibleChainTypes(Proto::CheckConsensusCtx &ctx, double shareTarget, WorkerConfig &workerConfig)
+{
+  XPM::Proto::BlockHashTy hash = Header.GetOriginalHeaderHash();
+  uint256ToBN(ctx.bnPrimeChainOrigin, hash);
+  mpz_mul(ctx.bnPrimeChainOrigin, ctx.bnPrimeChainOrigin, Header.bnPrimeChainMultiplier.get_mpz_t());
+  if (mpz_sizeinbase(ctx.bnPrimeChainOrigin, 2) > 2000)
+    return 0;
+
+  int headerChainLength = std::max(TargetGetLength(Header.nBits), static_cast<unsigned>(shareTarget));
+  return getDivisibleChainTypes(Zmq::DivisionChecker_, ctx.bnPrimeChainOrigin, headerChainLength, 0, workerConfig.WeaveDepth);
+}
+
 double Zmq::Work::shareWork(Proto::CheckConsensusCtx &ctx,
-                            double shareDiff,
                             double shareTarget,
                             const CExtraInfo &info,
+                            unsigned divisibleTypes,
                             WorkerConfig &workerConfig)
 {
   constexpr unsigned ShareWindowSize = 128;
@@ -750,17 +701,9 @@ double Zmq::Work::shareWork(Proto::CheckConsensusCtx &ctx,
   uint256ToBN(ctx.bnPrimeChainOrigin, hash);
   mpz_mul(ctx.bnPrimeChainOrigin, ctx.bnPrimeChainOrigin, Header.bnPrimeChainMultiplier.get_mpz_t());
   unsigned bnPrimeChainOriginBitSize = mpz_sizeinbase(ctx.bnPrimeChainOrigin, 2);
-  unsigned chainLength = static_cast<unsigned>(shareDiff);
   int headerChainLength = std::max(TargetGetLength(Header.nBits), static_cast<unsigned>(shareTarget));
 
-  unsigned smallestDivisor = getSmallestDivisor(Zmq::DivisionChecker_,
-                                                ctx.bnPrimeChainOrigin,
-                                                info.ChainType,
-                                                chainLength,
-                                                headerChainLength,
-                                                0,
-                                                workerConfig.WeaveDepth);
-  if (smallestDivisor != -1U)
+  if (divisibleTypes & (1u << info.ChainType))
     return 0.0;
 
   workerConfig.SharesBitSize.push_back(bnPrimeChainOriginBitSize);
@@ -143,7 +143,8 @@ public:
   };
 
   static void checkConsensusInitialize(CheckConsensusCtx&) {}
-  static bool checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, ChainParams&, double *shareDiff);
+  // Hash above shareTarget (if set) rejected early: shareDiff set to 0, block not checked
+  static bool checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, ChainParams&, double *shareDiff, const arith_uint256 *shareTarget = nullptr);
   static bool checkConsensus(const Proto::Block &block, CheckConsensusCtx &ctx, ChainParams &params, double *shareDiff) { return checkConsensus(block.header, ctx, params, shareDiff); }
   static double getDifficulty(const Proto::BlockHeader &header) { return BTC::difficultyFromBits(header.nBits, 29); }
   static std::string makeHumanReadableAddress(uint8_t pubkeyAddressPrefix, const BTC::Proto::AddressTy &address);
@@ -268,6 +269,8 @@ public:
   static bool keepOldWorkForBackend(const std::string&) { return false; }
 
   static void buildSendTargetMessage(xmstream &stream, double difficulty) { buildSendTargetMessageImpl(stream, difficulty, DifficultyFactor); }
+  // Share difficulty is difficultyFromBits(compact(hash), 29), difficulty 1 target is 0xFFFF << 208
+  static arith_uint256 shareTarget(double difficulty) { return compactDifficultyShareTarget<208>(difficulty); }
 
 public:
   static void buildSendTargetMessageImpl(xmstream &stream, double difficulty, double factor) {
@@ -6,6 +6,7 @@
 #include "serialize.h"
 #include "loguru.hpp"
 #include <openssl/rand.h>
+#include <algorithm>
 #include <unordered_map>
 
 namespace BTC {
@@ -139,8 +140,17 @@ struct CWorkerConfig {
 
 struct CoinbaseTx {
   xmstream Data;
-  unsigned ExtraDataOffset;
-  unsigned ExtraNonceOffset;
+  unsigned ExtraDataOffset = 0;
+  unsigned ExtraNonceOffset = 0;
+  // SHA-256 state after 64-byte blocks of data before extra nonce, constant for work
+  SHA256_CTX Midstate;
+  unsigned MidstateSize = 0;
+
+  void updateMidstate() {
+    MidstateSize = std::min(ExtraNonceOffset, static_cast<unsigned>(Data.sizeOf())) & ~63u;
+    SHA256_Init(&Midstate);
+    SHA256_Update(&Midstate, Data.data(), MidstateSize);
+  }
 };
 
 struct TxData {
@@ -262,7 +272,7 @@ public:
     buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, MerklePath, this->MiningCfg_, true, this->NotifyMessage_);
   }
 
-  virtual bool checkConsensus(size_t, double *shareDiff) override { return checkConsensusImpl(Header, ConsensusCtx_, shareDiff); }
+  virtual bool checkConsensus(size_t, double *shareDiff, const arith_uint256 *shareTarget) override { return checkConsensusImpl(Header, ConsensusCtx_, shareDiff, shareTarget); }
 
   virtual void buildNotifyMessage(bool resetPreviousWork) override {
     buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, MerklePath, this->MiningCfg_, resetPreviousWork, this->NotifyMessage_);
@@ -360,11 +370,13 @@ public:
   /// Build & serialize custom coinbase transaction
   void buildCoinbaseTx(void *coinbaseData, size_t coinbaseSize, const MiningConfig &miningCfg, CoinbaseTx &legacy, CoinbaseTx &witness) {
     CoinbaseBuilder_.build(this->Height_, this->BlockReward_, coinbaseData, coinbaseSize, this->CoinbaseMessage_, this->MiningAddress_, miningCfg, SegwitEnabled, WitnessCommitment, legacy, witness);
+    // Only legacy coinbase hashed for merkle root on submit
+    legacy.updateMidstate();
   }
 
-  static bool checkConsensusImpl(const typename Proto::BlockHeader &header, typename Proto::CheckConsensusCtx &consensusCtx, double *shareDiff) {
+  static bool checkConsensusImpl(const typename Proto::BlockHeader &header, typename Proto::CheckConsensusCtx &consensusCtx, double *shareDiff, const arith_uint256 *shareTarget) {
     typename Proto::ChainParams params;
-    return Proto::checkConsensus(header, consensusCtx, params, shareDiff);
+    return Proto::checkConsensus(header, consensusCtx, params, shareDiff, shareTarget);
   }
 
   static void buildNotifyMessageImpl(StratumWork<typename Proto::BlockHashTy, MiningConfigTy, WorkerConfigTy, StratumMessageTy> *source, typename Proto::BlockHeader &header, uint32_t asicBoostData, CoinbaseTx &legacy, const std::vector<uint256> &merklePath, const MiningConfig &cfg, bool resetPreviousWork, xmstream &notifyMessage) {
@@ -41,7 +41,7 @@ public:
   using ChainParams = BTC::Proto::ChainParams;
 
   static void checkConsensusInitialize(CheckConsensusCtx&) {}
-  static bool checkConsensus(const BlockHeader&, CheckConsensusCtx&, ChainParams&, double *shareDiff);
+  static bool checkConsensus(const BlockHeader&, CheckConsensusCtx&, ChainParams&, double *shareDiff, const arith_uint256 *shareTarget = nullptr);
   static bool checkConsensus(const Block &block, CheckConsensusCtx &ctx, ChainParams &chainParams, double *shareDiff) { return checkConsensus(block.header, ctx, chainParams, shareDiff); }
   static double getDifficulty(const Proto::BlockHeader &header) { return BTC::difficultyFromBits(header.nBits, 29); }
   static bool decodeHumanReadableAddress(const std::string &hrAddress, const std::vector<uint8_t> &pubkeyAddressPrefix, AddressTy &address) { return BTC::Proto::decodeHumanReadableAddress(hrAddress, pubkeyAddressPrefix, address); }
@@ -72,6 +72,7 @@ public:
   static bool isMainBackend(const std::string&) { return true; }
   static bool keepOldWorkForBackend(const std::string&) { return false; }
   static void buildSendTargetMessage(xmstream &stream, double difficulty) { BTC::Stratum::buildSendTargetMessageImpl(stream, difficulty, DifficultyFactor); }
+  static arith_uint256 shareTarget(double difficulty) { return BTC::Stratum::shareTarget(difficulty); }
 };
 
 template<Algo algo>
@@ -38,10 +38,10 @@ public:
   using ChainParams = BTC::Proto::ChainParams;
 
   static void checkConsensusInitialize(CheckConsensusCtx&) {}
-  static bool checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, Proto::ChainParams&, double *shareDiff) {
+  static bool checkConsensus(const Proto::BlockHeader &header, CheckConsensusCtx&, Proto::ChainParams&, double *shareDiff, const arith_uint256 *shareTarget = nullptr) {
     return header.nVersion & Proto::BlockHeader::VERSION_AUXPOW ?
-      LTC::Proto::checkPow(header.ParentBlock, header.nBits, shareDiff) :
-      LTC::Proto::checkPow(header, header.nBits, shareDiff);
+      LTC::Proto::checkPow(header.ParentBlock, header.nBits, shareDiff, shareTarget) :
+      LTC::Proto::checkPow(header, header.nBits, shareDiff, shareTarget);
   }
 
   static bool checkConsensus(const Proto::Block &block, CheckConsensusCtx &ctx, Proto::ChainParams &chainParams, double *shareDiff) { return checkConsensus(block.header, ctx, chainParams, shareDiff); }
@@ -96,11 +96,11 @@ public:
       }
     }
 
-    virtual bool checkConsensus(size_t workIdx, double *shareDiff) override {
+    virtual bool checkConsensus(size_t workIdx, double *shareDiff, const arith_uint256 *shareTarget) override {
       if (workIdx == 0)
-        return DOGE::Stratum::Work::checkConsensusImpl(DOGEHeader_, LTCConsensusCtx_, shareDiff);
+        return DOGE::Stratum::Work::checkConsensusImpl(DOGEHeader_, LTCConsensusCtx_, shareDiff, shareTarget);
       else if (workIdx == 1)
-        return LTC::Stratum::Work::checkConsensusImpl(LTCHeader_, DOGEConsensusCtx_, shareDiff);
+        return LTC::Stratum::Work::checkConsensusImpl(LTCHeader_, DOGEConsensusCtx_, shareDiff, shareTarget);
       return false;
     }
 
@@ -125,6 +125,7 @@ public:
   static bool isMainBackend(const std::string &ticker) { return ticker == "DOGE" || ticker == "DOGE.testnet" || ticker == "DOGE.regtest"; }
   static bool keepOldWorkForBackend(const std::string&) { return false; }
   static void buildSendTargetMessage(xmstream &stream, double difficulty) { BTC::Stratum::buildSendTargetMessageImpl(stream, difficulty, DifficultyFactor); }
+  static arith_uint256 shareTarget(double difficulty) { return BTC::Stratum::shareTarget(difficulty); }
 };
 
 struct X {
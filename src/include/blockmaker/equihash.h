@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Equihash solution verifier
+// Check order:
+//   - solution size, index ordering and uniqueness (no hashing)
+//   - leaf hashes from precomputed BLAKE2b state (4 leaves per pass with AVX2)
+//   - collision tree, merged depth-first without memory allocation
+template<unsigned N, unsigned K>
+class CEquihashVerifier {
+public:
+  static constexpr unsigned CollisionBitLength = N/(K+1);
+  static constexpr unsigned IndicesNum = 1u << K;
+  static constexpr unsigned IndicesPerHashOutput = 512/N;
+  static constexpr unsigned HashOutput = IndicesPerHashOutput*N/8;
+  static constexpr size_t SolutionWidth = IndicesNum*(CollisionBitLength+1)/8;
+
+public:
+  // input is serialized block header without solution
+  static bool verify(const uint8_t *input, size_t inputSize, const uint8_t *solution, size_t solutionSize);
+};
+
+extern template class CEquihashVerifier<200, 9>;
+extern template class CEquihashVerifier<48, 5>;
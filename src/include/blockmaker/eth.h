@@ -133,7 +133,7 @@ public:
 
     virtual void mutate() override {}
 
-    virtual bool checkConsensus(size_t, double *shareDiff) override;
+    virtual bool checkConsensus(size_t, double *shareDiff, const arith_uint256 *shareTarget) override;
 
     virtual void buildNotifyMessage(bool resetPreviousWork) override;
 
@@ -172,6 +172,9 @@ public:
     }
   }
 
+  // Share difficulty is getDifficulty(compact(hash)), difficulty 1 target is 0xFFFF << 208
+  static arith_uint256 shareTarget(double difficulty) { return compactDifficultyShareTarget<208>(difficulty); }
+
   using SecondWork = StratumSingleWorkEmpty<Proto::BlockHashTy, MiningConfig, WorkerConfig, StratumMessage>;
   using MergedWork = StratumMergedWorkEmpty<Proto::BlockHashTy, MiningConfig, WorkerConfig, StratumMessage>;
 };
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// Hash functions of chained algorithms (DGB Qubit) with 512-bit output; all except Luffa take 64-byte input
+// Implementation selected once by CPU features: AVX2 Luffa, CubeHash and SIMD, AES-NI SHAvite-3 and ECHO; sph_* otherwise
+struct CHashKernels {
+  void (*Luffa512)(const void *input, size_t size, void *output);
+  void (*CubeHash512)(const void *input, void *output);
+  void (*Shavite512)(const void *input, void *output);
+  void (*Simd512)(const void *input, void *output);
+  void (*Echo512)(const void *input, void *output);
+  // Human readable description of selected implementations
+  const char *Description;
+};
+
+const CHashKernels &hashKernels();
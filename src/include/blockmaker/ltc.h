@@ -25,9 +25,9 @@ public:
   using CheckConsensusCtx = BTC::Proto::CheckConsensusCtx;
   using ChainParams = BTC::Proto::ChainParams;
 
-  static bool checkPow(const Proto::BlockHeader &header, uint32_t nBits, double *shareDiff);
+  static bool checkPow(const Proto::BlockHeader &header, uint32_t nBits, double *shareDiff, const arith_uint256 *shareTarget = nullptr);
   static void checkConsensusInitialize(CheckConsensusCtx&) {}
-  static bool checkConsensus(const LTC::Proto::BlockHeader &header, CheckConsensusCtx&, LTC::Proto::ChainParams&, double *shareDiff) { return checkPow(header, header.nBits, shareDiff); }
+  static bool checkConsensus(const LTC::Proto::BlockHeader &header, CheckConsensusCtx&, LTC::Proto::ChainParams&, double *shareDiff, const arith_uint256 *shareTarget = nullptr) { return checkPow(header, header.nBits, shareDiff, shareTarget); }
   static bool checkConsensus(const LTC::Proto::Block &block, CheckConsensusCtx&, LTC::Proto::ChainParams&, double *shareDiff) { return checkPow(block.header, block.header.nBits, shareDiff); }
   static double getDifficulty(const Proto::BlockHeader &header) { return BTC::difficultyFromBits(header.nBits, 29); }
   static bool decodeHumanReadableAddress(const std::string &hrAddress, const std::vector<uint8_t> &pubkeyAddressPrefix, AddressTy &address) { return BTC::Proto::decodeHumanReadableAddress(hrAddress, pubkeyAddressPrefix, address); }
@@ -48,6 +48,7 @@ public:
   static bool isMainBackend(const std::string&) { return true; }
   static bool keepOldWorkForBackend(const std::string&) { return false; }
   static void buildSendTargetMessage(xmstream &stream, double difficulty) { BTC::Stratum::buildSendTargetMessageImpl(stream, difficulty, DifficultyFactor); }
+  static arith_uint256 shareTarget(double difficulty) { return BTC::Stratum::shareTarget(difficulty); }
 };
 
 struct X {
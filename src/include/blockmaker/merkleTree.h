@@ -72,6 +72,21 @@ static inline uint256 calculateMerkleRoot(const void *data, size_t size, const s
   return calculateMerkleRoot(result, &merklePath[0], merklePath.size());
 }
 
+// Merkle root for data which prefix (midstateSize bytes, multiple of 64) already hashed to midstate
+static inline uint256 calculateMerkleRoot(const SHA256_CTX &midstate, size_t midstateSize, const void *data, size_t size, const std::vector<uint256> &merklePath)
+{
+  uint256 result;
+  SHA256_CTX sha256 = midstate;
+  if (!midstateSize)
+    SHA256_Init(&sha256);
+  SHA256_Update(&sha256, static_cast<const uint8_t*>(data) + midstateSize, size - midstateSize);
+  SHA256_Final(result.begin(), &sha256);
+  SHA256_Init(&sha256);
+  SHA256_Update(&sha256, result.begin(), result.size());
+  SHA256_Final(result.begin(), &sha256);
+  return calculateMerkleRoot(result, &merklePath[0], merklePath.size());
+}
+
 static inline void dumpMerkleTree(std::vector<uint256> &hashes, std::vector<uint256> &out)
 {
   out.clear();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "poolcore/blockTemplate.h"
+#include "poolcommon/arith_uint256.h"
 #include "p2putils/xmstream.h"
 #include <string>
 #include <vector>
@@ -37,7 +38,8 @@ public:
   virtual void buildBlock(size_t workIdx, xmstream &stream) = 0;
   virtual bool ready() = 0;
   virtual void mutate() = 0;
-  virtual bool checkConsensus(size_t workIdx, double *shareDiff) = 0;
+  // Hash above shareTarget rejected without difficulty calculation (shareDiff set to 0)
+  virtual bool checkConsensus(size_t workIdx, double *shareDiff, const arith_uint256 *shareTarget) = 0;
   virtual void buildNotifyMessage(bool resetPreviousWork) = 0;
   virtual bool prepareForSubmit(const WorkerConfig &workerCfg, const StratumMessage &msg) = 0;
   virtual double getAbstractProfitValue(size_t workIdx, double price, double coeff) = 0;
@@ -151,7 +153,7 @@ public:
   virtual void buildBlock(size_t, xmstream&) final {}
   virtual bool ready() final { return false; }
   virtual void mutate() final {}
-  virtual bool checkConsensus(size_t, double*) final { return false; }
+  virtual bool checkConsensus(size_t, double*, const arith_uint256*) final { return false; }
   virtual void buildNotifyMessage(bool) final {}
   virtual bool prepareForSubmit(const WorkerConfig&, const StratumMessage&) final { return false; }
   virtual bool loadFromTemplate(CBlockTemplate&, const std::string&, std::string&) final { return false; }
@@ -172,5 +174,5 @@ public:
   virtual void mutate() final {}
   virtual void buildNotifyMessage(bool) final {}
   virtual bool prepareForSubmit(const WorkerConfig&, const StratumMessage&) final { return false; }
-  virtual bool checkConsensus(size_t, double*) final { return false; }
+  virtual bool checkConsensus(size_t, double*, const arith_uint256*) final { return false; }
 };
@@ -177,7 +177,13 @@ public:
       return XPM::Proto::checkConsensus(Header, ctx, params, shareDiff, &info->ChainType);
     }
 
-    double shareWork(Proto::CheckConsensusCtx &ctx, double shareDiff, double shareTarget, const CExtraInfo &info, WorkerConfig &workerConfig);
+    // Mask of chain types (1 << EChainType) having small divisor for current weave depth
+    // Share can be rejected before primality tests if all chain types are divisible
+    unsigned divisibleChainTypes(Proto::CheckConsensusCtx &ctx, double shareTarget, WorkerConfig &workerConfig);
+    bool allChainTypesDivisible(unsigned divisibleTypes) {
+      return divisibleTypes == ((1u << Proto::ECunninghamChain1) | (1u << Proto::ECunninghamChain2) | (1u << Proto::EBiTwin));
+    }
+    double shareWork(Proto::CheckConsensusCtx &ctx, double shareTarget, const CExtraInfo &info, unsigned divisibleTypes, WorkerConfig &workerConfig);
     uint32_t primePOWTarget();
   };
 
@@ -231,6 +231,15 @@ public:
     int CompareTo(const base_uint& b) const;
     bool EqualTo(uint64_t b) const;
 
+    /** Branchless comparison (*this > b): borrow of b - *this over all words */
+    bool GreaterThan(const base_uint& b) const
+    {
+        uint64_t borrow = 0;
+        for (int i = 0; i < WIDTH; i++)
+            borrow = (static_cast<uint64_t>(b.pn[i]) - pn[i] - borrow) >> 63;
+        return borrow != 0;
+    }
+
     friend inline const base_uint operator+(const base_uint& a, const base_uint& b) { return base_uint(a) += b; }
     friend inline const base_uint operator-(const base_uint& a, const base_uint& b) { return base_uint(a) -= b; }
     friend inline const base_uint operator*(const base_uint& a, const base_uint& b) { return base_uint(a) *= b; }
@@ -317,4 +326,35 @@ public:
 uint256 ArithToUint256(const arith_uint256 &);
 arith_uint256 UintToArith256(const uint256 &);
 
+/**
+ * Share targets for share check without floating point: hash above target has difficulty below required.
+ * Targets slightly wider than exact difficulty threshold (difficulty computed from rounded hash),
+ * hashes not above target still checked by floating point difficulty.
+ */
+
+/** Difficulty is (0xFFFF << DiffOneShift) / compact(hash), compact mantissa keeps at least 15 significant bits */
+template<unsigned DiffOneShift>
+arith_uint256 compactDifficultyShareTarget(double difficulty)
+{
+    static_assert(DiffOneShift + 16 <= 256, "difficulty 1 target out of range");
+    double target = ldexp(65535.0 * (1.0 + ldexp(1.0, -14)) / difficulty, DiffOneShift);
+    if (!(difficulty > 0.0 && target < ldexp(1.0, 256)))
+        return ~arith_uint256();
+    return arith_uint256(target);
+}
+
+/** Difficulty is DiffOne / (hash >> Shift) */
+template<uint64_t DiffOne, unsigned Shift>
+arith_uint256 truncatedDifficultyShareTarget(double difficulty)
+{
+    static_assert(Shift < 256, "shift out of range");
+    // Hash with (hash >> Shift) > DiffOne / difficulty + 1 can't pass difficulty check
+    double mantissa = floor(static_cast<double>(DiffOne) / difficulty) + 2.0;
+    if (!(difficulty > 0.0 && mantissa < ldexp(1.0, 256 - Shift)))
+        return ~arith_uint256();
+    arith_uint256 target(mantissa);
+    target <<= Shift;
+    return --target;
+}
+
 #endif // BITCOIN_ARITH_UINT256_H
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli), used for on-disk record checksums
+uint32_t crc32c(uint32_t crc, const void *data, size_t size);
@@ -1,8 +1,11 @@
 #pragma once
 
-static constexpr bool isDebugInstanceStratumMessages() { return 0; }
-static constexpr bool isDebugInstanceStratumRejects() { return 0; }
-static constexpr bool isDebugInstanceStratumConnections() { return 0; }
-static constexpr bool isDebugBackend() { return 0; }
-static constexpr bool isDebugAccounting() { return 0; }
-static constexpr bool isDebugStatistic() { return 0; }
+#include "poolcommon/trace.h"
+
+// Switched at runtime by traceConfigure
+static inline bool isDebugInstanceStratumMessages() { return traceEnabled(ETraceStratumMessages); }
+static inline bool isDebugInstanceStratumRejects() { return traceEnabled(ETraceStratumRejects); }
+static inline bool isDebugInstanceStratumConnections() { return traceEnabled(ETraceStratumConnections); }
+static inline bool isDebugBackend() { return traceEnabled(ETraceBackend); }
+static inline bool isDebugAccounting() { return traceEnabled(ETraceAccounting); }
+static inline bool isDebugStatistic() { return traceEnabled(ETraceStatistic); }
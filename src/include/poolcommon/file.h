@@ -38,3 +38,23 @@ private:
 #endif
 };
 
+// Read-only mapping of whole file, empty files can't be mapped
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile &operator=(const MappedFile&) = delete;
+  ~MappedFile() { close(); }
+
+  bool open(const std::filesystem::path &path);
+  void close();
+  const void *data() const { return Data_; }
+  size_t size() const { return Size_; }
+
+private:
+  void *Data_ = nullptr;
+  size_t Size_ = 0;
+#ifdef _WIN32
+  HANDLE Mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+// Hex encoding and decoding of byte arrays
+// Implementation selected once by CPU features: AVX2, SSSE3 or scalar; short inputs always use scalar code
+
+// Writes 2*size characters to out, without terminating zero
+void hexEncode(const void *in, char *out, size_t size, bool upperCase = false);
+
+// Decodes inSize/2 bytes to out, accepts both cases of letters
+// Returns false if inSize is odd or input contains non-hex character (decoded data undefined in this case)
+bool hexDecode(const char *in, size_t inSize, void *out);
+
+// Human readable description of selected implementation
+const char *hexImplementation();
@@ -1,15 +1,11 @@
 #pragma once
 
+#include "poolcommon/hex.h"
 #include "p2putils/xmstream.h"
 #include <string>
 
 namespace JSON {
 
-static inline char bin2hexLowerCaseDigit(uint8_t b, bool upperCase)
-{
-  return b < 10 ? '0'+b : (upperCase ? 'A' : 'a') + b - 10;
-}
-
 class Object {
 public:
   Object(xmstream &stream) : Stream_(stream) { stream.write('{'); }
@@ -71,12 +67,7 @@ public:
     if (zeroxPrefix)
       Stream_.write("0x");
 
-    char *out = Stream_.reserve<char>(size*2);
-    const uint8_t *pIn = static_cast<const uint8_t*>(data);
-    for (size_t i = 0, ie = size; i != ie; ++i) {
-      out[i*2] = bin2hexLowerCaseDigit(pIn[i] >> 4, upperCase);
-      out[i*2+1] = bin2hexLowerCaseDigit(pIn[i] & 0xF, upperCase);
-    }
+    hexEncode(data, Stream_.reserve<char>(size*2), size, upperCase);
 
     Stream_.write('\"');
   }
@@ -177,12 +168,7 @@ public:
     if (zeroxPrefix)
       Stream_.write("0x");
 
-    char *out = Stream_.reserve<char>(size*2);
-    const uint8_t *pIn = static_cast<const uint8_t*>(data);
-    for (size_t i = 0, ie = size; i != ie; ++i) {
-      out[i*2] = bin2hexLowerCaseDigit(pIn[i] >> 4, upperCase);
-      out[i*2+1] = bin2hexLowerCaseDigit(pIn[i] & 0xF, upperCase);
-    }
+    hexEncode(data, Stream_.reserve<char>(size*2), size, upperCase);
 
     Stream_.write('\"');
   }
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Pool metrics in Prometheus text format
+// Counters and histograms sharded per thread: each thread updates only own shard with relaxed load and store,
+// shards summed on scrape. Metrics registered once and never destroyed, owners keep references
+
+static constexpr unsigned MetricsMaxThreads = 128;
+
+// Slot of current thread, last slot shared by threads over limit (updated with atomic add)
+unsigned metricsAllocateThreadSlot();
+static inline unsigned metricsThreadSlot()
+{
+  static thread_local unsigned slot = metricsAllocateThreadSlot();
+  return slot;
+}
+
+static inline unsigned metricsLog2(uint64_t value)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+static inline void metricsAdd(std::atomic<uint64_t> &value, uint64_t delta, unsigned slot)
+{
+  if (slot != MetricsMaxThreads - 1)
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  else
+    value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+class CMetricCounter {
+public:
+  void add(uint64_t value = 1) {
+    unsigned slot = metricsThreadSlot();
+    metricsAdd(Shards_[slot].Value, value, slot);
+  }
+
+  uint64_t value() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> Value = 0;
+  };
+
+  Shard Shards_[MetricsMaxThreads];
+};
+
+class CMetricGauge {
+public:
+  void set(int64_t value) { Value_.store(value, std::memory_order_relaxed); }
+  void add(int64_t value) { Value_.fetch_add(value, std::memory_order_relaxed); }
+  int64_t value() const { return Value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> Value_ = 0;
+};
+
+// Log-linear (HDR-like) histogram of nanosecond values: 8 linear sub-buckets per power of two (relative error < 12.5%)
+// Shard allocated at first record in thread
+class CMetricHistogram {
+public:
+  static constexpr unsigned SubBucketBits = 3;
+  static constexpr unsigned SubBuckets = 1u << SubBucketBits;
+  // Values above 2^MaxExponent ns (~18 minutes) counted in last bucket
+  static constexpr unsigned MaxExponent = 40;
+  static constexpr unsigned BucketsNum = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+  struct Shard {
+    std::atomic<uint64_t> Buckets[BucketsNum];
+    std::atomic<uint64_t> Count;
+    std::atomic<uint64_t> Sum;
+  };
+
+  struct Snapshot {
+    uint64_t Buckets[BucketsNum];
+    uint64_t Count;
+    uint64_t Sum;
+  };
+
+public:
+  ~CMetricHistogram();
+
+  static unsigned bucketIndex(uint64_t value) {
+    if (value < SubBuckets)
+      return static_cast<unsigned>(value);
+    unsigned exponent = metricsLog2(value);
+    if (exponent > MaxExponent)
+      return BucketsNum - 1;
+    return ((exponent - SubBucketBits + 1) << SubBucketBits) + static_cast<unsigned>((value >> (exponent - SubBucketBits)) & (SubBuckets - 1));
+  }
+
+  // Smallest value of bucket
+  static uint64_t bucketLowerBound(unsigned index) {
+    if (index < SubBuckets)
+      return index;
+    unsigned exponent = (index >> SubBucketBits) + SubBucketBits - 1;
+    return static_cast<uint64_t>(SubBuckets + (index & (SubBuckets - 1))) << (exponent - SubBucketBits);
+  }
+
+  void record(uint64_t nanoseconds) {
+    unsigned slot = metricsThreadSlot();
+    Shard *shard = Shards_[slot].load(std::memory_order_acquire);
+    if (!shard)
+      shard = allocateShard(slot);
+    metricsAdd(shard->Buckets[bucketIndex(nanoseconds)], 1, slot);
+    metricsAdd(shard->Count, 1, slot);
+    metricsAdd(shard->Sum, nanoseconds, slot);
+  }
+
+  void recordSince(std::chrono::steady_clock::time_point begin) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    record(elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0);
+  }
+
+  void snapshot(Snapshot &result) const;
+
+private:
+  Shard *allocateShard(unsigned slot);
+
+private:
+  std::atomic<Shard*> Shards_[MetricsMaxThreads] = {};
+};
+
+// Writer for collectors called on scrape (values owned by other subsystems)
+// Series of same metric from different collectors grouped together on output
+class CMetricsWriter {
+public:
+  void gauge(const char *name, const char *help, const std::string &labels, double value);
+  void counter(const char *name, const char *help, const std::string &labels, uint64_t value);
+  void write(std::string &out);
+
+private:
+  std::string &family(const char *name, const char *help, const char *type);
+
+private:
+  std::map<std::string, std::string> Families_;
+};
+
+// Label set in Prometheus format with escaped value: name="value"
+std::string metricLabel(const char *name, const std::string &value);
+std::string metricLabels(const char *name1, const std::string &value1, const char *name2, const std::string &value2);
+
+// Registry, returns existing metric for same name and labels
+CMetricCounter &metricCounter(const char *name, const char *help, const std::string &labels = std::string());
+CMetricGauge &metricGauge(const char *name, const char *help, const std::string &labels = std::string());
+// Exported in seconds
+CMetricHistogram &metricHistogram(const char *name, const char *help, const std::string &labels = std::string());
+// Returns handle for metricsRemoveCollector, owner must remove collector before destruction
+uint64_t metricsAddCollector(std::function<void(CMetricsWriter&)> collector);
+// After return collector is not running and will not be called
+void metricsRemoveCollector(uint64_t handle);
+
+// All registered metrics and collectors in Prometheus text exposition format
+void metricsScrape(std::string &out);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Slab allocator for objects of one type, not thread safe
+// Memory allocated by slabs of SlabSize objects and never returned to system, freed objects reused
+template<typename T, size_t SlabSize = 256>
+class CObjectPool {
+public:
+  CObjectPool() {}
+  CObjectPool(const CObjectPool&) = delete;
+  CObjectPool &operator=(const CObjectPool&) = delete;
+
+  template<typename... Args>
+  T *create(Args&&... args) {
+    if (!FreeList_)
+      allocateSlab();
+    Node *node = FreeList_;
+    FreeList_ = node->Next;
+    T *object = new (node->Storage) T(std::forward<Args>(args)...);
+    Used_++;
+    return object;
+  }
+
+  void destroy(T *object) {
+    object->~T();
+    Node *node = reinterpret_cast<Node*>(object);
+    node->Next = FreeList_;
+    FreeList_ = node;
+    Used_--;
+  }
+
+  size_t used() const { return Used_; }
+  size_t capacity() const { return Slabs_.size() * SlabSize; }
+  size_t memoryUsage() const { return capacity() * sizeof(Node); }
+
+private:
+  union Node {
+    Node *Next;
+    alignas(T) unsigned char Storage[sizeof(T)];
+  };
+
+  void allocateSlab() {
+    std::unique_ptr<Node[]> slab(new Node[SlabSize]);
+    for (size_t i = 0; i < SlabSize; i++)
+      slab[i].Next = i + 1 < SlabSize ? &slab[i+1] : FreeList_;
+    FreeList_ = &slab[0];
+    Slabs_.emplace_back(std::move(slab));
+  }
+
+private:
+  std::vector<std::unique_ptr<Node[]>> Slabs_;
+  Node *FreeList_ = nullptr;
+  size_t Used_ = 0;
+};
+
+// Pool of equally sized buffers, not thread safe
+// Keeps up to MaxIdle free buffers for reuse, other freed buffers returned to system
+class CBufferPool {
+public:
+  CBufferPool(size_t bufferSize, size_t maxIdle) : BufferSize_(bufferSize), MaxIdle_(maxIdle) {}
+  CBufferPool(const CBufferPool&) = delete;
+  CBufferPool &operator=(const CBufferPool&) = delete;
+  ~CBufferPool() {
+    for (char *buffer: Idle_)
+      delete[] buffer;
+  }
+
+  size_t bufferSize() const { return BufferSize_; }
+
+  char *acquire() {
+    Used_++;
+    if (!Idle_.empty()) {
+      char *buffer = Idle_.back();
+      Idle_.pop_back();
+      return buffer;
+    }
+
+    return new char[BufferSize_];
+  }
+
+  void release(char *buffer) {
+    Used_--;
+    if (Idle_.size() < MaxIdle_)
+      Idle_.push_back(buffer);
+    else
+      delete[] buffer;
+  }
+
+  size_t used() const { return Used_; }
+  size_t memoryUsage() const { return (Used_ + Idle_.size()) * BufferSize_; }
+
+private:
+  size_t BufferSize_;
+  size_t MaxIdle_;
+  std::vector<char*> Idle_;
+  size_t Used_ = 0;
+};
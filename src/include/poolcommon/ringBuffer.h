@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+// Fixed capacity ring buffer, pushing to full buffer overwrites oldest element
+template<typename T, size_t N>
+class CRingBuffer {
+public:
+  void push(const T &value) {
+    Data_[(Begin_ + Size_) % N] = value;
+    if (Size_ < N)
+      Size_++;
+    else
+      Begin_ = (Begin_ + 1) % N;
+  }
+
+  void clear() { Begin_ = 0; Size_ = 0; }
+  size_t size() const { return Size_; }
+  bool empty() const { return Size_ == 0; }
+  static constexpr size_t capacity() { return N; }
+
+  // Index 0 is oldest element
+  T &operator[](size_t index) { return Data_[(Begin_ + index) % N]; }
+  const T &operator[](size_t index) const { return Data_[(Begin_ + index) % N]; }
+  T &front() { return Data_[Begin_]; }
+  T &back() { return Data_[(Begin_ + Size_ - 1) % N]; }
+
+private:
+  T Data_[N];
+  size_t Begin_ = 0;
+  size_t Size_ = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "coroutineJoin.h"
+#include "metrics.h"
 #include "tbb/concurrent_queue.h"
 #include "asyncio/asyncio.h"
 
@@ -30,7 +31,12 @@ public:
     coroutineJoin(threadName, taskHandlerName, &TaskHandlerFinished);
   }
 
+  // Queue depth exported as metric (optional)
+  void setQueueDepthGauge(CMetricGauge *gauge) { QueueDepth_ = gauge; }
+
   void push(Task<ObjectTy> *task) {
+    if (QueueDepth_)
+      QueueDepth_->add(1);
     TaskQueue_.push(task);
     userEventActivate(TaskQueueEvent_);
   }
@@ -42,6 +48,8 @@ private:
     for (;;) {
       while (TaskQueue_.try_pop(task)) {
         std::unique_ptr<Task<ObjectTy>> taskHolder(task);
+        if (QueueDepth_)
+          QueueDepth_->add(-1);
         if (!task) {
           shutdownRequested = true;
           continue;
@@ -59,6 +67,7 @@ private:
   ObjectTy *Object_;
   tbb::concurrent_queue<Task<ObjectTy>*> TaskQueue_;
   aioUserEvent *TaskQueueEvent_;
+  CMetricGauge *QueueDepth_ = nullptr;
 
 public:
   bool TaskHandlerFinished = false;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+// Runtime switchable sampled tracing
+// Disabled category costs one relaxed load and branch; enabled records pass user, connection and sampling filters,
+// then copied as fixed size binary record to lock-free ring buffer of current thread
+// Background thread drains buffers and formats records to trace file (or log if file not set)
+
+enum ETraceCategory : unsigned {
+  ETraceStratumMessages = 0,
+  ETraceStratumRejects,
+  ETraceStratumConnections,
+  ETraceBackend,
+  ETraceAccounting,
+  ETraceStatistic,
+  ETraceCategoriesNum
+};
+
+struct CTraceSettings {
+  // Names of enabled categories
+  std::vector<std::string> Categories;
+  // Trace only records of this user, empty means all users
+  std::string User;
+  // Trace only connections from "ip" or "ip:port", empty means all connections
+  std::string Connection;
+  // Trace one of SampleRate connections; records without connection sampled by counter
+  uint32_t SampleRate = 1;
+};
+
+struct CTraceStatus {
+  CTraceSettings Settings;
+  uint64_t Written = 0;
+  uint64_t Dropped = 0;
+  unsigned Buffers = 0;
+};
+
+extern std::atomic<uint32_t> gTraceCategories;
+
+static inline bool traceEnabled(ETraceCategory category)
+{
+  return gTraceCategories.load(std::memory_order_relaxed) & (1u << category);
+}
+
+const char *traceCategoryName(ETraceCategory category);
+
+// Opens trace output file, replaces previous one; records are written to log until called
+bool traceInitialize(const char *path);
+// Applies new settings, starts drain thread at first call
+bool traceConfigure(const CTraceSettings &settings, std::string &error);
+void traceGetStatus(CTraceStatus &status);
+
+// Record writers, call only after traceEnabled check
+// source and event must outlive tracing (string literals, instance names)
+// address and port in network byte order (as in HostAddress), zero for records without connection
+// user can be nullptr if unknown, record dropped when user filter is active
+// Fields joined by space and truncated to record payload size
+void trace(ETraceCategory category,
+           const char *source,
+           uint32_t address,
+           uint16_t port,
+           const std::string *user,
+           const char *event,
+           std::initializer_list<std::string_view> fields);
+
+void traceFormat(ETraceCategory category,
+                 const char *source,
+                 uint32_t address,
+                 uint16_t port,
+                 const std::string *user,
+                 const char *event,
+                 const char *format, ...);
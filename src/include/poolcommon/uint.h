@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <algorithm>
+#include "poolcommon/hex.h"
 
 #include <assert.h>
 
@@ -170,6 +171,18 @@ public:
     const char *p = hex;
     while (isHexDigit(*p))
       p++;
+
+    // Common case: whole bytes, decode as big endian and collect limbs from least significant byte
+    size_t digitsNum = p - hex;
+    if (digitsNum % 2 == 0 && digitsNum <= Bits/4) {
+      uint8_t bytes[Bits/8];
+      size_t bytesNum = digitsNum / 2;
+      hexDecode(hex, digitsNum, bytes);
+      for (size_t i = 0; i < bytesNum; i++)
+        result.Data_[i / sizeof(LimbTy)] |= static_cast<LimbTy>(bytes[bytesNum - 1 - i]) << (8 * (i % sizeof(LimbTy)));
+      return result;
+    }
+
     p--;
 
     LimbTy limb = 0;
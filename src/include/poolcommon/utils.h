@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <string>
+#include "poolcommon/hex.h"
 #include <p2putils/strExtras.h>
 
 std::string real_strprintf(const std::string &format, int dummy, ...);
@@ -29,50 +30,44 @@ static inline char bin2hexLowerCaseDigit(uint8_t b)
   return b < 10 ? '0'+b : 'a'+b-10;
 }
 
-static inline void hex2bin(const char *in, size_t inSize, void *out)
+// Returns false for odd length or non-hex characters
+static inline bool hex2bin(const char *in, size_t inSize, void *out)
 {
-  uint8_t *pOut = static_cast<uint8_t*>(out);
-  for (size_t i = 0; i < inSize/2; i++)
-    pOut[i] = (hexDigit2bin(in[i*2]) << 4) | hexDigit2bin(in[i*2+1]);
+  return hexDecode(in, inSize, out);
 }
 
 static inline void bin2hexLowerCase(const void *in, char *out, size_t size)
 {
-  const uint8_t *pIn = static_cast<const uint8_t*>(in);
-  for (size_t i = 0, ie = size; i != ie; ++i) {
-    out[i*2] = bin2hexLowerCaseDigit(pIn[i] >> 4);
-    out[i*2+1] = bin2hexLowerCaseDigit(pIn[i] & 0xF);
-  }
+  hexEncode(in, out, size);
 }
 
 template<typename T>
 std::string writeHexLE(T value, unsigned sizeInBytes)
 {
-  std::string result;
+  uint8_t data[sizeof(T)];
   for (unsigned i = 0; i < sizeInBytes; i++) {
-    uint8_t byte = value & 0xFF;
-    result.push_back(bin2hexLowerCaseDigit(byte >> 4));
-    result.push_back(bin2hexLowerCaseDigit(byte & 0xF));
+    data[i] = value & 0xFF;
     value >>= 8;
   }
 
+  std::string result(sizeInBytes*2, '\0');
+  hexEncode(data, result.data(), sizeInBytes);
   return result;
 }
 
 template<typename T>
 std::string writeHexBE(T value, unsigned sizeInBytes)
 {
-  std::string result;
+  uint8_t data[sizeof(T)];
   value = xswap(value);
   value >>= 8*(sizeof(T) - sizeInBytes);
-
   for (unsigned i = 0; i < sizeInBytes; i++) {
-    uint8_t byte = value & 0xFF;
-    result.push_back(bin2hexLowerCaseDigit(byte >> 4));
-    result.push_back(bin2hexLowerCaseDigit(byte & 0xF));
+    data[i] = value & 0xFF;
     value >>= 8;
   }
 
+  std::string result(sizeInBytes*2, '\0');
+  hexEncode(data, result.data(), sizeInBytes);
   return result;
 }
 
@@ -9,14 +9,20 @@
 #include "poolcommon/multiCall.h"
 #include "poolcommon/taskHandler.h"
 #include "poolcore/clientDispatcher.h"
+#include "poolcore/payoutQueue.h"
 #include "kvdb.h"
 #include "poolcore/rocksdbBase.h"
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 
+class CThreadPool;
 class p2pNode;
 class p2pPeer;
 class StatisticDb;
@@ -38,7 +44,83 @@ class AccountingDb {
 public:
   struct UserBalanceInfo {
     UserBalanceRecord Data;
-    int64_t Queued;
+    int64_t Queued = 0;
+  };
+
+  // Immutable copy of balances and current round work for query threads, rebuilt periodically in backend thread
+  // Aligned for reference counter cache of atomic_intrusive_ptr
+  struct alignas(512) CQuerySnapshot {
+    std::map<std::string, UserBalanceInfo> Balances;
+    // Work accepted in current round
+    double AcceptedWork = 0.0;
+
+    uintptr_t ref_fetch_add(uintptr_t count) const { return Refs_.fetch_add(count); }
+    uintptr_t ref_fetch_sub(uintptr_t count) const { return Refs_.fetch_sub(count); }
+  private:
+    mutable std::atomic<uintptr_t> Refs_ = 0;
+  };
+
+  struct CFoundBlock {
+    // FoundBy contains public name of user (login if name not set)
+    FoundBlockRecord Record;
+    // Last known confirmations number, -1 for orphan, -2 if not checked yet
+    int64_t Confirmations = -2;
+  };
+
+  // Fee splits of this coin resolved from UserManager, valid while its fee configuration version unchanged
+  // Split i is range [SplitOffsets[i], SplitOffsets[i+1]) of Recipients (indexes in RecipientNames) and Rates
+  struct CFeeResolutionCache {
+    uint64_t Version = std::numeric_limits<uint64_t>::max();
+    std::unordered_map<std::string, uint32_t> UserSplit;
+    std::unordered_map<std::string, uint32_t> PlanSplit;
+    std::vector<uint32_t> SplitOffsets = {0};
+    std::vector<uint32_t> Recipients;
+    // Fee percentage / 100
+    std::vector<double> Rates;
+    std::vector<std::string> RecipientNames;
+    std::unordered_map<std::string, uint32_t> RecipientIndex;
+
+    void reset(uint64_t version) {
+      Version = version;
+      UserSplit.clear();
+      PlanSplit.clear();
+      SplitOffsets.assign(1, 0);
+      Recipients.clear();
+      Rates.clear();
+      RecipientNames.clear();
+      RecipientIndex.clear();
+    }
+  };
+
+  // Found block work for luck calculation with prefix sums over all previous points
+  struct CLuckPoint {
+    int64_t Time;
+    double AccumulatedWork;
+    double ExpectedWork;
+    double AccumulatedWorkSum;
+    double ExpectedWorkSum;
+  };
+
+  // Luck points storage shared by published snapshots, each snapshot reads only its prefix
+  struct CLuckBuffer {
+    std::unique_ptr<CLuckPoint[]> Points;
+    size_t Capacity = 0;
+  };
+
+  // Immutable copy of found blocks index, republished by backend thread after each change
+  struct alignas(512) CFoundBlocksSnapshot {
+    // Recent blocks sorted by height and hash (database key order)
+    std::vector<CFoundBlock> Blocks;
+    // Older blocks exist only in database
+    bool Truncated = false;
+    // First LuckSize points sorted by time, only blocks with known expected work
+    std::shared_ptr<const CLuckBuffer> Luck;
+    size_t LuckSize = 0;
+
+    uintptr_t ref_fetch_add(uintptr_t count) const { return Refs_.fetch_add(count); }
+    uintptr_t ref_fetch_sub(uintptr_t count) const { return Refs_.fetch_sub(count); }
+  private:
+    mutable std::atomic<uintptr_t> Refs_ = 0;
   };
 
   // +file serialization
@@ -129,6 +211,16 @@ private:
     PoolLuckCallback Callback_;
   };
 
+  // Block confirmations tracking statistic, can be read from any thread
+  struct CConfirmationsStats {
+    std::atomic<uint64_t> Cycles = 0;
+    std::atomic<uint64_t> FailedCycles = 0;
+    // Microseconds
+    std::atomic<int64_t> LastLatency = 0;
+    std::atomic<int64_t> MaxLatency = 0;
+    std::atomic<unsigned> LastRespondedNodes = 0;
+  };
+
 private:
   asyncBase *Base_;
   const PoolBackendConfig &_cfg;
@@ -140,14 +232,32 @@ private:
   std::map<std::string, UserBalanceRecord> _balanceMap;
   std::deque<std::unique_ptr<MiningRound>> _allRounds;
   std::set<MiningRound*> UnpayedRounds_;
-  std::list<PayoutDbRecord> _payoutQueue;
+  // Sums of unpayed rounds payouts per user and total (multiplied by ExtraMultiplier)
+  std::unordered_map<std::string, int64_t> QueuedBalance_;
+  int64_t TotalQueued_ = 0;
+  // Sums over _balanceMap, balance multiplied by ExtraMultiplier
+  int64_t TotalBalance_ = 0;
+  int64_t TotalRequested_ = 0;
+  CPayoutQueue _payoutQueue;
   std::unordered_set<std::string> KnownTransactions_;
 
   int64_t LastBlockTime_ = 0;
   std::deque<CAccountingFile> AccountingDiskStorage_;
   std::map<std::string, double> CurrentScores_;
+  // Sum of CurrentScores_
+  double CurrentRoundWork_ = 0.0;
   std::vector<StatisticDb::CStatsExportData> RecentStats_;
   CFlushInfo FlushInfo_;
+  CFeeResolutionCache FeeResolution_;
+
+  // Last FoundBlocksIndexSize found blocks with cached confirmations, key is height and hash
+  std::map<std::pair<uint64_t, std::string>, CFoundBlock> FoundBlocks_;
+  bool FoundBlocksTruncated_ = false;
+  // Index or luck points changed since last publish
+  bool FoundBlocksChanged_ = true;
+  std::shared_ptr<CLuckBuffer> LuckBuffer_;
+  size_t LuckSize_ = 0;
+  atomic_intrusive_ptr<CFoundBlocksSnapshot> FoundBlocksSnapshot_;
 
   // Debugging only
   struct {
@@ -156,7 +266,6 @@ private:
     uint64_t Count = 0;
   } Dbg_;
 
-  FileDescriptor _payoutsFd;
   kvdb<rocksdbBase> _roundsDb;
   kvdb<rocksdbBase> _balanceDb;
   kvdb<rocksdbBase> _foundBlocksDb;
@@ -167,21 +276,51 @@ private:
   
   TaskHandlerCoroutine<AccountingDb> TaskHandler_;
   aioUserEvent *FlushTimerEvent_;
+  aioUserEvent *QuerySnapshotEvent_;
+  // Balance and luck queries served from snapshot in this pool if set, otherwise in backend thread
+  CThreadPool *QueryThreadPool_ = nullptr;
+  atomic_intrusive_ptr<CQuerySnapshot> QuerySnapshot_;
   bool ShutdownRequested_ = false;
   bool FlushFinished_ = false;
+  bool QuerySnapshotUpdaterFinished_ = false;
+  bool BatchPayoutsSupported_ = true;
+  CConfirmationsStats ConfirmationsStats_;
+  CMetricHistogram *ConfirmationsLatency_;
+  CMetricCounter *ConfirmationsFailures_;
+  CMetricHistogram *PayoutFlushTime_;
+  CMetricHistogram *SnapshotUpdateTime_;
+  uint64_t MetricsCollector_;
 
   void printRecentStatistic();
+  void updateConfirmationsStats(std::chrono::time_point<std::chrono::steady_clock> startTime, bool success, unsigned respondedNodes);
+  // Splits amount in proportion to payout values
+  static void splitByValue(const std::vector<PayoutDbRecord*> &records, int64_t amount, std::vector<int64_t> &shares);
+  void rejectTransaction(std::vector<PayoutDbRecord*> &records);
+  static std::string payoutRecipientsName(const std::vector<PayoutDbRecord*> &records);
   bool parseAccoutingStorageFile(CAccountingFile &file);
   void flushAccountingStorageFile(int64_t timeLabel);
+  void updateQuerySnapshot();
+  void addQueuedPayouts(const MiningRound *round);
+  void removeQueuedPayouts(const MiningRound *round);
+  void indexFoundBlock(const FoundBlockRecord &block);
+  void addLuckPoint(int64_t blockTime, double accumulatedWork, double expectedWork);
+  void updateFoundBlockConfirmations(const std::string &hash, uint64_t height, int64_t confirmations);
+  void publishFoundBlocks();
+  // Returns false if page continues beyond indexed blocks
+  static bool queryCachedFoundBlocks(const CFoundBlocksSnapshot *data, int64_t heightFrom, const std::string &hashFrom, uint32_t count, std::vector<FoundBlockRecord> &foundBlocks, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &confirmationsQuery);
+  uint32_t resolveFeeSplit(const std::string &userId);
 
 public:
   AccountingDb(asyncBase *base, const PoolBackendConfig &config, const CCoinInfo &coinInfo, UserManager &userMgr, CNetworkClientDispatcher &clientDispatcher, StatisticDb &statisticDb);
+  ~AccountingDb();
   void taskHandler();
 
   uint64_t lastAggregatedShareId() { return !AccountingDiskStorage_.empty() ? AccountingDiskStorage_.back().LastShareId : 0; }
   uint64_t lastKnownShareId() { return LastKnownShareId_; }
 
   void enumerateStatsFiles(std::deque<CAccountingFile> &cache, const std::filesystem::path &directory, bool isOldFormat);
+  // Must be called before start()
+  void setQueryThreadPool(CThreadPool *threadPool) { QueryThreadPool_ = threadPool; }
   void start();
   void stop();
   void updatePayoutFile();
@@ -197,13 +336,17 @@ public:
   void mergeRound(const Round *round);
   void checkBlockConfirmations();
   void checkBlockExtraInfo();
+  bool checkPayoutRecipient(const PayoutDbRecord &payout, unsigned index, std::string &recipient);
   void buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout);
-  bool sendTransaction(PayoutDbRecord &payout);
-  bool checkTxConfirmations(PayoutDbRecord &payout);
+  bool buildBatchTransaction(std::vector<PayoutDbRecord*> &batch, const std::vector<CNetworkClient::TransactionOutput> &outputs, CNetworkClient::EOperationStatus *status);
+  // All records must share one transaction: single payout or batch
+  bool sendTransaction(std::vector<PayoutDbRecord*> &records);
+  bool checkTxConfirmations(std::vector<PayoutDbRecord*> &records);
+  void makeBatchPayouts();
   void makePayout();
   void checkBalance();
   
-  std::list<PayoutDbRecord> &getPayoutsQueue() { return _payoutQueue; }
+  CPayoutQueue &getPayoutsQueue() { return _payoutQueue; }
   kvdb<rocksdbBase> &getFoundBlocksDb() { return _foundBlocksDb; }
   kvdb<rocksdbBase> &getPoolBalanceDb() { return _poolBalanceDb; }
   kvdb<rocksdbBase> &getPayoutDb() { return _payoutDb; }
@@ -213,9 +356,9 @@ public:
 
   // Asynchronous api
   void manualPayout(const std::string &user, DefaultCb callback) { TaskHandler_.push(new TaskManualPayout(user, callback)); }
-  void queryFoundBlocks(int64_t heightFrom, const std::string &hashFrom, uint32_t count, QueryFoundBlocksCallback callback) { TaskHandler_.push(new TaskQueryFoundBlocks(heightFrom, hashFrom, count, callback)); }
-  void queryUserBalance(const std::string &user, QueryBalanceCallback callback) { TaskHandler_.push(new TaskQueryBalance(user, callback)); }
-  void poolLuck(std::vector<int64_t> &&intervals, PoolLuckCallback callback) { TaskHandler_.push(new TaskPoolLuck(std::move(intervals), callback)); }
+  void queryFoundBlocks(int64_t heightFrom, const std::string &hashFrom, uint32_t count, QueryFoundBlocksCallback callback);
+  void queryUserBalance(const std::string &user, QueryBalanceCallback callback);
+  void poolLuck(std::vector<int64_t> &&intervals, PoolLuckCallback callback);
 
   // Asynchronous multi calls
   static void queryUserBalanceMulti(AccountingDb **backends, size_t backendsNum, const std::string &user, std::function<void(const UserBalanceInfo*, size_t)> callback) {
@@ -229,6 +372,7 @@ private:
   void queryBalanceImpl(const std::string &user, QueryBalanceCallback callback);
   void queryFoundBlocksImpl(int64_t heightFrom, const std::string &hashFrom, uint32_t count, QueryFoundBlocksCallback callback);
   void poolLuckImpl(const std::vector<int64_t> &intervals, PoolLuckCallback callback);
+  void poolLuckImpl(const std::vector<int64_t> &intervals, double acceptedWork, PoolLuckCallback callback);
 };
 
 template<>
@@ -3,6 +3,7 @@
 
 #include "accounting.h"
 #include "blockTemplate.h"
+#include "poolInstance.h"
 #include "priceFetcher.h"
 #include "shareLog.h"
 #include "statistics.h"
@@ -84,10 +85,12 @@ private:
   CPriceFetcher &PriceFetcher_;
   std::unique_ptr<AccountingDb> _accounting;
   std::unique_ptr<StatisticDb> _statistics;
+  std::unique_ptr<CThreadPool> QueryThreadPool_;
   StatisticServer *AlgoMetaStatistic_ = nullptr;
   ShareLog<ShareLogConfig> ShareLog_;
 
   TaskHandlerCoroutine<PoolBackend> TaskHandler_;
+  CMetricCounter *SharesMetric_;
   bool ShutdownRequested_ = false;
   bool CheckConfirmationsHandlerFinished_ = false;
   bool PayoutHandlerFinished_ = false;
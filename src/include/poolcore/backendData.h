@@ -75,14 +75,40 @@ struct PoolBackendConfig {
   unsigned KeepRoundTime;
   unsigned KeepStatsTime;
   unsigned ConfirmationsCheckInterval;
+  // Number of nodes which must answer block confirmations query
+  unsigned ConfirmationsQuorum = 1;
+  // Found blocks outside of unpayed rounds with not settled confirmations (not checked yet or reorganized),
+  // checked per confirmations cycle for found blocks query cache, newest first
+  unsigned ConfirmationsCacheBatch = 100;
+  // Found blocks kept in memory for found blocks query, older pages read from database
+  unsigned FoundBlocksIndexSize = 1000;
   unsigned PayoutInterval;
   unsigned BalanceCheckInterval;
+  // Group queued payouts into multi-output transactions (if node supports it)
+  bool PayoutBatchEnabled = false;
+  unsigned PayoutBatchMaxOutputs = 100;
+  // Batch value limit, 0 means no limit
+  int64_t PayoutBatchMaxValue = 0;
   std::chrono::minutes StatisticKeepTime = std::chrono::minutes(30);
   std::chrono::minutes StatisticWorkersPowerCalculateInterval = std::chrono::minutes(11);
   std::chrono::minutes StatisticPoolPowerCalculateInterval = std::chrono::minutes(5);
   std::chrono::minutes StatisticWorkersAggregateTime = std::chrono::minutes(5);
   std::chrono::minutes StatisticPoolAggregateTime = std::chrono::minutes(1);
   std::chrono::hours StatisticKeepWorkerNamesTime = std::chrono::hours(24);
+  // Rebuild interval of read-only snapshots used by stats and balance queries (if query thread pool set)
+  std::chrono::milliseconds QuerySnapshotInterval = std::chrono::milliseconds(5000);
+  // Query thread pool size of backend and statistic server, 0 means queries served by their own threads
+  unsigned QueryThreadsNum = 2;
+
+  // Work fetch scheduler: templates of new block pushed to miners immediately, other updates (mempool refresh)
+  // coalesced and pushed not more than once per interval
+  std::chrono::milliseconds WorkRefreshInterval = std::chrono::milliseconds(30000);
+  // Retry delay after node error doubled for each sequential error of node, up to limit
+  std::chrono::milliseconds WorkFetchBackoffLimit = std::chrono::milliseconds(5000);
+
+  // CPU affinity for backend and statistic server threads, empty means no pinning
+  std::vector<unsigned> BackendCpus;
+  std::vector<unsigned> StatisticCpus;
 
   SelectorByWeight<CMiningAddress> MiningAddresses;
   std::string CoinBaseMsg;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "poolcore/poolCore.h"
+#include "poolcommon/metrics.h"
 #include "poolcore/thread.h"
 #include "asyncio/asyncio.h"
 #include "asyncio/http.h"
@@ -18,6 +19,7 @@ public:
   virtual bool ioGetBalance(asyncBase *base, GetBalanceResult &result) override;
   virtual bool ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<GetBlockConfirmationsQuery> &query) override;
   virtual EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, BuildTransactionResult &result) override;
+  virtual EOperationStatus ioBuildBatchTransaction(asyncBase *base, const std::vector<TransactionOutput> &outputs, const std::string &changeAddress, BuildTransactionResult &result) override;
   virtual EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string&, std::string &error) override;
   virtual EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error) override;
   virtual void aioSubmitBlock(asyncBase *base, CPreparedQuery *queryPtr, CSubmitBlockOperation *operation) override;
@@ -37,7 +39,6 @@ private:
     HTTPParseDefaultContext ParseCtx;
     std::string LongPollId;
     uint64_t WorkId;
-    std::chrono::time_point<std::chrono::steady_clock> LastTemplateTime;
     aioUserEvent *TimerEvent;
   };
 
@@ -74,6 +75,7 @@ private:
   std::string buildSendToAddress(const std::string &destination, int64_t amount);
   std::string buildGetTransaction(const std::string &txId);
   EOperationStatus signRawTransaction(CConnection *connection, const std::string &fundedTransaction, std::string &signedTransaction, std::string &error);
+  EOperationStatus decodeRawTransaction(CConnection *connection, const std::string &transaction, std::string &txId, std::string &error);
 
   void submitBlockRequestCb(CPreparedSubmitBlock *query) {
     std::unique_ptr<CPreparedSubmitBlock> queryHolder(query);
@@ -126,8 +128,11 @@ private:
 
   template<rapidjson::ParseFlag flag = rapidjson::kParseDefaultFlags>
   EOperationStatus ioQueryJson(CConnection &connection, const std::string &query, rapidjson::Document &document, uint64_t timeout) {
+    auto beginPt = std::chrono::steady_clock::now();
     AsyncOpStatus status = ioHttpRequest(connection.Client, query.data(), query.size(), timeout, httpParseDefault, &connection.ParseCtx);
+    RequestTime_->recordSince(beginPt);
     if (status != aosSuccess) {
+      RequestErrors_->add();
       LOG_F(WARNING, "%s %s: error code: %u", CoinInfo_.Name.c_str(), FullHostName_.c_str(), status);
       return status == aosTimeout ? EStatusTimeout : EStatusNetworkError;
     }
@@ -176,6 +181,8 @@ private:
   HostAddress Address_;
   std::string HostName_;
   std::string FullHostName_;
+  CMetricHistogram *RequestTime_ = nullptr;
+  CMetricCounter *RequestErrors_ = nullptr;
   std::string BasicAuth_;
 
   GBTInstance WorkFetcher_;
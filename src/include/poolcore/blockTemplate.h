@@ -6,6 +6,7 @@ extern "C" {
 #include "poolcommon/intrusive_ptr.h"
 #include "rapidjson/document.h"
 #include <atomic>
+#include <chrono>
 
 struct alignas(512) EthashDagWrapper {
 public:
@@ -32,7 +33,11 @@ public:
   rapidjson::Document Document;
   uint64_t UniqueWorkId;
   double Difficulty;
+  // Checksum of template content without time fields for duplicates detection, 0 if not calculated
+  uint32_t ContentHash = 0;
   intrusive_ptr<EthashDagWrapper> DagFile;
+  // Template receive time, for work distribution latency metric
+  std::chrono::steady_clock::time_point ReceiveTime = std::chrono::steady_clock::now();
   uintptr_t ref_fetch_add(uintptr_t count) const { return Refs_.fetch_add(count); }
   uintptr_t ref_fetch_sub(uintptr_t count) const { return Refs_.fetch_sub(count); }
 };
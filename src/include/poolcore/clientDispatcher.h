@@ -2,6 +2,8 @@
 
 #include "poolCore.h"
 #include "poolInstance.h"
+#include "poolcommon/intrusive_ptr.h"
+#include "poolcommon/metrics.h"
 #include "loguru.hpp"
 #include <memory>
 
@@ -12,9 +14,16 @@ public:
     WorkFetcherReconnectTimer_ = newUserEvent(base, 0, [](aioUserEvent*, void *arg) {
       static_cast<CNetworkClientDispatcher*>(arg)->onWorkFetchReconnectTimer();
     }, this);
+    WorkPushTimer_ = newUserEvent(base, 0, [](aioUserEvent*, void *arg) {
+      static_cast<CNetworkClientDispatcher*>(arg)->onWorkPushTimer();
+    }, this);
+    TemplatesPushed_ = &metricCounter("pool_work_templates_total", "Block templates received from nodes", metricLabels("coin", CoinInfo_.Name, "result", "pushed"));
+    TemplatesCoalesced_ = &metricCounter("pool_work_templates_total", "Block templates received from nodes", metricLabels("coin", CoinInfo_.Name, "result", "coalesced"));
+    TemplatesDuplicate_ = &metricCounter("pool_work_templates_total", "Block templates received from nodes", metricLabels("coin", CoinInfo_.Name, "result", "duplicate"));
   }
   void addGetWorkClient(CNetworkClient *client) {
     GetWorkClients_.emplace_back(client);
+    WorkFetcherErrors_.push_back(0);
     client->setDispatcher(this);
   }
 
@@ -28,9 +37,12 @@ public:
 
   // Common API
   bool ioGetBalance(asyncBase *base, CNetworkClient::GetBalanceResult &result);
-  bool ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query);
-  bool ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query);
+  // Block status queries sent to all RPC clients in parallel; returns after 'quorum' nodes answered
+  // (or all nodes finished), answers merged conservatively
+  bool ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query, unsigned quorum = 1, unsigned *respondedNodes = nullptr);
+  bool ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query, unsigned quorum = 1, unsigned *respondedNodes = nullptr);
   CNetworkClient::EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, CNetworkClient::BuildTransactionResult &result);
+  CNetworkClient::EOperationStatus ioBuildBatchTransaction(asyncBase *base, const std::vector<CNetworkClient::TransactionOutput> &outputs, const std::string &changeAddress, CNetworkClient::BuildTransactionResult &result);
   CNetworkClient::EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error);
   CNetworkClient::EOperationStatus ioWalletService(asyncBase *base, std::string &error);
   CNetworkClient::EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error);
@@ -53,6 +65,7 @@ public:
   void onWorkFetcherConnectionError();
   void onWorkFetcherConnectionLost();
   void onWorkFetcherNewWork(CBlockTemplate *blockTemplate);
+  void onWorkPushTimer();
 
 private:
   enum EWorkState {
@@ -61,6 +74,12 @@ private:
     EWorkMinersStopped
   };
 
+private:
+  void retryWorkFetch(uint64_t baseDelay);
+  // Arms push timer if refresh interval since last push not elapsed yet, returns false otherwise
+  bool startWorkPushTimer();
+  void pushWork(CBlockTemplate *blockTemplate);
+
 private:
   asyncBase *Base_;
   CCoinInfo CoinInfo_;
@@ -75,4 +94,19 @@ private:
   aioUserEvent *WorkFetcherReconnectTimer_ = nullptr;
   EWorkState WorkState_ = EWorkOk;
   std::chrono::time_point<std::chrono::steady_clock> ConnectionLostTime_;
+
+  // Work fetch scheduler
+  // Sequential errors of each work fetcher, for retry backoff
+  std::vector<unsigned> WorkFetcherErrors_;
+  aioUserEvent *WorkPushTimer_ = nullptr;
+  bool WorkPushTimerActive_ = false;
+  // Latest coalesced template, pushed by timer
+  intrusive_ptr<CBlockTemplate> PendingWork_;
+  bool HasWork_ = false;
+  uint64_t LastWorkId_ = 0;
+  uint32_t LastContentHash_ = 0;
+  std::chrono::time_point<std::chrono::steady_clock> LastPushTime_;
+  CMetricCounter *TemplatesPushed_ = nullptr;
+  CMetricCounter *TemplatesCoalesced_ = nullptr;
+  CMetricCounter *TemplatesDuplicate_ = nullptr;
 };
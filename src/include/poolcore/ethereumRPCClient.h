@@ -1,6 +1,7 @@
 #pragma once
 
 #include "poolcore/poolCore.h"
+#include "poolcommon/metrics.h"
 #include "poolcommon/uint.h"
 #include "asyncio/http.h"
 #include "asyncio/socket.h"
@@ -111,8 +112,11 @@ private:
 
   template<rapidjson::ParseFlag flag = rapidjson::kParseDefaultFlags>
   EOperationStatus ioQueryJson(CConnection &connection, const std::string &query, rapidjson::Document &document, uint64_t timeout) {
+    auto beginPt = std::chrono::steady_clock::now();
     AsyncOpStatus status = ioHttpRequest(connection.Client, query.data(), query.size(), timeout, httpParseDefault, &connection.ParseCtx);
+    RequestTime_->recordSince(beginPt);
     if (status != aosSuccess) {
+      RequestErrors_->add();
       LOG_F(WARNING, "%s %s: error code: %u", CoinInfo_.Name.c_str(), FullHostName_.c_str(), status);
       return status == aosTimeout ? EStatusTimeout : EStatusNetworkError;
     }
@@ -241,6 +245,8 @@ private:
   CCoinInfo CoinInfo_;
   std::string HostName_;
   std::string FullHostName_;
+  CMetricHistogram *RequestTime_ = nullptr;
+  CMetricCounter *RequestErrors_ = nullptr;
   HostAddress Address_;
 
   WorkFetcherContext WorkFetcher_;
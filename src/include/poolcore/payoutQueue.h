@@ -0,0 +1,113 @@
+#pragma once
+
+#include "backendData.h"
+#include "poolcommon/file.h"
+#include "p2putils/xmstream.h"
+#include <filesystem>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Payout queue with append-only on-disk journal
+// Journal is a sequence of checksummed frames:
+//   uint32 payload size, uint32 crc32c(payload), payload
+// Payload is operation type, record id and (for put operation) payout record
+// Journal compacted (rewritten as snapshot) when it becomes much bigger than live data
+class CPayoutQueue {
+public:
+  using Container = std::list<PayoutDbRecord>;
+  using iterator = Container::iterator;
+  using const_iterator = Container::const_iterator;
+
+  struct CUserQueued {
+    int64_t Value = 0;
+    unsigned Count = 0;
+  };
+
+public:
+  // Loads queue from journal; if journal not exists, imports old style payouts.raw file
+  bool open(const std::filesystem::path &journalPath, const std::filesystem::path &legacyPath);
+
+  iterator begin() { return Records_.begin(); }
+  iterator end() { return Records_.end(); }
+  const_iterator begin() const { return Records_.begin(); }
+  const_iterator end() const { return Records_.end(); }
+  size_t size() const { return Records_.size(); }
+  bool empty() const { return Records_.empty(); }
+
+  PayoutDbRecord &push(const PayoutDbRecord &record);
+  void erase(PayoutDbRecord &record);
+  // Must be called after any change of record (status, value, transaction data)
+  void update(PayoutDbRecord &record);
+
+  // Records with given status in queue order
+  const std::map<uint64_t, PayoutDbRecord*> &byStatus(uint32_t status) const { return StatusIndex_[status < EStatusNum ? status : EStatusNum]; }
+  // Snapshot of status index, safe for modifying queue during iteration
+  std::vector<PayoutDbRecord*> collect(uint32_t status) const {
+    std::vector<PayoutDbRecord*> result;
+    for (const auto &It: byStatus(status))
+      result.push_back(It.second);
+    return result;
+  }
+  // Aggregated queued value (with fee share of batched payouts) for user, equals requested balance
+  CUserQueued userQueued(const std::string &userId) const {
+    auto It = UserIndex_.find(userId);
+    return It != UserIndex_.end() ? It->second : CUserQueued();
+  }
+  const std::unordered_map<std::string, CUserQueued> &users() const { return UserIndex_; }
+  int64_t totalValue() const { return TotalValue_; }
+  // Sum of value and fee for records with given status
+  int64_t statusAmount(uint32_t status) const { return StatusAmount_[status < EStatusNum ? status : EStatusNum]; }
+
+  // Writes changes since last flush to journal
+  void flush();
+
+private:
+  enum { EStatusNum = PayoutDbRecord::ETxRejected + 1 };
+
+  enum EJournalOp : uint8_t {
+    EOpPut = 0,
+    EOpRemove
+  };
+
+  struct CEntry {
+    uint64_t Id;
+    iterator It;
+    // Indexed values
+    uint32_t Status;
+    int64_t Value;
+    int64_t TxFee;
+  };
+
+private:
+  void indexAdd(CEntry &entry, PayoutDbRecord &record);
+  void indexRemove(CEntry &entry, PayoutDbRecord &record);
+  void writeFrame(xmstream &stream, EJournalOp op, uint64_t id, const PayoutDbRecord *record);
+  // Appends frames to journal; on failure cuts journal back to JournalSize_
+  bool append(const void *data, size_t size);
+  bool replay(xmstream &stream, std::map<uint64_t, PayoutDbRecord> &records, size_t *validSize);
+  bool compact();
+
+private:
+  std::filesystem::path Path_;
+  FileDescriptor Fd_;
+  size_t JournalSize_ = 0;
+  size_t LiveSize_ = 0;
+  // Journal tail can't be trusted (truncate after failed write failed)
+  bool CompactRequired_ = false;
+
+  Container Records_;
+  std::unordered_map<const PayoutDbRecord*, CEntry> Entries_;
+  uint64_t LastId_ = 0;
+
+  std::unordered_set<const PayoutDbRecord*> Dirty_;
+  std::vector<uint64_t> Removed_;
+
+  std::map<uint64_t, PayoutDbRecord*> StatusIndex_[EStatusNum+1];
+  int64_t StatusAmount_[EStatusNum+1] = {};
+  std::unordered_map<std::string, CUserQueued> UserIndex_;
+  int64_t TotalValue_ = 0;
+};
@@ -122,6 +122,13 @@ public:
     int64_t Fee;
   };
 
+  struct TransactionOutput {
+    std::string Address;
+    int64_t Value;
+    TransactionOutput() {}
+    TransactionOutput(const std::string &address, int64_t value) : Address(address), Value(value) {}
+  };
+
   struct ListUnspentElement {
     std::string Address;
     int64_t Amount;
@@ -160,6 +167,8 @@ public:
   virtual bool ioGetBalance(asyncBase *base, GetBalanceResult &result) = 0;
   virtual EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, BuildTransactionResult &result) = 0;
   virtual EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error) = 0;
+  // Multi-output transaction, network fee subtracted from outputs; not all coins support it
+  virtual EOperationStatus ioBuildBatchTransaction(asyncBase*, const std::vector<TransactionOutput>&, const std::string&, BuildTransactionResult&) { return EStatusMethodNotFound; }
   virtual EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error) = 0;
   virtual EOperationStatus ioListUnspent(asyncBase *base, ListUnspentResult &result) = 0;
   virtual EOperationStatus ioZSendMany(asyncBase *base, const std::string &source, const std::string &destination, int64_t amount, const std::string &memo, uint64_t minConf, int64_t fee, CNetworkClient::ZSendMoneyResult &result) = 0;
@@ -15,9 +15,12 @@ class UserManager;
 
 class CThreadPool {
 public:
-  CThreadPool(unsigned threadsNum);
+  // Worker i pinned to cpus[i % cpus.size()], empty list means no pinning
+  CThreadPool(unsigned threadsNum, const std::vector<unsigned> &cpus = std::vector<unsigned>());
   unsigned threadsNum() { return ThreadsNum_; }
   asyncBase *getBase(unsigned workerId) { return Threads_[workerId].Base; }
+  // Cpu of pinned worker or -1
+  int getCpu(unsigned workerId) { return Threads_[workerId].Cpu; }
   void start();
   void stop();
 
@@ -29,20 +32,36 @@ public:
     virtual void run(unsigned workerId) = 0;
   };
 
+  template<typename F> class FunctionTask : public Task {
+  public:
+    FunctionTask(F function) : Function_(std::move(function)) {}
+    void run(unsigned) final { Function_(); }
+  private:
+    F Function_;
+  };
+
 public:
   void startAsyncTask(unsigned workerId, Task *task) {
     Threads_[workerId].TaskQueue.push(task);
     userEventActivate(Threads_[workerId].NewTaskEvent);
   }
 
+  // Runs function on next worker (round-robin), for tasks without thread affinity
+  template<typename F> void startAsyncCall(F &&function) {
+    unsigned workerId = NextWorkerId_.fetch_add(1, std::memory_order_relaxed) % ThreadsNum_;
+    startAsyncTask(workerId, new FunctionTask<std::decay_t<F>>(std::forward<F>(function)));
+  }
+
 private:
-  struct ThreadData {
+  // Cache line aligned to avoid false sharing between workers
+  struct alignas(64) ThreadData {
     ThreadData() {}
     ThreadData(const ThreadData&) = delete;
     ThreadData& operator=(const ThreadData&) = delete;
 
     asyncBase *Base;
     unsigned Id;
+    int Cpu = -1;
     std::thread Thread;
     tbb::concurrent_queue<Task*> TaskQueue;
     aioUserEvent *NewTaskEvent;
@@ -54,9 +73,20 @@ private:
 private:
   unsigned ThreadsNum_;
   std::unique_ptr<ThreadData[]> Threads_;
+  std::atomic<unsigned> NextWorkerId_ = 0;
 };
 
 class CPoolInstance {
+public:
+  struct CConnectionStats {
+    // Monotonic counter of accepted connections, accept rate is its derivative
+    uint64_t Accepted = 0;
+    // Current connections number on each worker thread
+    std::vector<unsigned> ThreadConnections;
+    // Memory used by connection objects and receive buffers (bytes)
+    uint64_t ConnectionMemory = 0;
+  };
+
 public:
   CPoolInstance(asyncBase *base, UserManager &userMgr, CThreadPool &threadPool) : MonitorBase_(base), UserMgr_(userMgr), ThreadPool_(threadPool) {}
   virtual ~CPoolInstance() {}
@@ -67,6 +97,8 @@ public:
   /// Function for interact with bitcoin RPC clients
   /// @arg blockTemplate: deserialized 'getblocktemplate' response
   virtual void checkNewBlockTemplate(CBlockTemplate *blockTemplate, PoolBackend *backend) = 0;
+  /// Can be called from any thread
+  virtual void connectionStats(CConnectionStats&) {}
 
   void setAlgoMetaStatistic(StatisticServer *server) { AlgoMetaStatistic_ = server; }
   void setComplexMiningStats(ComplexMiningStats *miningStats) { MiningStats_ = miningStats; }
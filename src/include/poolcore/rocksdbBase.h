@@ -16,6 +16,8 @@ namespace leveldb {
 }
 
 
+class CMetricHistogram;
+
 class rocksdbBase {
 public:
   struct PartitionBatchType {
@@ -199,6 +201,8 @@ private:
   std::vector<partition> _partitions;
   std::shared_mutex PartitionsMutex_;
   std::mutex DbMutex_;
+  // Synchronous write latency (put, delete and batch)
+  CMetricHistogram *WriteTime_;
   
   partition getFirstPartition();
   partition getLastPartition();
@@ -5,6 +5,7 @@
 #include "backendData.h"
 #include "poolcommon/debug.h"
 #include "poolcommon/file.h"
+#include "poolcommon/metrics.h"
 #include "loguru.hpp"
 #include "asyncio/asyncio.h"
 #include "p2putils/xmstream.h"
@@ -51,6 +52,7 @@ public:
     ShareLogFlushInterval_ = shareLogFlushInterval;
     ShareLogFileSizeLimit_ = shareLogFileSizeLimit;
     Config_ = config;
+    FlushTime_ = &metricHistogram("pool_share_log_flush_seconds", "Share log write time", metricLabel("coin", backendName));
 
     {
       // TEMPORARY: load shares in old format
@@ -138,8 +140,10 @@ public:
     }
 
     // Flush memory buffer to disk
+    auto beginPt = std::chrono::steady_clock::now();
     ShareLog_.back().Fd.write(ShareLogInMemory_.data(), ShareLogInMemory_.sizeOf());
     ShareLogInMemory_.reset();
+    FlushTime_->recordSince(beginPt);
 
     // Check share log file size limit
     if (ShareLog_.back().Fd.size() >= ShareLogFileSizeLimit_) {
@@ -256,4 +260,5 @@ private:
   std::deque<CShareLogFile> ShareLog_;
   uint64_t CurrentShareId_ = 0;
   bool ShareLoggingEnabled_ = true;
+  CMetricHistogram *FlushTime_ = nullptr;
 };
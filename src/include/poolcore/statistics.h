@@ -4,15 +4,20 @@
 #include "kvdb.h"
 #include "backendData.h"
 #include "poolcore/poolCore.h"
+#include "poolcore/poolInstance.h"
 #include "poolcore/rocksdbBase.h"
 #include "poolcore/shareLog.h"
+#include "poolcore/statsCache.h"
 #include "poolcore/usermgr.h"
+#include "poolcommon/intrusive_ptr.h"
 #include "poolcommon/multiCall.h"
 #include "poolcommon/serialize.h"
 #include "poolcommon/taskHandler.h"
 #include "asyncio/asyncio.h"
 #include <tbb/concurrent_queue.h>
 #include <chrono>
+#include <memory>
+#include <mutex>
 
 struct CShare;
 
@@ -72,8 +77,121 @@ public:
     }
   };
 
+  // Aggregated rounds of accumulator: fixed capacity ring (allocated at first push), struct of arrays layout
+  // Shares number and work stored as prefix sums, sum over any suffix is O(1); dropping oldest round only moves base
+  // (prefix sum before first round), sums rebased to zero once per capacity drops to keep work precision
+  // Prime POW targets stored in side array, allocated only for coins with prime POW (XPM)
+  class CStatsRing {
+  public:
+    bool empty() const { return Size_ == 0; }
+    size_t size() const { return Size_; }
+
+    // Rounds indexed from oldest (0) to newest (size() - 1)
+    int64_t timeLabel(size_t index) const { return TimeLabel_[physical(index)]; }
+    double sharesWork(size_t index) const { return SharesWorkSum_[physical(index)] - (index ? SharesWorkSum_[physical(index - 1)] : SharesWorkBase_); }
+    uint64_t sharesNumSum(size_t from) const { return Size_ ? SharesNumSum_[physical(Size_ - 1)] - (from ? SharesNumSum_[physical(from - 1)] : SharesNumBase_) : 0; }
+    double sharesWorkSum(size_t from) const { return Size_ ? SharesWorkSum_[physical(Size_ - 1)] - (from ? SharesWorkSum_[physical(from - 1)] : SharesWorkBase_) : 0.0; }
+
+    // Minimal prime POW target of rounds [from, size())
+    uint32_t primePOWTarget(size_t from) const {
+      uint32_t result = -1U;
+      if (PrimePOWTarget_) {
+        for (size_t i = from; i < Size_; i++)
+          result = std::min(result, PrimePOWTarget_[physical(i)]);
+      }
+      return result;
+    }
+
+    // Index of first round with time label not less than timeLabel (time labels are increasing)
+    size_t lowerBound(int64_t timeLabel) const {
+      size_t first = 0;
+      size_t count = Size_;
+      while (count) {
+        size_t step = count / 2;
+        if (TimeLabel_[physical(first + step)] < timeLabel) {
+          first += step + 1;
+          count -= step + 1;
+        } else {
+          count = step;
+        }
+      }
+      return first;
+    }
+
+    // Drops oldest round when ring is full
+    void push(int64_t timeLabel, uint32_t sharesNum, double sharesWork, uint32_t primePOWTarget, size_t capacity) {
+      if (!Capacity_) {
+        Capacity_ = std::max<size_t>(capacity, 1);
+        TimeLabel_.reset(new int64_t[Capacity_]);
+        SharesNumSum_.reset(new uint64_t[Capacity_]);
+        SharesWorkSum_.reset(new double[Capacity_]);
+      }
+      if (primePOWTarget != -1U && !PrimePOWTarget_) {
+        PrimePOWTarget_.reset(new uint32_t[Capacity_]);
+        std::fill(PrimePOWTarget_.get(), PrimePOWTarget_.get() + Capacity_, -1U);
+      }
+
+      if (Size_ == Capacity_)
+        popFront();
+
+      size_t last = Size_ ? physical(Size_ - 1) : 0;
+      uint64_t sharesNumBase = Size_ ? SharesNumSum_[last] : SharesNumBase_;
+      double sharesWorkBase = Size_ ? SharesWorkSum_[last] : SharesWorkBase_;
+      size_t index = physical(Size_++);
+      TimeLabel_[index] = timeLabel;
+      SharesNumSum_[index] = sharesNumBase + sharesNum;
+      SharesWorkSum_[index] = sharesWorkBase + sharesWork;
+      if (PrimePOWTarget_)
+        PrimePOWTarget_[index] = primePOWTarget;
+    }
+
+    // Removes rounds older than timeLabel
+    void removeOlder(int64_t timeLabel) {
+      while (Size_ && TimeLabel_[Begin_] < timeLabel)
+        popFront();
+    }
+
+  private:
+    size_t physical(size_t index) const {
+      index += Begin_;
+      return index < Capacity_ ? index : index - Capacity_;
+    }
+
+    void popFront() {
+      SharesNumBase_ = SharesNumSum_[Begin_];
+      SharesWorkBase_ = SharesWorkSum_[Begin_];
+      Begin_ = physical(1);
+      Size_--;
+      if (Begin_ == 0 || Size_ == 0)
+        rebase();
+    }
+
+    // O(size), called at most once per capacity drops
+    void rebase() {
+      for (size_t i = 0; i < Size_; i++) {
+        size_t index = physical(i);
+        SharesNumSum_[index] -= SharesNumBase_;
+        SharesWorkSum_[index] -= SharesWorkBase_;
+      }
+      SharesNumBase_ = 0;
+      SharesWorkBase_ = 0.0;
+    }
+
+  private:
+    std::unique_ptr<int64_t[]> TimeLabel_;
+    std::unique_ptr<uint64_t[]> SharesNumSum_;
+    std::unique_ptr<double[]> SharesWorkSum_;
+    std::unique_ptr<uint32_t[]> PrimePOWTarget_;
+    size_t Capacity_ = 0;
+    size_t Begin_ = 0;
+    size_t Size_ = 0;
+    // Prefix sums before oldest round
+    uint64_t SharesNumBase_ = 0;
+    double SharesWorkBase_ = 0.0;
+  };
+
   struct CStatsAccumulator {
-    std::deque<CStatsElement> Recent;
+    CStatsRing Recent;
     CStatsElement Current;
     int64_t LastShareTime = 0;
 
@@ -137,17 +255,52 @@ public:
     std::vector<CStatsFileRecord> Records;
   };
 
+  // Immutable copy of current statistic for query threads, rebuilt periodically in statistic thread
+  // Aligned for reference counter cache of atomic_intrusive_ptr
+  struct alignas(512) CQuerySnapshot {
+    struct CUserStats {
+      static constexpr unsigned OrdersNum = EStatsColumnLastShareTime + 1;
+
+      CStats Aggregate;
+      // Unsorted
+      std::vector<CStats> Workers;
+
+      // Worker indexes in ascending order of column, built by first query sorted by this column
+      // Returns nullptr for unknown column
+      const std::vector<uint32_t> *order(EStatsColumn column) const;
+
+    private:
+      mutable std::once_flag OrderFlags_[OrdersNum];
+      mutable std::vector<uint32_t> Orders_[OrdersNum];
+    };
+
+    CStats Pool;
+    std::unordered_map<std::string, CUserStats> Workers;
+    std::unordered_map<std::string, CStats> Users;
+
+    uintptr_t ref_fetch_add(uintptr_t count) const { return Refs_.fetch_add(count); }
+    uintptr_t ref_fetch_sub(uintptr_t count) const { return Refs_.fetch_sub(count); }
+  private:
+    mutable std::atomic<uintptr_t> Refs_ = 0;
+  };
+
 private:
   using QueryPoolStatsCallback = std::function<void(const StatisticDb::CStats&)>;
   using QueryUserStatsCallback = std::function<void(const StatisticDb::CStats&, const std::vector<StatisticDb::CStats>&)>;
   using QueryStatsHistoryCallback = std::function<void(const std::vector<StatisticDb::CStats>&)>;
   using QueryAllUsersStatisticCallback = std::function<void(const std::vector<CredentialsWithStatistic>&)>;
 
+  enum EStatsFileFormat {
+    // TEMPORARY: stats.*.cache and stats.*.cache.2 files are read for migration only
+    EStatsFileV1 = 0,
+    EStatsFileV2,
+    EStatsFileColumnar
+  };
+
   struct CStatsFile {
     int64_t TimeLabel;
     uint64_t LastShareId;
-    // TEMPORARY
-    bool IsOldFormat = false;
+    EStatsFileFormat Format = EStatsFileColumnar;
     std::filesystem::path Path;
   };
 
@@ -205,6 +358,9 @@ private:
   std::unordered_map<std::string, std::unordered_map<std::string, CStatsAccumulator>> LastWorkerStats_;
   std::unordered_map<std::string, CStatsAccumulator> LastUserStats_;
   CFlushInfo WorkersFlushInfo_;
+  // Ring capacities of accumulators: rounds in StatisticKeepTime
+  size_t WorkersRecentCapacity_ = 0;
+  size_t PoolRecentCapacity_ = 0;
 
   kvdb<rocksdbBase> WorkerStatsDb_;
   kvdb<rocksdbBase> PoolStatsDb_;
@@ -214,10 +370,24 @@ private:
   TaskHandlerCoroutine<StatisticDb> TaskHandler_;
   aioUserEvent *WorkerStatsUpdaterEvent_;
   aioUserEvent *PoolStatsUpdaterEvent_;
+  aioUserEvent *QuerySnapshotEvent_;
+
+  // Queries served from snapshot in this pool if set, otherwise in statistic thread
+  CThreadPool *QueryThreadPool_ = nullptr;
+  atomic_intrusive_ptr<CQuerySnapshot> QuerySnapshot_;
 
   bool ShutdownRequested_ = false;
   bool WorkerStatsUpdaterFinished_ = false;
   bool PoolStatsUpdaterFinished_ = false;
+  bool QuerySnapshotUpdaterFinished_ = false;
+
+  // Metrics
+  CMetricHistogram *WorkersUpdateTime_;
+  CMetricHistogram *PoolUpdateTime_;
+  CMetricHistogram *SnapshotUpdateTime_;
+  CMetricGauge *PoolClientsMetric_;
+  CMetricGauge *PoolWorkersMetric_;
+  CMetricGauge *PoolPowerMetric_;
 
   // Debugging only
   struct {
@@ -227,16 +397,22 @@ private:
   } Dbg_;
 
   bool parseStatsCacheFile(CStatsFile &file);
+  bool parseColumnarStatsCacheFile(CStatsFile &file);
+  bool loadCachedRound(CStatsAccumulator &acc, const CStatsFile &file, int64_t lastShareTime, uint64_t shareCount, double shareWork, uint32_t primePOWTarget);
 
-  void enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, bool isOldFormat);
-  void updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData);
+  void enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, EStatsFileFormat format);
+  size_t recentCapacity(const CStatsAccumulator &acc) const { return &acc == &PoolStatsAcc_ ? PoolRecentCapacity_ : WorkersRecentCapacity_; }
+  void updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, CStatsCacheWriter &cacheWriter);
   void calcAverageMetrics(const StatisticDb::CStatsAccumulator &acc, std::chrono::seconds calculateInterval, std::chrono::seconds aggregateTime, CStats &result);
+  void calcUserStats(const std::unordered_map<std::string, CStatsAccumulator> &workers, CStats &userStats, std::vector<CStats> &allStats);
+  static void sortWorkerStats(std::vector<CStats> &allStats, std::vector<CStats> &workerStats, size_t offset, size_t size, EStatsColumn sortBy, bool sortDescending);
+  static void sortUserListStats(std::vector<CredentialsWithStatistic> &usersWithStatistic, std::vector<CredentialsWithStatistic> &result, size_t offset, size_t size, CredentialsWithStatistic::EColumns sortBy, bool sortDescending);
+  void updateQuerySnapshot();
   void writeStatsToDb(const std::string &loginId, const std::string &workerId, const CStatsElement &element);
-  void writeStatsToCache(const std::string &loginId, const std::string &workerId, const CStatsElement &element, int64_t lastShareTime, xmstream &statsFileData);
 
-  void updateStatsDiskCache(const char *name, std::deque<CStatsFile> &cache, int64_t timeLabel, uint64_t lastShareId, const void *data, size_t size);
-  void updateWorkersStatsDiskCache(uint64_t timeLabel, uint64_t shareId, const void *data, size_t size) { updateStatsDiskCache("stats.workers.cache.2", WorkersStatsCache_, timeLabel, shareId, data, size); }
-  void updatePoolStatsDiskCache(uint64_t timeLabel, uint64_t shareId, const void *data, size_t size) { updateStatsDiskCache("stats.pool.cache.2", PoolStatsCache_, timeLabel, shareId, data, size); }
+  void updateStatsDiskCache(const char *name, std::deque<CStatsFile> &cache, int64_t timeLabel, uint64_t lastShareId, const CStatsCacheWriter &cacheWriter);
+  void updateWorkersStatsDiskCache(uint64_t timeLabel, uint64_t shareId, const CStatsCacheWriter &cacheWriter) { updateStatsDiskCache("stats.workers.cache.3", WorkersStatsCache_, timeLabel, shareId, cacheWriter); }
+  void updatePoolStatsDiskCache(uint64_t timeLabel, uint64_t shareId, const CStatsCacheWriter &cacheWriter) { updateStatsDiskCache("stats.pool.cache.3", PoolStatsCache_, timeLabel, shareId, cacheWriter); }
 
 public:
   // Initialization
@@ -246,6 +422,8 @@ public:
   void start();
   void stop();
   const CCoinInfo &getCoinInfo() const { return CoinInfo_; }
+  // Must be called before start()
+  void setQueryThreadPool(CThreadPool *threadPool) { QueryThreadPool_ = threadPool; }
 
   void addShare(const CShare &share, bool updateWorkerAndUserStats, bool updatePoolStats);
 
@@ -271,19 +449,14 @@ public:
   void getHistory(const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, std::vector<CStats> &history);
 
   // Asynchronous api
-  void queryPoolStats(QueryPoolStatsCallback callback) { TaskHandler_.push(new TaskQueryPoolStats(callback)); }
-  void queryUserStats(const std::string &user, QueryUserStatsCallback callback, size_t offset, size_t size, StatisticDb::EStatsColumn sortBy, bool sortDescending) {
-    TaskHandler_.push(new TaskQueryUserStats(user, callback, offset, size, sortBy, sortDescending));
-  }
-
+  void queryPoolStats(QueryPoolStatsCallback callback);
+  void queryUserStats(const std::string &user, QueryUserStatsCallback callback, size_t offset, size_t size, StatisticDb::EStatsColumn sortBy, bool sortDescending);
   void queryAllusersStats(std::vector<UserManager::Credentials> &&users,
                           QueryAllUsersStatisticCallback callback,
                           size_t offset,
                           size_t size,
                           CredentialsWithStatistic::EColumns sortBy,
-                          bool sortDescending) {
-    TaskHandler_.push(new TaskQueryAllUsersStats(std::move(users), callback, offset, size, sortBy, sortDescending));
-  }
+                          bool sortDescending);
 
   static void queryPoolStatsMulti(StatisticDb **backends, size_t backendsNum, std::function<void(const StatisticDb::CStats*, size_t)> callback) {
     MultiCall<StatisticDb::CStats> *context = new MultiCall<StatisticDb::CStats>(backendsNum, callback);
@@ -428,6 +601,7 @@ private:
   ShareLog<StatisticShareLogConfig> ShareLog_;
   std::thread Thread_;
   TaskHandlerCoroutine<StatisticServer> TaskHandler_;
+  std::unique_ptr<CThreadPool> QueryThreadPool_;
 };
 
 
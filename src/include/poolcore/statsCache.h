@@ -0,0 +1,89 @@
+#pragma once
+
+#include "poolcommon/file.h"
+#include "p2putils/xmstream.h"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+// Columnar statistic cache file, one file per aggregation round
+// Layout (little endian, columns 8-byte aligned, file mapped and read in place):
+//   header (see CStatsCacheHeader)
+//   names dictionary: uint32 offsets[NamesNum + 1], characters; name 0 is empty string
+//   int64 lastShareTime[RecordsNum], double shareWork[RecordsNum], uint64 shareCount[RecordsNum]
+//   uint32 login[RecordsNum], uint32 workerId[RecordsNum], uint32 primePOWTarget[RecordsNum]
+// Records of one user are written together, login and workerId are indexes in names dictionary
+struct CStatsCacheHeader {
+  static constexpr uint32_t CurrentMagic = 0x33435350; // 'PSC3'
+  static constexpr uint32_t CurrentVersion = 1;
+
+  uint32_t Magic;
+  uint32_t Version;
+  uint64_t LastShareId;
+  uint32_t RecordsNum;
+  uint32_t NamesNum;
+  uint32_t NamesSize;
+  // crc32c of all data after header
+  uint32_t DataChecksum;
+  // crc32c of header with zero HeaderChecksum
+  uint32_t HeaderChecksum;
+  uint32_t Reserved;
+};
+
+static_assert(sizeof(CStatsCacheHeader) == 40);
+
+class CStatsCacheWriter {
+public:
+  CStatsCacheWriter() : NameOffsets_{0, 0} {}
+
+  void add(const std::string &login, const std::string &workerId, int64_t lastShareTime, uint64_t shareCount, double shareWork, uint32_t primePOWTarget);
+  bool empty() const { return LastShareTime_.empty(); }
+  void serialize(xmstream &out, uint64_t lastShareId) const;
+
+private:
+  uint32_t nameIndex(const std::string &name);
+
+private:
+  std::unordered_map<std::string, uint32_t> NameIndex_;
+  std::vector<uint32_t> NameOffsets_;
+  std::string Names_;
+
+  std::vector<int64_t> LastShareTime_;
+  std::vector<double> ShareWork_;
+  std::vector<uint64_t> ShareCount_;
+  std::vector<uint32_t> Login_;
+  std::vector<uint32_t> WorkerId_;
+  std::vector<uint32_t> PrimePOWTarget_;
+};
+
+class CStatsCacheFile {
+public:
+  // Maps file and validates checksums and dictionary indexes
+  bool open(const std::filesystem::path &path, std::string &error);
+
+  uint64_t lastShareId() const { return Header_->LastShareId; }
+  size_t size() const { return Header_->RecordsNum; }
+  std::string_view name(uint32_t index) const { return std::string_view(Names_ + NameOffsets_[index], NameOffsets_[index + 1] - NameOffsets_[index]); }
+
+  const int64_t *lastShareTime() const { return LastShareTime_; }
+  const double *shareWork() const { return ShareWork_; }
+  const uint64_t *shareCount() const { return ShareCount_; }
+  const uint32_t *login() const { return Login_; }
+  const uint32_t *workerId() const { return WorkerId_; }
+  const uint32_t *primePOWTarget() const { return PrimePOWTarget_; }
+
+private:
+  MappedFile File_;
+  const CStatsCacheHeader *Header_ = nullptr;
+  const uint32_t *NameOffsets_ = nullptr;
+  const char *Names_ = nullptr;
+  const int64_t *LastShareTime_ = nullptr;
+  const double *ShareWork_ = nullptr;
+  const uint64_t *ShareCount_ = nullptr;
+  const uint32_t *Login_ = nullptr;
+  const uint32_t *WorkerId_ = nullptr;
+  const uint32_t *PrimePOWTarget_ = nullptr;
+};
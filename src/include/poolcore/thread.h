@@ -5,7 +5,17 @@
 
 #pragma once
 
+#include <vector>
+
 void InitializeWorkerThread();
 unsigned GetGlobalThreadId();
 unsigned GetLocalThreadId();
 void SetLocalThreadId(unsigned threadId);
+
+// CPU affinity
+// Pins current thread to set of cpus (Linux only), empty set means no pinning
+bool SetCurrentThreadAffinity(const std::vector<unsigned> &cpus);
+// Returns NUMA node of cpu or -1 if unknown
+int GetCpuNumaNode(unsigned cpu);
+// Logs cpus and NUMA nodes available for current thread
+void ReportThreadTopology(const char *name);
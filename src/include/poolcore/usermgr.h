@@ -4,8 +4,10 @@
 #include "poolcore/backendData.h"
 #include "poolcore/poolCore.h"
 #include "poolcore/rocksdbBase.h"
+#include "poolcommon/trace.h"
 #include "poolcommon/uint256.h"
 #include "asyncio/asyncio.h"
+#include <atomic>
 #include <tbb/concurrent_queue.h>
 #include <tbb/concurrent_hash_map.h>
 #include <thread>
@@ -367,6 +369,11 @@ public:
   bool getFeePlan(const std::string &sessionId, const std::string &feePlanId, std::string &status, UserFeePlanRecord &result);
   bool enumerateFeePlan(const std::string &sessionId, std::string &status, std::vector<UserFeePlanRecord> &result);
   UserFeeConfig getFeeRecord(const std::string &feePlanId, const std::string &coin);
+  // Changed after any fee plan update or user fee plan change, allows caching of getFeePlanId/getFeeRecord results
+  uint64_t feeConfigVersion() const { return FeeConfigVersion_.load(std::memory_order_acquire); }
+  // Runtime tracing control (admin only)
+  bool setTraceSettings(const std::string &sessionId, const CTraceSettings &settings, std::string &status);
+  bool getTraceStatus(const std::string &sessionId, std::string &status, CTraceStatus &result);
 
 private:
   // Asynchronous api implementation
@@ -412,7 +419,9 @@ private:
 
   bool acceptFeePlanRecord(const UserFeePlanRecord &record, std::string &error);
   void buildFeePlanRecord(const std::string &feePlanId, const FeePlan &plan, UserFeePlanRecord &result);
+  void updateLinkedFeePlans(const std::string &feePlanId, const FeePlan &plan);
   void collectLinkedFeePlans(const std::string &userId, std::unordered_set<std::string> &plans);
+  bool isLinkedFeePlan(const std::string &userId, const std::string &feePlanId);
 
   void userManagerMain();
   void userManagerCleanup();
@@ -435,6 +444,10 @@ private:
   tbb::concurrent_hash_map<uint512, UserSessionRecord, TbbHash<512>> SessionsCache_;
   tbb::concurrent_hash_map<std::string, UserSettingsRecord> SettingsCache_;
   tbb::concurrent_hash_map<std::string, FeePlan> FeePlanCache_;
+  // Reverse index of FeePlanCache_: user -> fee plans which contain user in default or coin specific fee list
+  tbb::concurrent_hash_map<std::string, std::unordered_set<std::string>> UserLinkedFeePlans_;
+  // Incremented after change applied to caches
+  std::atomic<uint64_t> FeeConfigVersion_ = 0;
 
   // Thread local structures
   std::unordered_map<uint512, UserActionRecord> ActionsCache_;
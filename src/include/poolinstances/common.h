@@ -6,6 +6,14 @@
 #include "rapidjson/document.h"
 #include "loguru.hpp"
 #include "asyncio/socket.h"
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
 
 
 using ListenerCallback = std::function<void(socketTy, HostAddress, void*)>;
@@ -25,14 +33,37 @@ static void listenerAcceptCb(AsyncOpStatus status, aioObject *object, HostAddres
   aioAccept(object, 0, listenerAcceptCb, arg);
 }
 
-static void createListener(asyncBase *base, uint16_t port, ListenerCallback callback, void *arg)
+enum EListenerSteering {
+  ESteeringNone = 0,
+  // Kernel prefers listener with SO_INCOMING_CPU equal to CPU handled incoming packet
+  ESteeringIncomingCpu,
+  // Classic BPF program selects listener by CPU number
+  ESteeringCBPF
+};
+
+static bool createListenerSocket(uint16_t port, bool reusePort, socketTy *result)
 {
+#ifndef SO_REUSEPORT
+  if (reusePort)
+    return false;
+#endif
+
   HostAddress address;
   address.family = AF_INET;
   address.ipv4 = INADDR_ANY;
   address.port = htons(port);
   socketTy hSocket = socketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1);
   socketReuseAddr(hSocket);
+#ifdef SO_REUSEPORT
+  if (reusePort) {
+    int value = 1;
+    if (setsockopt(hSocket, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)) != 0) {
+      close(hSocket);
+      return false;
+    }
+  }
+#endif
+
   if (socketBind(hSocket, &address) != 0) {
     LOG_F(ERROR, "cannot bind port: %i", port);
     exit(1);
@@ -43,6 +74,12 @@ static void createListener(asyncBase *base, uint16_t port, ListenerCallback call
     exit(1);
   }
 
+  *result = hSocket;
+  return true;
+}
+
+static void startAccept(asyncBase *base, socketTy hSocket, ListenerCallback callback, void *arg)
+{
   aioObject *object = newSocketIo(base, hSocket);
 
   ListenerContext *context = new ListenerContext;
@@ -50,3 +87,74 @@ static void createListener(asyncBase *base, uint16_t port, ListenerCallback call
   context->Arg = arg;
   aioAccept(object, 0, listenerAcceptCb, context);
 }
+
+static void createListener(asyncBase *base, uint16_t port, ListenerCallback callback, void *arg)
+{
+  socketTy hSocket;
+  createListenerSocket(port, false, &hSocket);
+  startAccept(base, hSocket, callback, arg);
+}
+
+// One SO_REUSEPORT listener per event loop, kernel distributes incoming connections between them
+// cpus[i] is cpu of pinned event loop i or -1, SO_INCOMING_CPU and BPF steering send connections of its cpu to pinned loop
+// Returns false if SO_REUSEPORT not supported, nothing created in this case
+static bool createReusePortListeners(asyncBase **bases, const int *cpus, unsigned basesNum, uint16_t port, EListenerSteering steering, ListenerCallback callback, void *arg)
+{
+#ifndef SO_REUSEPORT
+  return false;
+#else
+  std::vector<socketTy> sockets(basesNum);
+  for (unsigned i = 0; i < basesNum; i++) {
+    if (!createListenerSocket(port, true, &sockets[i])) {
+      for (unsigned j = 0; j < i; j++)
+        close(sockets[j]);
+      return false;
+    }
+  }
+
+  if (steering == ESteeringIncomingCpu) {
+#ifdef SO_INCOMING_CPU
+    unsigned pinnedNum = 0;
+    for (unsigned i = 0; i < basesNum; i++) {
+      int cpu = cpus[i];
+      if (cpu < 0)
+        continue;
+      pinnedNum++;
+      if (setsockopt(sockets[i], SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) != 0)
+        LOG_F(WARNING, "port %u: can't set SO_INCOMING_CPU", static_cast<unsigned>(port));
+    }
+
+    if (!pinnedNum)
+      LOG_F(WARNING, "port %u: SO_INCOMING_CPU steering ignored, worker threads not pinned to cpus", static_cast<unsigned>(port));
+#else
+    LOG_F(WARNING, "port %u: SO_INCOMING_CPU not supported", static_cast<unsigned>(port));
+#endif
+  } else if (steering == ESteeringCBPF) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+    // Listener of event loop pinned to current cpu (same mapping as SO_INCOMING_CPU), cpu % listeners number for other cpus
+    std::vector<sock_filter> code;
+    code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) });
+    for (unsigned i = 0; i < basesNum; i++) {
+      if (cpus[i] < 0)
+        continue;
+      code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(cpus[i]) });
+      code.push_back({ BPF_RET | BPF_K, 0, 0, i });
+    }
+    code.push_back({ BPF_ALU | BPF_MOD | BPF_K, 0, 0, basesNum });
+    code.push_back({ BPF_RET | BPF_A, 0, 0, 0 });
+
+    struct sock_fprog program;
+    program.len = static_cast<unsigned short>(code.size());
+    program.filter = code.data();
+    if (setsockopt(sockets[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) != 0)
+      LOG_F(WARNING, "port %u: can't attach reuseport BPF program", static_cast<unsigned>(port));
+#else
+    LOG_F(WARNING, "port %u: reuseport BPF steering not supported", static_cast<unsigned>(port));
+#endif
+  }
+
+  for (unsigned i = 0; i < basesNum; i++)
+    startAccept(bases[i], sockets[i], callback, arg);
+  return true;
+#endif
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "common.h"
+#include "poolcommon/metrics.h"
+#include "poolcore/poolInstance.h"
+#include <asyncio/socket.h>
+#include <string_view>
+#include <string.h>
+
+// Pull endpoint for pool metrics: answers 'GET /metrics' in Prometheus text format
+// Runs in monitor thread, scrape aggregates per-thread shards of all registered metrics
+class PrometheusInstance : public CPoolInstance {
+public:
+  PrometheusInstance(asyncBase *monitorBase, UserManager &userMgr, const std::vector<PoolBackend*>&, CThreadPool &threadPool, unsigned, unsigned, rapidjson::Value &config) : CPoolInstance(monitorBase, userMgr, threadPool) {
+    if (!config.HasMember("port") || !config["port"].IsUint()) {
+      LOG_F(ERROR, "instance %s: can't read 'port' value from config", "metrics/prometheus");
+      exit(1);
+    }
+
+    uint16_t port = config["port"].GetUint();
+    createListener(monitorBase, port, [](socketTy socket, HostAddress, void *arg) { static_cast<PrometheusInstance*>(arg)->newConnection(socket); }, this);
+  }
+
+  virtual void stopWork() override {}
+  virtual void checkNewBlockTemplate(CBlockTemplate*, PoolBackend*) override {}
+
+private:
+  static constexpr size_t MaxRequestSize = 4096;
+  static constexpr uint64_t RequestTimeout = 5000000;
+
+  struct Connection {
+    PrometheusInstance *Instance;
+    aioObject *Socket;
+    char Buffer[MaxRequestSize];
+    size_t Size = 0;
+    std::string Response;
+  };
+
+private:
+  void newConnection(socketTy fd) {
+    Connection *connection = new Connection;
+    connection->Instance = this;
+    connection->Socket = newSocketIo(MonitorBase_, fd);
+    objectSetDestructorCb(aioObjectHandle(connection->Socket), [](aioObjectRoot*, void *arg) {
+      delete static_cast<Connection*>(arg);
+    }, connection);
+    aioRead(connection->Socket, connection->Buffer, sizeof(connection->Buffer), afNone, RequestTimeout, reinterpret_cast<aioCb*>(readCb), connection);
+  }
+
+  static void readCb(AsyncOpStatus status, aioObject*, size_t size, Connection *connection) {
+    if (status != aosSuccess) {
+      deleteAioObject(connection->Socket);
+      return;
+    }
+
+    connection->Size += size;
+    if (std::string_view(connection->Buffer, connection->Size).find("\r\n\r\n") == std::string_view::npos) {
+      if (connection->Size == sizeof(connection->Buffer)) {
+        deleteAioObject(connection->Socket);
+        return;
+      }
+
+      aioRead(connection->Socket, connection->Buffer + connection->Size, sizeof(connection->Buffer) - connection->Size, afNone, RequestTimeout, reinterpret_cast<aioCb*>(readCb), connection);
+      return;
+    }
+
+    static const char MetricsRequest[] = "GET /metrics";
+    size_t prefixSize = sizeof(MetricsRequest) - 1;
+    bool isMetrics = connection->Size > prefixSize &&
+                     memcmp(connection->Buffer, MetricsRequest, prefixSize) == 0 &&
+                     (connection->Buffer[prefixSize] == ' ' || connection->Buffer[prefixSize] == '?');
+
+    std::string body;
+    if (isMetrics)
+      metricsScrape(body);
+    else
+      body = "not found\n";
+
+    char header[256];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 %s\r\n"
+             "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+             "Content-Length: %zu\r\n"
+             "Connection: close\r\n\r\n",
+             isMetrics ? "200 OK" : "404 Not Found",
+             body.size());
+    connection->Response = header;
+    connection->Response.append(body);
+
+    aioWrite(connection->Socket, connection->Response.data(), connection->Response.size(), afWaitAll, RequestTimeout, [](AsyncOpStatus, aioObject*, size_t, void *arg) {
+      deleteAioObject(static_cast<Connection*>(arg)->Socket);
+    }, connection);
+  }
+};
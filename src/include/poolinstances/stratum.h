@@ -6,6 +6,9 @@
 #include "poolcommon/arith_uint256.h"
 #include "poolcommon/debug.h"
 #include "poolcommon/jsonSerializer.h"
+#include "poolcommon/metrics.h"
+#include "poolcommon/objectPool.h"
+#include "poolcommon/ringBuffer.h"
 #include "poolcore/backend.h"
 #include "poolcore/blockTemplate.h"
 #include "poolcore/poolCore.h"
@@ -14,8 +17,16 @@
 #include <rapidjson/writer.h>
 #include <unordered_map>
 
-static constexpr unsigned UncheckedSendCount = 32;
+// Receive buffers: inline buffer enough for most stratum messages
+static constexpr size_t InlineBufferSize = 1024;
+static constexpr size_t LargeBufferSize = 12288;
 static constexpr uint64_t SendTimeout = 4000000;
+// Output queue: connection closed when miner not reads and queued data exceeds limit
+static constexpr size_t OutputQueueLimit = 256*1024;
+// Write buffer capacity kept after write completion while more data queued
+static constexpr size_t OutputBufferKeepCapacity = 16384;
+// Output buffers capacity kept by idle connection (empty queue)
+static constexpr size_t OutputBufferIdleCapacity = 1024;
 
 enum StratumErrorTy {
   StratumErrorInvalidShare = 20,
@@ -84,6 +95,26 @@ public:
     Name_ += ".";
     Name_ += std::to_string(port);
 
+    std::string instanceLabel = metricLabel("instance", Name_);
+    NotifyTime_ = &metricHistogram("pool_stratum_notify_seconds", "Time from block template receive to work sent to all miners", instanceLabel);
+    BroadcastTime_ = &metricHistogram("pool_stratum_broadcast_seconds", "Work broadcast time per worker thread", instanceLabel);
+    SubmitTime_ = &metricHistogram("pool_stratum_submit_seconds", "Share submit processing time", instanceLabel);
+    SharesAccepted_ = &metricCounter("pool_stratum_shares_total", "Shares submitted by miners", metricLabels("instance", Name_, "result", "accepted"));
+    SharesRejected_ = &metricCounter("pool_stratum_shares_total", "Shares submitted by miners", metricLabels("instance", Name_, "result", "rejected"));
+    NotifyDropped_ = &metricCounter("pool_stratum_notify_dropped_total", "Queued work notifications superseded by newer work before send", instanceLabel);
+    OutputOverflows_ = &metricCounter("pool_stratum_output_overflows_total", "Connections closed by output queue limit", instanceLabel);
+    MetricsCollector_ = metricsAddCollector([this, instanceLabel](CMetricsWriter &writer) {
+      CConnectionStats stats;
+      connectionStats(stats);
+      writer.counter("pool_stratum_accepted_connections_total", "Accepted stratum connections", instanceLabel, stats.Accepted);
+      writer.gauge("pool_stratum_connection_memory_bytes", "Memory used by stratum connections", instanceLabel, static_cast<double>(stats.ConnectionMemory));
+      for (size_t i = 0; i < stats.ThreadConnections.size(); i++) {
+        std::string labels = instanceLabel + "," + metricLabel("thread", std::to_string(i));
+        writer.gauge("pool_stratum_connections", "Active stratum connections", labels, static_cast<double>(stats.ThreadConnections[i]));
+        writer.gauge("pool_stratum_output_queue_bytes", "Data queued for send to miners", labels, static_cast<double>(Data_[i].OutputQueueSize.load(std::memory_order_relaxed)));
+      }
+    });
+
     // Share diff
     if (config.HasMember("shareDiff")) {
       if (config["shareDiff"].IsUint64()) {
@@ -117,8 +148,58 @@ public:
 
     MiningCfg_.initialize(config);
 
+    // Accept mode: 'reuseport' creates listener on each worker thread, otherwise monitor thread accepts
+    // connections and sends them to least loaded worker
+    bool reusePort = false;
+    EListenerSteering steering = ESteeringNone;
+    if (config.HasMember("acceptMode") && config["acceptMode"].IsString()) {
+      std::string acceptMode = config["acceptMode"].GetString();
+      if (acceptMode == "reuseport") {
+        reusePort = true;
+      } else if (acceptMode != "balanced") {
+        LOG_F(ERROR, "%s: unknown accept mode '%s' (expected 'reuseport' or 'balanced')", Name_.c_str(), acceptMode.c_str());
+        exit(1);
+      }
+    }
+
+    if (config.HasMember("acceptSteering") && config["acceptSteering"].IsString()) {
+      std::string acceptSteering = config["acceptSteering"].GetString();
+      if (acceptSteering == "cpu") {
+        steering = ESteeringIncomingCpu;
+      } else if (acceptSteering == "bpf") {
+        steering = ESteeringCBPF;
+      } else if (acceptSteering != "none") {
+        LOG_F(ERROR, "%s: unknown accept steering '%s' (expected 'none', 'cpu' or 'bpf')", Name_.c_str(), acceptSteering.c_str());
+        exit(1);
+      }
+    }
+
+    if (reusePort) {
+      std::vector<asyncBase*> bases;
+      std::vector<int> cpus;
+      for (unsigned i = 0; i < threadPool.threadsNum(); i++) {
+        bases.push_back(Data_[i].WorkerBase);
+        cpus.push_back(threadPool.getCpu(i));
+      }
+      // Accept callback runs in worker thread
+      reusePort = createReusePortListeners(bases.data(), cpus.data(), static_cast<unsigned>(bases.size()), port, steering, [](socketTy socket, HostAddress address, void *arg) {
+        auto instance = static_cast<StratumInstance*>(arg);
+        unsigned workerId = GetLocalThreadId();
+        instance->Data_[workerId].ConnectionsNum++;
+        instance->AcceptedNum_++;
+        instance->acceptConnection(workerId, socket, address);
+      }, this);
+      if (!reusePort)
+        LOG_F(WARNING, "%s: SO_REUSEPORT not supported, use balanced accept mode", Name_.c_str());
+    }
+
     // Main listener
-    createListener(monitorBase, port, [](socketTy socket, HostAddress address, void *arg) { static_cast<StratumInstance*>(arg)->newFrontendConnection(socket, address); }, this);
+    if (!reusePort)
+      createListener(monitorBase, port, [](socketTy socket, HostAddress address, void *arg) { static_cast<StratumInstance*>(arg)->newFrontendConnection(socket, address); }, this);
+  }
+
+  virtual ~StratumInstance() {
+    metricsRemoveCollector(MetricsCollector_);
   }
 
   virtual void checkNewBlockTemplate(CBlockTemplate *blockTemplate, PoolBackend *backend) override {
@@ -128,6 +209,16 @@ public:
       MiningStats_->onWork(blockTemplate->Difficulty, backend);
   }
 
+  virtual void connectionStats(CConnectionStats &stats) override {
+    stats.Accepted = AcceptedNum_;
+    stats.ThreadConnections.resize(ThreadPool_.threadsNum());
+    stats.ConnectionMemory = 0;
+    for (unsigned i = 0; i < ThreadPool_.threadsNum(); i++) {
+      stats.ThreadConnections[i] = Data_[i].ConnectionsNum;
+      stats.ConnectionMemory += Data_[i].MemoryUsage;
+    }
+  }
+
   virtual void stopWork() override {
     for (unsigned i = 0; i < ThreadPool_.threadsNum(); i++)
       ThreadPool_.startAsyncTask(i, new AcceptWork(*this, nullptr, nullptr));
@@ -136,19 +227,24 @@ public:
   void acceptConnection(unsigned workerId, socketTy socketFd, HostAddress address) {
     ThreadData &data = Data_[workerId];
     aioObject *socket = newSocketIo(data.WorkerBase, socketFd);
-    Connection *connection = new Connection(this, socket, workerId, address);
+    Connection *connection = data.ConnectionPool.create(this, socket, workerId, address);
+    // Destructor callback runs in owning worker thread
     objectSetDestructorCb(aioObjectHandle(socket), [](aioObjectRoot*, void *arg) {
-      delete static_cast<Connection*>(arg);
+      Connection *connection = static_cast<Connection*>(arg);
+      ThreadData &data = connection->Instance->Data_[connection->WorkerId];
+      data.ConnectionPool.destroy(connection);
+      data.updateMemoryUsage();
     }, connection);
+    data.updateMemoryUsage();
 
     connection->WorkerConfig.initialize(data.ThreadCfg);
     if (isDebugInstanceStratumConnections())
-      LOG_F(1, "%s: new connection from %s", Name_.c_str(), connection->AddressHr.c_str());
+      trace(ETraceStratumConnections, Name_.c_str(), address.ipv4, address.port, nullptr, "new connection", {});
 
     // Initialize share difficulty
-    connection->ShareDifficulty = ConstantShareDiff_;
+    setShareDifficulty(connection, ConstantShareDiff_);
 
-    aioRead(connection->Socket, connection->Buffer, sizeof(connection->Buffer), afNone, 3000000, reinterpret_cast<aioCb*>(readCb), connection);
+    aioRead(connection->Socket, connection->Buffer, connection->BufferSize, afNone, 3000000, reinterpret_cast<aioCb*>(readCb), connection);
   }
 
   void acceptWork(CBlockTemplate *blockTemplate, PoolBackend *backend) {
@@ -242,11 +338,13 @@ public:
       unsigned counter = 0;
       for (auto &connection: data.Connections_) {
         connection->ResendCount = 0;
-        stratumSendWork(connection, work, currentTime);
+        stratumSendWork(connection, work, currentTime, resetPreviousWork);
         counter++;
       }
 
       auto endPt = std::chrono::steady_clock::now();
+      BroadcastTime_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(endPt - beginPt).count());
+      NotifyTime_->recordSince(blockTemplate->ReceiveTime);
       auto timeDiff = std::chrono::duration_cast<std::chrono::milliseconds>(endPt - beginPt).count();
       if (GetLocalThreadId() == 0)
         LOG_F(INFO, "[t=0] %s: Broadcast %s work %" PRIi64 "(reset=%s) & send to %u clients in %.3lf seconds", Name_.c_str(), workName(work).c_str(), work->stratumId(), resetPreviousWork ? "yes" : "no", counter, static_cast<double>(timeDiff)/1000.0);
@@ -283,15 +381,19 @@ private:
     Connection(StratumInstance *instance, aioObject *socket, unsigned workerId, HostAddress address) : Instance(instance), Socket(socket), WorkerId(workerId), Address(address) {
       struct in_addr addr;
       addr.s_addr = Address.ipv4;
-      AddressHr = inet_ntoa(addr);
-      AddressHr.push_back(':');
-      AddressHr.append(std::to_string(htons(address.port)));
+      snprintf(AddressHr, sizeof(AddressHr), "%s:%u", inet_ntoa(addr), static_cast<unsigned>(htons(address.port)));
     }
 
     ~Connection() {
       if (isDebugInstanceStratumConnections())
-        LOG_F(1, "%s: disconnected from %s", Instance->Name_.c_str(), AddressHr.c_str());
-      Instance->Data_[WorkerId].Connections_.erase(this);
+        trace(ETraceStratumConnections, Instance->Name_.c_str(), Address.ipv4, Address.port, Instance->traceUser(this), "disconnected", {});
+      ThreadData &data = Instance->Data_[WorkerId];
+      data.Connections_.erase(this);
+      data.ConnectionsNum--;
+      data.updateOutputQueueSize(-static_cast<int64_t>(OutputQueue.size() + WriteBuffer.size()));
+      data.OutputBufferMemory -= OutputBufferMemory;
+      if (Buffer != InlineBuffer)
+        data.LargeBufferPool.release(Buffer);
     }
 
     void close() {
@@ -307,58 +409,152 @@ private:
     aioObject *Socket;
     unsigned WorkerId;
     HostAddress Address;
-    std::string AddressHr;
-    unsigned SendCounter_ = 0;
+    char AddressHr[24];
     bool Active = true;
     bool IsCgMiner = false;
     bool IsNiceHash = false;
     int64_t LastUpdateTime = std::numeric_limits<int64_t>::max();
     // Stratum protocol decoding
-    char Buffer[12288];
+    // Small inline buffer, replaced by buffer from thread pool for long messages
+    char InlineBuffer[InlineBufferSize];
+    char *Buffer = InlineBuffer;
+    size_t BufferSize = InlineBufferSize;
     size_t MsgTailSize = 0;
+    // Output queue: messages appended to OutputQueue, WriteBuffer owned by active write (one at once)
+    std::string OutputQueue;
+    std::string WriteBuffer;
+    bool WriteActive = false;
+    // Output buffers capacity accounted in ThreadData::OutputBufferMemory
+    size_t OutputBufferMemory = 0;
+    // Messages queued during processing of received data sent by one write
+    bool DeferFlush = false;
+    // Last work notification in OutputQueue, replaced by newer work
+    size_t QueuedNotifyOffset = 0;
+    size_t QueuedNotifySize = 0;
+    bool QueuedNotifyReset = false;
     // Mining info
     typename X::Stratum::WorkerConfig WorkerConfig;
-    // Current share difficulty (one for all workers on connection)
+    // Current share difficulty (one for all workers on connection) and its hash target, change with setShareDifficulty
     double ShareDifficulty;
+    arith_uint256 ShareTarget;
     // Workers
     std::unordered_map<std::string, Worker> Workers;
     // Share statistic
     static constexpr unsigned SSWindowSize = 10;
     static constexpr unsigned SSWindowElementSize = 10;
 
-    // TODO use cycle buffer here
-    std::deque<uint32_t> InvalidShares;
+    CRingBuffer<uint32_t, SSWindowSize> InvalidShares;
     unsigned TotalSharesCounter = 0;
     unsigned InvalidSharesCounter = 0;
     unsigned InvalidSharesSequenceSize = 0;
     unsigned ResendCount = 0;
   };
 
-  struct ThreadData {
+  // Cache line aligned, owned by workers which can run on different NUMA nodes
+  // Connections and works allocated by owning worker thread (local NUMA node after pinning)
+  struct alignas(64) ThreadData {
     asyncBase *WorkerBase;
     ThreadConfig ThreadCfg;
     std::set<Connection*> Connections_;
     StratumWorkStorage<X> WorkStorage;
+    // Includes connections sent to worker but not accepted yet, read by monitor thread
+    std::atomic<unsigned> ConnectionsNum = 0;
+    // Connection objects and receive buffers for long messages
+    CObjectPool<Connection> ConnectionPool;
+    CBufferPool LargeBufferPool = CBufferPool(LargeBufferSize, 256);
+    std::atomic<size_t> MemoryUsage = 0;
+    // Output buffers capacity of all connections
+    size_t OutputBufferMemory = 0;
+    // Queued and being written data of all connections, read by monitor thread
+    std::atomic<size_t> OutputQueueSize = 0;
+
+    void updateMemoryUsage() { MemoryUsage = ConnectionPool.memoryUsage() + LargeBufferPool.memoryUsage() + OutputBufferMemory; }
+    void updateOutputQueueSize(int64_t delta) { OutputQueueSize.store(OutputQueueSize.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); }
   };
 
 private:
+  // First authorized user of connection, for trace user filter
+  static const std::string *traceUser(Connection *connection) {
+    return !connection->Workers.empty() ? &connection->Workers.begin()->second.User : nullptr;
+  }
+
+  // Copies message to output queue of connection, closes connection if queue limit exceeded
+  bool enqueue(Connection *connection, const xmstream &stream) {
+    if (!connection->Active)
+      return false;
+
+    if (isDebugInstanceStratumMessages())
+      trace(ETraceStratumMessages, Name_.c_str(), connection->Address.ipv4, connection->Address.port, traceUser(connection), "outgoing message", {std::string_view(stream.data<char>(), stream.sizeOf())});
+
+    if (connection->OutputQueue.size() + connection->WriteBuffer.size() + stream.sizeOf() > OutputQueueLimit) {
+      if (isDebugInstanceStratumConnections())
+        trace(ETraceStratumConnections, Name_.c_str(), connection->Address.ipv4, connection->Address.port, traceUser(connection), "output queue limit exceeded, disconnecting", {});
+      OutputOverflows_->add();
+      connection->close();
+      return false;
+    }
+
+    connection->OutputQueue.append(stream.data<char>(), stream.sizeOf());
+    Data_[connection->WorkerId].updateOutputQueueSize(stream.sizeOf());
+    updateOutputBufferMemory(connection);
+    return true;
+  }
+
+  // Accounts output buffers capacity change in connection memory usage
+  static void updateOutputBufferMemory(Connection *connection) {
+    size_t memory = connection->OutputQueue.capacity() + connection->WriteBuffer.capacity();
+    if (memory == connection->OutputBufferMemory)
+      return;
+    ThreadData &data = connection->Instance->Data_[connection->WorkerId];
+    data.OutputBufferMemory = data.OutputBufferMemory - connection->OutputBufferMemory + memory;
+    connection->OutputBufferMemory = memory;
+    data.updateMemoryUsage();
+  }
+
   void send(Connection *connection, const xmstream &stream) {
-    if (isDebugInstanceStratumMessages()) {
-      std::string msg(stream.data<char>(), stream.sizeOf());
-      LOG_F(1, "%s(%s): outgoing message %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), msg.c_str());
+    if (enqueue(connection, stream) && !connection->DeferFlush)
+      flush(connection);
+  }
+
+  // Starts write of all queued messages if no active write
+  void flush(Connection *connection) {
+    if (connection->WriteActive || connection->OutputQueue.empty() || !connection->Active)
+      return;
+
+    std::swap(connection->OutputQueue, connection->WriteBuffer);
+    connection->QueuedNotifySize = 0;
+    connection->WriteActive = true;
+    aioWrite(connection->Socket, connection->WriteBuffer.data(), connection->WriteBuffer.size(), afWaitAll, SendTimeout, reinterpret_cast<aioCb*>(writeCb), connection);
+  }
+
+  static void writeCb(AsyncOpStatus status, aioObject*, size_t, Connection *connection) {
+    connection->Instance->Data_[connection->WorkerId].updateOutputQueueSize(-static_cast<int64_t>(connection->WriteBuffer.size()));
+    connection->WriteBuffer.clear();
+    if (connection->OutputQueue.empty()) {
+      // Nothing to send, don't hold large buffers on idle connection
+      if (connection->WriteBuffer.capacity() > OutputBufferIdleCapacity)
+        std::string().swap(connection->WriteBuffer);
+      if (connection->OutputQueue.capacity() > OutputBufferIdleCapacity)
+        std::string().swap(connection->OutputQueue);
+    } else if (connection->WriteBuffer.capacity() > OutputBufferKeepCapacity) {
+      std::string().swap(connection->WriteBuffer);
     }
-    if (++connection->SendCounter_ < UncheckedSendCount) {
-      aioWrite(connection->Socket, stream.data(), stream.sizeOf(), afWaitAll, 0, nullptr, nullptr);
-    } else {
-      aioWrite(connection->Socket, stream.data(), stream.sizeOf(), afWaitAll, SendTimeout, [](AsyncOpStatus status, aioObject*, size_t, void *arg) {
-        if (status != aosSuccess) {
-          Connection *connection = static_cast<Connection*>(arg);
-          LOG_F(1, "%s: send timeout to %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str());
-          connection->close();
-        }
-      }, connection);
-      connection->SendCounter_ = 0;
+    updateOutputBufferMemory(connection);
+    connection->WriteActive = false;
+
+    if (status != aosSuccess) {
+      LOG_F(1, "%s: send timeout to %s", connection->Instance->Name_.c_str(), connection->AddressHr);
+      connection->close();
+      return;
     }
+
+    if (!connection->DeferFlush)
+      connection->Instance->flush(connection);
+  }
+
+  static void setShareDifficulty(Connection *connection, double difficulty) {
+    connection->ShareDifficulty = difficulty;
+    connection->ShareTarget = X::Stratum::shareTarget(difficulty);
   }
 
   void onStratumSubscribe(Connection *connection, typename X::Stratum::StratumMessage &msg) {
@@ -367,11 +563,11 @@ private:
     if (msg.Subscribe.minerUserAgent.find("NiceHash") != std::string::npos) {
       connection->IsNiceHash = true;
       if (AlgoMetaStatistic_->coinInfo().Name == "sha256") {
-        connection->ShareDifficulty = std::max(500000.0, connection->ShareDifficulty);
+        setShareDifficulty(connection, std::max(500000.0, connection->ShareDifficulty));
       } else if (AlgoMetaStatistic_->coinInfo().Name == "scrypt") {
-        connection->ShareDifficulty = std::max(10.0, connection->ShareDifficulty);
+        setShareDifficulty(connection, std::max(10.0, connection->ShareDifficulty));
       } else if (AlgoMetaStatistic_->coinInfo().Name == "equihash.200.9") {
-        connection->ShareDifficulty = std::max(131072.0, connection->ShareDifficulty);
+        setShareDifficulty(connection, std::max(131072.0, connection->ShareDifficulty));
       }
     }
 
@@ -382,7 +578,7 @@ private:
     connection->WorkerConfig.onSubscribe(MiningCfg_, msg, stream, subscribeInfo);
     send(connection, stream);
     if (isDebugInstanceStratumConnections())
-      LOG_F(1, "%s(%s): subscribe data: %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), subscribeInfo.c_str());
+      trace(ETraceStratumConnections, Name_.c_str(), connection->Address.ipv4, connection->Address.port, nullptr, "subscribe data:", {subscribeInfo});
   }
 
   bool onStratumAuthorize(Connection *connection, typename X::Stratum::StratumMessage &msg) {
@@ -511,7 +707,7 @@ private:
     auto It = connection->Workers.find(msg.Submit.WorkerName);
     if (It == connection->Workers.end()) {
       if (isDebugInstanceStratumRejects())
-        LOG_F(1, "%s(%s) reject: unknown worker name: %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), msg.Submit.WorkerName.c_str());
+        trace(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, traceUser(connection), "reject: unknown worker name:", {msg.Submit.WorkerName});
       errorCode = StratumErrorUnauthorizedWorker;
       return false;
     }
@@ -524,7 +720,7 @@ private:
       size_t sharpPos = msg.Submit.JobId.find('#');
       if (sharpPos == msg.Submit.JobId.npos) {
         if (isDebugInstanceStratumRejects())
-          LOG_F(1, "%s(%s) %s/%s reject: invalid job id format: %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), worker.User.c_str(), worker.WorkerName.c_str(), msg.Submit.JobId.c_str());
+          trace(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, &worker.User, "reject: invalid job id format:", {worker.User, worker.WorkerName, msg.Submit.JobId});
         errorCode = StratumErrorJobNotFound;
         return false;
       }
@@ -534,7 +730,7 @@ private:
       work = data.WorkStorage.workById(majorJobId);
       if (!work) {
         if (isDebugInstanceStratumRejects())
-          LOG_F(1, "%s(%s) %s/%s reject: unknown job id: %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), worker.User.c_str(), worker.WorkerName.c_str(), msg.Submit.JobId.c_str());
+          trace(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, &worker.User, "reject: unknown job id:", {worker.User, worker.WorkerName, msg.Submit.JobId.c_str()});
         errorCode = StratumErrorJobNotFound;
         return false;
       }
@@ -544,7 +740,7 @@ private:
     std::string user = worker.User;
     if (!work->prepareForSubmit(connection->WorkerConfig, msg)) {
       if (isDebugInstanceStratumRejects())
-        LOG_F(1, "%s(%s) %s/%s reject: invalid share format", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), worker.User.c_str(), worker.WorkerName.c_str());
+        trace(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, &worker.User, "reject: invalid share format:", {worker.User, worker.WorkerName});
       errorCode = StratumErrorInvalidShare;
       return false;
     }
@@ -553,7 +749,7 @@ private:
     typename X::Proto::BlockHashTy shareHash = work->shareHash();
     if (data.WorkStorage.isDuplicate(work, shareHash)) {
       if (isDebugInstanceStratumRejects())
-        LOG_F(1, "%s(%s) %s/%s reject: duplicate share", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), worker.User.c_str(), worker.WorkerName.c_str());
+        trace(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, &worker.User, "reject: duplicate share:", {worker.User, worker.WorkerName});
       errorCode = StratumErrorDuplicateShare;
       return false;
     }
@@ -564,25 +760,28 @@ private:
       PoolBackend *backend = work->backend(i);
       if (!backend) {
         if (isDebugInstanceStratumRejects())
-          LOG_F(1, "%s(%s) %s/%s sub-reject: backend %zu not initialized", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), worker.User.c_str(), worker.WorkerName.c_str(), i);
+          traceFormat(ETraceStratumRejects, Name_.c_str(), connection->Address.ipv4, connection->Address.port, &worker.User, "sub-reject: backend not initialized:", "%s %s %zu", worker.User.c_str(), worker.WorkerName.c_str(), i);
         continue;
       }
 
       blockHash = work->blockHash(i);
 
       height = work->height(i);
-      bool isBlock = work->checkConsensus(i, &shareDiff);
+      bool isBlock = work->checkConsensus(i, &shareDiff, &connection->ShareTarget);
       if (shareDiff < connection->ShareDifficulty) {
         if (isDebugInstanceStratumRejects())
-          LOG_F(1,
-                "%s(%s) %s/%s sub-reject(%s): invalid share difficulty %lg (%lg required)",
-                connection->Instance->Name_.c_str(),
-                connection->AddressHr.c_str(),
-                worker.User.c_str(),
-                worker.WorkerName.c_str(),
-                backend->getCoinInfo().Name.c_str(),
-                shareDiff,
-                connection->ShareDifficulty);
+          traceFormat(ETraceStratumRejects,
+                      Name_.c_str(),
+                      connection->Address.ipv4,
+                      connection->Address.port,
+                      &worker.User,
+                      "sub-reject: invalid share difficulty:",
+                      "%s %s %s %lg (%lg required)",
+                      worker.User.c_str(),
+                      worker.WorkerName.c_str(),
+                      backend->getCoinInfo().Name.c_str(),
+                      shareDiff,
+                      connection->ShareDifficulty);
         continue;
       }
 
@@ -663,8 +862,11 @@ private:
   }
 
   void onStratumSubmit(Connection *connection, typename X::Stratum::StratumMessage &msg) {
+    auto beginPt = std::chrono::steady_clock::now();
     StratumErrorTy errorCode;
     bool result = shareCheck(connection, msg, errorCode);
+    SubmitTime_->recordSince(beginPt);
+    (result ? SharesAccepted_ : SharesRejected_)->add();
 
     // Update invalid shares statistic
     connection->TotalSharesCounter++;
@@ -676,11 +878,9 @@ private:
     }
 
     if (connection->TotalSharesCounter == Connection::SSWindowElementSize) {
-      connection->InvalidShares.push_back(connection->InvalidSharesCounter);
+      connection->InvalidShares.push(connection->InvalidSharesCounter);
       connection->InvalidSharesCounter = 0;
       connection->TotalSharesCounter = 0;
-      if (connection->InvalidShares.size() > Connection::SSWindowSize)
-        connection->InvalidShares.pop_front();
     }
 
     xmstream stream;
@@ -711,14 +911,14 @@ private:
       uint32_t invalidSharedPercent = 0;
       if (connection->InvalidShares.size() >= 3) {
         uint32_t invalidShares = 0;
-        for (auto v: connection->InvalidShares)
-          invalidShares += v;
+        for (size_t i = 0, ie = connection->InvalidShares.size(); i != ie; ++i)
+          invalidShares += connection->InvalidShares[i];
         invalidSharedPercent = invalidShares * 100 / (connection->InvalidShares.size()*Connection::SSWindowElementSize);
       }
 
       if (invalidSharedPercent >= 20) {
         if (isDebugInstanceStratumConnections())
-          LOG_F(1, "%s: connection %s: too much errors, disconnecting...", Name_.c_str(), connection->AddressHr.c_str());
+          trace(ETraceStratumConnections, Name_.c_str(), connection->Address.ipv4, connection->Address.port, traceUser(connection), "too much errors, disconnecting", {});
         connection->close();
         return;
       }
@@ -732,7 +932,7 @@ private:
         if (work) {
           work->mutate();
           connection->ResendCount++;
-          stratumSendWork(connection, work, time(nullptr));
+          stratumSendWork(connection, work, time(nullptr), true);
         }
       }
     }
@@ -771,16 +971,46 @@ private:
     send(connection, stream);
   }
 
-  void stratumSendWork(Connection *connection, CWork *work, int64_t currentTime) {
+  // Work notification not sent yet is superseded by newer one and removed from queue
+  // (kept if it resets previous work and newer one not)
+  void stratumSendWork(Connection *connection, CWork *work, int64_t currentTime, bool resetPreviousWork = false) {
     connection->LastUpdateTime = currentTime;
-    send(connection, work->notifyMessage());
+    if (connection->QueuedNotifySize && (!connection->QueuedNotifyReset || resetPreviousWork)) {
+      connection->OutputQueue.erase(connection->QueuedNotifyOffset, connection->QueuedNotifySize);
+      Data_[connection->WorkerId].updateOutputQueueSize(-static_cast<int64_t>(connection->QueuedNotifySize));
+      connection->QueuedNotifySize = 0;
+      NotifyDropped_->add();
+    }
+
+    size_t offset = connection->OutputQueue.size();
+    if (!enqueue(connection, work->notifyMessage()))
+      return;
+    connection->QueuedNotifyOffset = offset;
+    connection->QueuedNotifySize = connection->OutputQueue.size() - offset;
+    connection->QueuedNotifyReset = resetPreviousWork;
+    if (!connection->DeferFlush)
+      flush(connection);
   }
 
   void newFrontendConnection(socketTy fd, HostAddress address) {
     // Functions runs inside 'monitor' thread
-    // Send task to one of worker threads
-    ThreadPool_.startAsyncTask(CurrentThreadId_, new AcceptNewConnection(*this, fd, address));
-    CurrentThreadId_ = (CurrentThreadId_ + 1) % ThreadPool_.threadsNum();
+    // Send task to least loaded worker thread, round-robin for equally loaded
+    unsigned threadsNum = ThreadPool_.threadsNum();
+    unsigned workerId = CurrentThreadId_;
+    unsigned minConnections = Data_[workerId].ConnectionsNum;
+    for (unsigned i = 1; i < threadsNum; i++) {
+      unsigned id = (CurrentThreadId_ + i) % threadsNum;
+      unsigned connections = Data_[id].ConnectionsNum;
+      if (connections < minConnections) {
+        workerId = id;
+        minConnections = connections;
+      }
+    }
+
+    Data_[workerId].ConnectionsNum++;
+    AcceptedNum_++;
+    ThreadPool_.startAsyncTask(workerId, new AcceptNewConnection(*this, fd, address));
+    CurrentThreadId_ = (workerId + 1) % threadsNum;
   }
 
   static void readCb(AsyncOpStatus status, aioObject*, size_t size, Connection *connection) {
@@ -798,15 +1028,15 @@ private:
     const char *nextMsgPos;
     const char *p = connection->Buffer;
     const char *e = connection->Buffer + connection->MsgTailSize + size;
+    // Responses to all received messages coalesced into one write
+    connection->DeferFlush = true;
     while (p != e && (nextMsgPos = static_cast<const char*>(memchr(p, '\n', e - p)))) {
       // parse stratum message
       bool result = true;
       typename X::Stratum::StratumMessage msg;
       size_t stratumMsgSize = nextMsgPos - p;
-      if (isDebugInstanceStratumMessages()) {
-        std::string msg(p, stratumMsgSize);
-        LOG_F(1, "%s(%s): incoming message %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), msg.c_str());
-      }
+      if (isDebugInstanceStratumMessages())
+        trace(ETraceStratumMessages, connection->Instance->Name_.c_str(), connection->Address.ipv4, connection->Address.port, connection->Instance->traceUser(connection), "incoming message", {std::string_view(p, stratumMsgSize)});
 
       switch (msg.decodeStratumMessage(p, stratumMsgSize)) {
         case EStratumDecodeStatusTy::EStratumStatusOk :
@@ -856,13 +1086,13 @@ private:
           break;
         case EStratumDecodeStatusTy::EStratumStatusJsonError : {
           std::string msg(p, stratumMsgSize);
-          LOG_F(ERROR, "%s(%s): JsonError %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), msg.c_str());
+          LOG_F(ERROR, "%s(%s): JsonError %s", connection->Instance->Name_.c_str(), connection->AddressHr, msg.c_str());
           result = false;
           break;
         }
         case EStratumDecodeStatusTy::EStratumStatusFormatError : {
           std::string msg(p, stratumMsgSize);
-          LOG_F(ERROR, "%s(%s): FormatError %s", connection->Instance->Name_.c_str(), connection->AddressHr.c_str(), msg.c_str());
+          LOG_F(ERROR, "%s(%s): FormatError %s", connection->Instance->Name_.c_str(), connection->AddressHr, msg.c_str());
           result = false;
           break;
         }
@@ -878,24 +1108,48 @@ private:
       p = nextMsgPos + 1;
     }
 
+    connection->DeferFlush = false;
+    connection->Instance->flush(connection);
+
     // move tail to begin of buffer
     if (p != e) {
       connection->MsgTailSize = e-p;
-      if (connection->MsgTailSize >= sizeof(connection->Buffer)) {
-        struct in_addr addr;
-        addr.s_addr = connection->Address.ipv4;
-        LOG_F(ERROR, "%s: too long stratum message from %s", connection->Instance->Name_.c_str(), inet_ntoa(addr));
-        connection->close();
-        return;
-      }
+      if (connection->MsgTailSize >= connection->BufferSize) {
+        if (connection->Buffer != connection->InlineBuffer) {
+          struct in_addr addr;
+          addr.s_addr = connection->Address.ipv4;
+          LOG_F(ERROR, "%s: too long stratum message from %s", connection->Instance->Name_.c_str(), inet_ntoa(addr));
+          connection->close();
+          return;
+        }
 
-      memmove(connection->Buffer, p, e-p);
+        // Inline buffer is full, switch to large buffer
+        connection->Buffer = data.LargeBufferPool.acquire();
+        connection->BufferSize = LargeBufferSize;
+        memcpy(connection->Buffer, p, e-p);
+        data.updateMemoryUsage();
+      } else if (connection->Buffer != connection->InlineBuffer && connection->MsgTailSize < InlineBufferSize) {
+        // Long message processed, return to inline buffer
+        memcpy(connection->InlineBuffer, p, e-p);
+        data.LargeBufferPool.release(connection->Buffer);
+        connection->Buffer = connection->InlineBuffer;
+        connection->BufferSize = InlineBufferSize;
+        data.updateMemoryUsage();
+      } else {
+        memmove(connection->Buffer, p, e-p);
+      }
     } else {
       connection->MsgTailSize = 0;
+      if (connection->Buffer != connection->InlineBuffer) {
+        data.LargeBufferPool.release(connection->Buffer);
+        connection->Buffer = connection->InlineBuffer;
+        connection->BufferSize = InlineBufferSize;
+        data.updateMemoryUsage();
+      }
     }
 
     if (connection->Active)
-      aioRead(connection->Socket, connection->Buffer + connection->MsgTailSize, sizeof(connection->Buffer) - connection->MsgTailSize, afNone, 0, reinterpret_cast<aioCb*>(readCb), connection);
+      aioRead(connection->Socket, connection->Buffer + connection->MsgTailSize, connection->BufferSize - connection->MsgTailSize, afNone, 0, reinterpret_cast<aioCb*>(readCb), connection);
   }
 
   std::string workName(CWork *work) {
@@ -914,6 +1168,7 @@ private:
 private:
   unsigned CurrentThreadId_;
   std::unique_ptr<ThreadData[]> Data_;
+  std::atomic<uint64_t> AcceptedNum_ = 0;
   std::string Name_ = "stratum";
   typename X::Stratum::MiningConfig MiningCfg_;
   double ConstantShareDiff_;
@@ -923,4 +1178,14 @@ private:
 
   // ASIC boost 'overt' data
   uint32_t VersionMask_ = 0x1FFFE000;
+
+  // Metrics
+  CMetricHistogram *NotifyTime_ = nullptr;
+  CMetricHistogram *BroadcastTime_ = nullptr;
+  CMetricHistogram *SubmitTime_ = nullptr;
+  CMetricCounter *SharesAccepted_ = nullptr;
+  CMetricCounter *SharesRejected_ = nullptr;
+  CMetricCounter *NotifyDropped_ = nullptr;
+  CMetricCounter *OutputOverflows_ = nullptr;
+  uint64_t MetricsCollector_ = 0;
 };
@@ -248,6 +248,13 @@ private:
     double shareWork = 0.0;
     uint32_t primePOWTarget = 0;
 
+    // reject share without primality tests if all chain types have small divisors
+    unsigned divisibleTypes = work.divisibleChainTypes(data.CheckConsensusCtx, MiningCfg_.MinShareLength, connection->WorkerConfig);
+    if (work.allChainTypesDivisible(divisibleTypes)) {
+      rep.set_error(pool::proto::Reply::INVALID);
+      return;
+    }
+
     typename X::Zmq::Work::CExtraInfo info;
     bool isBlock = work.checkConsensus(data.CheckConsensusCtx, &shareDiff, &info);
     if (shareDiff < MiningCfg_.MinShareLength) {
@@ -256,7 +263,7 @@ private:
     }
 
     primePOWTarget = std::max(work.primePOWTarget(), MiningCfg_.MinShareLength);
-    shareWork = work.shareWork(data.CheckConsensusCtx, shareDiff, MiningCfg_.MinShareLength, info, connection->WorkerConfig);
+    shareWork = work.shareWork(data.CheckConsensusCtx, MiningCfg_.MinShareLength, info, divisibleTypes, connection->WorkerConfig);
     if (shareWork == 0.0) {
       rep.set_error(pool::proto::Reply::INVALID);
       return;
@@ -0,0 +1,28 @@
+#include "poolcommon/crc32.h"
+
+namespace {
+
+struct CCrc32cTable {
+  uint32_t Data[256];
+  CCrc32cTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (unsigned j = 0; j < 8; j++)
+        crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+      Data[i] = crc;
+    }
+  }
+};
+
+static const CCrc32cTable gCrc32cTable;
+
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t size)
+{
+  const uint8_t *p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++)
+    crc = gCrc32cTable.Data[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
@@ -8,6 +8,7 @@
 #ifndef _WIN32 // POSIX implementation
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -112,6 +113,37 @@ int FileDescriptor::fd()
   return Fd_;
 }
 
+bool MappedFile::open(const std::filesystem::path &path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  Data_ = data;
+  Size_ = st.st_size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (Data_)
+    munmap(Data_, Size_);
+  Data_ = nullptr;
+  Size_ = 0;
+}
+
 #else // Win32 implementation
 
 #include <Windows.h>
@@ -250,4 +282,45 @@ int FileDescriptor::fd()
 {
   return static_cast<int>(reinterpret_cast<intptr_t>(Fd_));
 }
+
+bool MappedFile::open(const std::filesystem::path &path)
+{
+  close();
+  HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping)
+    return false;
+
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    CloseHandle(mapping);
+    return false;
+  }
+
+  Mapping_ = mapping;
+  Data_ = data;
+  Size_ = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (Data_)
+    UnmapViewOfFile(Data_);
+  if (Mapping_)
+    CloseHandle(Mapping_);
+  Mapping_ = nullptr;
+  Data_ = nullptr;
+  Size_ = 0;
+}
 #endif
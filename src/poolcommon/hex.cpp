@@ -0,0 +1,234 @@
+#include "poolcommon/hex.h"
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HEX_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct CHexImplementation {
+  void (*Encode)(const uint8_t *in, char *out, size_t size, bool upperCase);
+  bool (*Decode)(const char *in, size_t size, uint8_t *out);
+  const char *Description;
+};
+
+static const char HexDigitsLower[] = "0123456789abcdef";
+static const char HexDigitsUpper[] = "0123456789ABCDEF";
+
+// Inputs shorter than this converted by scalar code without dispatch
+static constexpr size_t SimdMinSize = 16;
+
+// Nibble value of character, -1 for non-hex characters
+struct CHexDecodeTable {
+  int8_t Data[256];
+  constexpr CHexDecodeTable() : Data() {
+    for (unsigned i = 0; i < 256; i++)
+      Data[i] = -1;
+    for (unsigned i = 0; i < 10; i++)
+      Data['0' + i] = i;
+    for (unsigned i = 0; i < 6; i++) {
+      Data['a' + i] = 10 + i;
+      Data['A' + i] = 10 + i;
+    }
+  }
+};
+
+static constexpr CHexDecodeTable HexDecodeTable;
+
+static void hexEncodeScalar(const uint8_t *in, char *out, size_t size, bool upperCase)
+{
+  const char *digits = upperCase ? HexDigitsUpper : HexDigitsLower;
+  for (size_t i = 0; i < size; i++) {
+    out[i*2] = digits[in[i] >> 4];
+    out[i*2+1] = digits[in[i] & 0xF];
+  }
+}
+
+// size is number of output bytes
+static bool hexDecodeScalar(const char *in, size_t size, uint8_t *out)
+{
+  int invalid = 0;
+  for (size_t i = 0; i < size; i++) {
+    int hi = HexDecodeTable.Data[static_cast<uint8_t>(in[i*2])];
+    int lo = HexDecodeTable.Data[static_cast<uint8_t>(in[i*2+1])];
+    invalid |= hi | lo;
+    out[i] = static_cast<uint8_t>((hi << 4) | (lo & 0xF));
+  }
+
+  return invalid >= 0;
+}
+
+#ifdef HEX_X86
+
+// Encoding: nibbles of each byte converted to characters by byte shuffle with 16-entry table and interleaved
+// Decoding: range checks of '0'-'9' and 'a'-'f' (letters folded to lower case), valid nibble pairs joined by
+// multiply-add of adjacent bytes (hi*16 + lo) and packed to bytes
+
+// Block helpers inlined into AVX2 functions too: AVX2 code handles 16-byte tail with VEX encoded instructions
+// instead of calling legacy SSE code (SSE/AVX transition penalty)
+
+__attribute__((target("ssse3"), always_inline))
+static inline void hexEncodeBlock16(const uint8_t *in, char *out, __m128i table)
+{
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  __m128i hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(data, 4), mask));
+  __m128i lo = _mm_shuffle_epi8(table, _mm_and_si128(data, mask));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(hi, lo));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+// Returns nibble values of 16 characters, sets bits of invalid characters in 'invalid'
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i hexNibbles16(__m128i chars, __m128i &invalid)
+{
+  __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+  __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  invalid = _mm_or_si128(invalid, _mm_andnot_si128(_mm_or_si128(isDigit, isLetter), _mm_set1_epi8(-1)));
+  __m128i digit = _mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0')));
+  __m128i letter = _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+  return _mm_or_si128(digit, letter);
+}
+
+// Decodes 32 characters to 16 bytes
+__attribute__((target("ssse3"), always_inline))
+static inline void hexDecodeBlock16(const char *in, uint8_t *out, __m128i &invalid)
+{
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  __m128i a = hexNibbles16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), invalid);
+  __m128i b = hexNibbles16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16)), invalid);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(_mm_maddubs_epi16(a, weights), _mm_maddubs_epi16(b, weights)));
+}
+
+__attribute__((target("ssse3")))
+static void hexEncodeSSSE3(const uint8_t *in, char *out, size_t size, bool upperCase)
+{
+  const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upperCase ? HexDigitsUpper : HexDigitsLower));
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16)
+    hexEncodeBlock16(in + i, out + i*2, table);
+  hexEncodeScalar(in + i, out + i*2, size - i, upperCase);
+}
+
+__attribute__((target("ssse3")))
+static bool hexDecodeSSSE3(const char *in, size_t size, uint8_t *out)
+{
+  __m128i invalid = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16)
+    hexDecodeBlock16(in + i*2, out + i, invalid);
+  bool tailValid = hexDecodeScalar(in + i*2, size - i, out + i);
+  return tailValid && _mm_movemask_epi8(invalid) == 0;
+}
+
+__attribute__((target("avx2")))
+static void hexEncodeAVX2(const uint8_t *in, char *out, size_t size, bool upperCase)
+{
+  const __m128i table128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upperCase ? HexDigitsUpper : HexDigitsLower));
+  const __m256i table = _mm256_broadcastsi128_si256(table128);
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(data, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(data, mask));
+    // Unpack works inside 128-bit lanes: first result holds bytes 0-7 and 16-23, second 8-15 and 24-31
+    __m256i first = _mm256_unpacklo_epi8(hi, lo);
+    __m256i second = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i*2), _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i*2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+  }
+
+  if (i + 16 <= size) {
+    hexEncodeBlock16(in + i, out + i*2, table128);
+    i += 16;
+  }
+
+  hexEncodeScalar(in + i, out + i*2, size - i, upperCase);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hexNibbles32(__m256i chars, __m256i &invalid)
+{
+  __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+  __m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+  invalid = _mm256_or_si256(invalid, _mm256_andnot_si256(_mm256_or_si256(isDigit, isLetter), _mm256_set1_epi8(-1)));
+  __m256i digit = _mm256_and_si256(isDigit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0')));
+  __m256i letter = _mm256_and_si256(isLetter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)));
+  return _mm256_or_si256(digit, letter);
+}
+
+__attribute__((target("avx2")))
+static bool hexDecodeAVX2(const char *in, size_t size, uint8_t *out)
+{
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  __m256i invalid = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i a = hexNibbles32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i*2)), invalid);
+    __m256i b = hexNibbles32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i*2 + 32)), invalid);
+    // Pack works inside 128-bit lanes, restore order of 64-bit quarters
+    __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(a, weights), _mm256_maddubs_epi16(b, weights));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(bytes, 0xD8));
+  }
+
+  __m128i invalid128 = _mm_or_si128(_mm256_castsi256_si128(invalid), _mm256_extracti128_si256(invalid, 1));
+  if (i + 16 <= size) {
+    hexDecodeBlock16(in + i*2, out + i, invalid128);
+    i += 16;
+  }
+
+  bool tailValid = hexDecodeScalar(in + i*2, size - i, out + i);
+  return tailValid && _mm_movemask_epi8(invalid128) == 0;
+}
+
+#endif
+
+static CHexImplementation selectImplementation()
+{
+  CHexImplementation implementation = {hexEncodeScalar, hexDecodeScalar, "scalar"};
+#ifdef HEX_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    implementation = {hexEncodeAVX2, hexDecodeAVX2, "avx2"};
+  else if (__builtin_cpu_supports("ssse3"))
+    implementation = {hexEncodeSSSE3, hexDecodeSSSE3, "ssse3"};
+#endif
+  return implementation;
+}
+
+static const CHexImplementation &implementation()
+{
+  static const CHexImplementation instance = selectImplementation();
+  return instance;
+}
+
+}
+
+void hexEncode(const void *in, char *out, size_t size, bool upperCase)
+{
+  const uint8_t *data = static_cast<const uint8_t*>(in);
+  if (size < SimdMinSize)
+    hexEncodeScalar(data, out, size, upperCase);
+  else
+    implementation().Encode(data, out, size, upperCase);
+}
+
+bool hexDecode(const char *in, size_t inSize, void *out)
+{
+  uint8_t *data = static_cast<uint8_t*>(out);
+  size_t size = inSize / 2;
+  bool valid = size < SimdMinSize ?
+    hexDecodeScalar(in, size, data) :
+    implementation().Decode(in, size, data);
+  return valid && (inSize % 2) == 0;
+}
+
+const char *hexImplementation()
+{
+  return implementation().Description;
+}
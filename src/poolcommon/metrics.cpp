@@ -0,0 +1,294 @@
+#include "poolcommon/metrics.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+enum EMetricType {
+  EMetricCounter = 0,
+  EMetricGauge,
+  EMetricHistogram
+};
+
+struct CMetricFamily {
+  std::string Help;
+  EMetricType Type;
+  std::map<std::string, std::unique_ptr<CMetricCounter>> Counters;
+  std::map<std::string, std::unique_ptr<CMetricGauge>> Gauges;
+  std::map<std::string, std::unique_ptr<CMetricHistogram>> Histograms;
+};
+
+struct CMetricsRegistry {
+  std::mutex Mutex;
+  std::map<std::string, CMetricFamily> Families;
+  std::map<uint64_t, std::function<void(CMetricsWriter&)>> Collectors;
+  uint64_t NextCollectorHandle = 1;
+};
+
+// Upper bounds of exported histogram buckets (seconds)
+static const double HistogramBounds[] = {
+  0.000001, 0.000005, 0.00001, 0.00005, 0.0001, 0.00025, 0.0005,
+  0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+  1, 2.5, 5, 10, 30, 60
+};
+
+static std::atomic<unsigned> NextThreadSlot = 0;
+
+static CMetricsRegistry &registry()
+{
+  static CMetricsRegistry instance;
+  return instance;
+}
+
+static CMetricFamily &family(CMetricsRegistry &registry, const char *name, const char *help, EMetricType type)
+{
+  auto It = registry.Families.find(name);
+  if (It == registry.Families.end()) {
+    It = registry.Families.emplace(name, CMetricFamily()).first;
+    It->second.Help = help;
+    It->second.Type = type;
+  }
+
+  return It->second;
+}
+
+static void appendValue(std::string &out, const std::string &name, const char *suffix, const std::string &labels, const char *extraLabel, double value)
+{
+  char buffer[64];
+  out.append(name);
+  out.append(suffix);
+  if (!labels.empty() || extraLabel) {
+    out.push_back('{');
+    out.append(labels);
+    if (extraLabel) {
+      if (!labels.empty())
+        out.push_back(',');
+      out.append(extraLabel);
+    }
+    out.push_back('}');
+  }
+
+  snprintf(buffer, sizeof(buffer), " %.17g\n", value);
+  out.append(buffer);
+}
+
+static void appendHeader(std::string &out, const std::string &name, const std::string &help, const char *type)
+{
+  out.append("# HELP ");
+  out.append(name);
+  out.push_back(' ');
+  out.append(help);
+  out.append("\n# TYPE ");
+  out.append(name);
+  out.push_back(' ');
+  out.append(type);
+  out.push_back('\n');
+}
+
+static void appendHistogram(std::string &out, const std::string &name, const std::string &labels, const CMetricHistogram &histogram)
+{
+  std::unique_ptr<CMetricHistogram::Snapshot> snapshot(new CMetricHistogram::Snapshot);
+  histogram.snapshot(*snapshot);
+
+  // Fine bucket goes to first exported bucket which contains its upper bound
+  uint64_t cumulative = 0;
+  unsigned index = 0;
+  for (double bound: HistogramBounds) {
+    uint64_t boundNs = static_cast<uint64_t>(bound * 1000000000.0);
+    while (index < CMetricHistogram::BucketsNum - 1 && CMetricHistogram::bucketLowerBound(index + 1) <= boundNs)
+      cumulative += snapshot->Buckets[index++];
+
+    char le[32];
+    snprintf(le, sizeof(le), "le=\"%g\"", bound);
+    appendValue(out, name, "_bucket", labels, le, static_cast<double>(cumulative));
+  }
+
+  appendValue(out, name, "_bucket", labels, "le=\"+Inf\"", static_cast<double>(snapshot->Count));
+  appendValue(out, name, "_sum", labels, nullptr, snapshot->Sum / 1000000000.0);
+  appendValue(out, name, "_count", labels, nullptr, static_cast<double>(snapshot->Count));
+}
+
+}
+
+unsigned metricsAllocateThreadSlot()
+{
+  unsigned slot = NextThreadSlot.fetch_add(1);
+  return slot < MetricsMaxThreads ? slot : MetricsMaxThreads - 1;
+}
+
+uint64_t CMetricCounter::value() const
+{
+  uint64_t result = 0;
+  for (const auto &shard: Shards_)
+    result += shard.Value.load(std::memory_order_relaxed);
+  return result;
+}
+
+CMetricHistogram::~CMetricHistogram()
+{
+  for (auto &shard: Shards_)
+    delete shard.load();
+}
+
+CMetricHistogram::Shard *CMetricHistogram::allocateShard(unsigned slot)
+{
+  Shard *shard = new Shard;
+  for (auto &bucket: shard->Buckets)
+    bucket = 0;
+  shard->Count = 0;
+  shard->Sum = 0;
+
+  // Shared slot can be allocated by several threads at once
+  Shard *expected = nullptr;
+  if (!Shards_[slot].compare_exchange_strong(expected, shard)) {
+    delete shard;
+    return expected;
+  }
+
+  return shard;
+}
+
+void CMetricHistogram::snapshot(Snapshot &result) const
+{
+  memset(&result, 0, sizeof(result));
+  for (const auto &shardPtr: Shards_) {
+    const Shard *shard = shardPtr.load(std::memory_order_acquire);
+    if (!shard)
+      continue;
+    for (unsigned i = 0; i < BucketsNum; i++)
+      result.Buckets[i] += shard->Buckets[i].load(std::memory_order_relaxed);
+    result.Count += shard->Count.load(std::memory_order_relaxed);
+    result.Sum += shard->Sum.load(std::memory_order_relaxed);
+  }
+}
+
+std::string &CMetricsWriter::family(const char *name, const char *help, const char *type)
+{
+  auto It = Families_.find(name);
+  if (It == Families_.end()) {
+    It = Families_.emplace(name, std::string()).first;
+    appendHeader(It->second, name, help, type);
+  }
+
+  return It->second;
+}
+
+void CMetricsWriter::gauge(const char *name, const char *help, const std::string &labels, double value)
+{
+  appendValue(family(name, help, "gauge"), name, "", labels, nullptr, value);
+}
+
+void CMetricsWriter::counter(const char *name, const char *help, const std::string &labels, uint64_t value)
+{
+  appendValue(family(name, help, "counter"), name, "", labels, nullptr, static_cast<double>(value));
+}
+
+void CMetricsWriter::write(std::string &out)
+{
+  for (const auto &family: Families_)
+    out.append(family.second);
+}
+
+std::string metricLabel(const char *name, const std::string &value)
+{
+  std::string result = name;
+  result.append("=\"");
+  for (char c: value) {
+    if (c == '\\' || c == '"') {
+      result.push_back('\\');
+      result.push_back(c);
+    } else if (c == '\n') {
+      result.append("\\n");
+    } else {
+      result.push_back(c);
+    }
+  }
+  result.push_back('"');
+  return result;
+}
+
+std::string metricLabels(const char *name1, const std::string &value1, const char *name2, const std::string &value2)
+{
+  return metricLabel(name1, value1) + "," + metricLabel(name2, value2);
+}
+
+CMetricCounter &metricCounter(const char *name, const char *help, const std::string &labels)
+{
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  auto &metric = family(instance, name, help, EMetricCounter).Counters[labels];
+  if (!metric)
+    metric.reset(new CMetricCounter);
+  return *metric;
+}
+
+CMetricGauge &metricGauge(const char *name, const char *help, const std::string &labels)
+{
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  auto &metric = family(instance, name, help, EMetricGauge).Gauges[labels];
+  if (!metric)
+    metric.reset(new CMetricGauge);
+  return *metric;
+}
+
+CMetricHistogram &metricHistogram(const char *name, const char *help, const std::string &labels)
+{
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  auto &metric = family(instance, name, help, EMetricHistogram).Histograms[labels];
+  if (!metric)
+    metric.reset(new CMetricHistogram);
+  return *metric;
+}
+
+uint64_t metricsAddCollector(std::function<void(CMetricsWriter&)> collector)
+{
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  uint64_t handle = instance.NextCollectorHandle++;
+  instance.Collectors.emplace(handle, std::move(collector));
+  return handle;
+}
+
+void metricsRemoveCollector(uint64_t handle)
+{
+  // Collectors called on scrape under same lock
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  instance.Collectors.erase(handle);
+}
+
+void metricsScrape(std::string &out)
+{
+  CMetricsRegistry &instance = registry();
+  std::lock_guard lock(instance.Mutex);
+  for (const auto &[name, family]: instance.Families) {
+    switch (family.Type) {
+      case EMetricCounter :
+        appendHeader(out, name, family.Help, "counter");
+        for (const auto &[labels, counter]: family.Counters)
+          appendValue(out, name, "", labels, nullptr, static_cast<double>(counter->value()));
+        break;
+      case EMetricGauge :
+        appendHeader(out, name, family.Help, "gauge");
+        for (const auto &[labels, gauge]: family.Gauges)
+          appendValue(out, name, "", labels, nullptr, static_cast<double>(gauge->value()));
+        break;
+      case EMetricHistogram :
+        appendHeader(out, name, family.Help, "histogram");
+        for (const auto &[labels, histogram]: family.Histograms)
+          appendHistogram(out, name, labels, *histogram);
+        break;
+    }
+  }
+
+  CMetricsWriter writer;
+  for (const auto &[handle, collector]: instance.Collectors)
+    collector(writer);
+  writer.write(out);
+}
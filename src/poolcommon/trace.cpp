@@ -0,0 +1,401 @@
+#include "poolcommon/trace.h"
+#include "loguru.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+std::atomic<uint32_t> gTraceCategories = 0;
+
+namespace {
+
+static const char *CategoryNames[ETraceCategoriesNum] = {
+  "stratum.messages",
+  "stratum.rejects",
+  "stratum.connections",
+  "backend",
+  "accounting",
+  "statistic"
+};
+
+struct CTraceRecordHeader {
+  int64_t Time;
+  const char *Source;
+  const char *Event;
+  uint32_t Address;
+  uint16_t Port;
+  uint16_t Category;
+  uint32_t Size;
+};
+
+static constexpr size_t TraceRecordSize = 256;
+static constexpr size_t TracePayloadSize = TraceRecordSize - sizeof(CTraceRecordHeader);
+
+struct CTraceRecord : CTraceRecordHeader {
+  char Payload[TracePayloadSize];
+};
+
+static_assert(sizeof(CTraceRecord) == TraceRecordSize);
+
+// Single producer (owning thread), single consumer (drain thread)
+class CTraceBuffer {
+public:
+  static constexpr size_t Capacity = 4096;
+
+  CTraceRecord *reserve() {
+    size_t head = Head_.load(std::memory_order_relaxed);
+    if (head - Tail_.load(std::memory_order_acquire) == Capacity) {
+      Dropped_.store(Dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &Records_[head % Capacity];
+  }
+
+  void commit() {
+    Head_.store(Head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    Written_.store(Written_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  template<typename Proc>
+  size_t consume(Proc proc) {
+    size_t tail = Tail_.load(std::memory_order_relaxed);
+    size_t head = Head_.load(std::memory_order_acquire);
+    for (size_t i = tail; i != head; i++)
+      proc(Records_[i % Capacity]);
+    Tail_.store(head, std::memory_order_release);
+    return head - tail;
+  }
+
+  uint64_t written() const { return Written_.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return Dropped_.load(std::memory_order_relaxed); }
+
+private:
+  alignas(64) std::atomic<size_t> Head_ = 0;
+  std::atomic<uint64_t> Written_ = 0;
+  std::atomic<uint64_t> Dropped_ = 0;
+  alignas(64) std::atomic<size_t> Tail_ = 0;
+  std::unique_ptr<CTraceRecord[]> Records_ = std::unique_ptr<CTraceRecord[]>(new CTraceRecord[Capacity]);
+};
+
+class CTracer {
+public:
+  ~CTracer() {
+    if (Thread_.joinable()) {
+      Stop_ = true;
+      Thread_.join();
+    }
+    if (Output_)
+      fclose(Output_);
+  }
+
+  bool initialize(const char *path) {
+    std::lock_guard lock(Mutex_);
+    if (Output_)
+      fclose(Output_);
+    Output_ = fopen(path, "a");
+    return Output_ != nullptr;
+  }
+
+  bool configure(const CTraceSettings &settings, std::string &error) {
+    uint32_t categories = 0;
+    for (const auto &name: settings.Categories) {
+      unsigned i = 0;
+      while (i < ETraceCategoriesNum && name != CategoryNames[i])
+        i++;
+      if (i == ETraceCategoriesNum) {
+        error = "unknown category: " + name;
+        return false;
+      }
+      categories |= 1u << i;
+    }
+
+    uint32_t address = 0;
+    uint16_t port = 0;
+    if (!settings.Connection.empty() && !parseConnection(settings.Connection, address, port)) {
+      error = "invalid connection: " + settings.Connection;
+      return false;
+    }
+
+    std::lock_guard lock(Mutex_);
+    Settings_ = settings;
+    Settings_.SampleRate = std::max(settings.SampleRate, 1u);
+    UserHash_ = !settings.User.empty() ? hash(settings.User) : 0;
+    Address_ = address;
+    Port_ = port;
+    SampleRate_ = Settings_.SampleRate;
+    gTraceCategories = categories;
+
+    if (categories && !Thread_.joinable())
+      Thread_ = std::thread([](CTracer *tracer) { tracer->drainMain(); }, this);
+    LOG_F(INFO, "trace: categories mask 0x%x, user '%s', connection '%s', sample rate %u",
+          categories,
+          settings.User.c_str(),
+          settings.Connection.c_str(),
+          Settings_.SampleRate);
+    return true;
+  }
+
+  void getStatus(CTraceStatus &status) {
+    std::lock_guard lock(Mutex_);
+    status.Settings = Settings_;
+    status.Written = 0;
+    status.Dropped = 0;
+    status.Buffers = static_cast<unsigned>(Buffers_.size());
+    for (const auto &buffer: Buffers_) {
+      status.Written += buffer->written();
+      status.Dropped += buffer->dropped();
+    }
+  }
+
+  CTraceRecord *acquire(ETraceCategory category, const char *source, uint32_t address, uint16_t port, const std::string *user, const char *event) {
+    if (!accept(address, port, user))
+      return nullptr;
+
+    CTraceBuffer *buffer = LocalBuffer_;
+    if (!buffer) {
+      std::lock_guard lock(Mutex_);
+      Buffers_.emplace_back(new CTraceBuffer);
+      buffer = LocalBuffer_ = Buffers_.back().get();
+    }
+
+    CTraceRecord *record = buffer->reserve();
+    if (record) {
+      record->Time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+      record->Source = source;
+      record->Event = event;
+      record->Address = address;
+      record->Port = port;
+      record->Category = category;
+      record->Size = 0;
+    }
+
+    return record;
+  }
+
+  void commit() { LocalBuffer_->commit(); }
+
+private:
+  static uint64_t hash(std::string_view data) {
+    // FNV-1a
+    uint64_t result = 14695981039346656037ULL;
+    for (char c: data) {
+      result ^= static_cast<uint8_t>(c);
+      result *= 1099511628211ULL;
+    }
+    return result;
+  }
+
+  static bool parseConnection(const std::string &text, uint32_t &address, uint16_t &port) {
+    unsigned bytes[4];
+    unsigned hostPort = 0;
+    char tail;
+    int fields = sscanf(text.c_str(), "%u.%u.%u.%u:%u%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &hostPort, &tail);
+    if (fields != 4 && fields != 5)
+      return false;
+    if (bytes[0] > 255 || bytes[1] > 255 || bytes[2] > 255 || bytes[3] > 255 || hostPort > 65535)
+      return false;
+
+    // Network byte order
+    uint8_t *a = reinterpret_cast<uint8_t*>(&address);
+    for (unsigned i = 0; i < 4; i++)
+      a[i] = static_cast<uint8_t>(bytes[i]);
+    uint8_t *p = reinterpret_cast<uint8_t*>(&port);
+    p[0] = static_cast<uint8_t>(hostPort >> 8);
+    p[1] = static_cast<uint8_t>(hostPort);
+    return true;
+  }
+
+  bool accept(uint32_t address, uint16_t port, const std::string *user) {
+    uint64_t userHash = UserHash_.load(std::memory_order_relaxed);
+    if (userHash && (!user || hash(*user) != userHash))
+      return false;
+
+    uint32_t filterAddress = Address_.load(std::memory_order_relaxed);
+    uint16_t filterPort = Port_.load(std::memory_order_relaxed);
+    if (filterAddress && (address != filterAddress || (filterPort && port != filterPort)))
+      return false;
+
+    uint32_t sampleRate = SampleRate_.load(std::memory_order_relaxed);
+    if (sampleRate > 1) {
+      if (address || port) {
+        // Same decision for all records of connection
+        uint32_t h = (address ^ (port * 0x9E3779B1u)) * 0x85EBCA6Bu;
+        h ^= h >> 16;
+        return h % sampleRate == 0;
+      } else {
+        return ++LocalCounter_ % sampleRate == 0;
+      }
+    }
+
+    return true;
+  }
+
+  // Called with Mutex_ locked
+  void print(const CTraceRecord &record) {
+    time_t seconds = record.Time / 1000000;
+    unsigned usec = static_cast<unsigned>(record.Time % 1000000);
+    char timeHr[32];
+    tm *utc = gmtime(&seconds);
+    strftime(timeHr, sizeof(timeHr), "%Y-%m-%d %H:%M:%S", utc);
+
+    char connection[32] = "";
+    if (record.Address || record.Port) {
+      const uint8_t *a = reinterpret_cast<const uint8_t*>(&record.Address);
+      const uint8_t *p = reinterpret_cast<const uint8_t*>(&record.Port);
+      snprintf(connection, sizeof(connection), "(%u.%u.%u.%u:%u)", a[0], a[1], a[2], a[3], (p[0] << 8) | p[1]);
+    }
+
+    // Stratum messages are stored with line terminator
+    size_t size = record.Size;
+    while (size && (record.Payload[size-1] == '\n' || record.Payload[size-1] == '\r'))
+      size--;
+
+    if (Output_) {
+      fprintf(Output_,
+              "%s.%06u %s %s%s %s %.*s\n",
+              timeHr,
+              usec,
+              CategoryNames[record.Category],
+              record.Source,
+              connection,
+              record.Event,
+              static_cast<int>(size),
+              record.Payload);
+    } else {
+      LOG_F(INFO,
+            "trace %s.%06u %s %s%s %s %.*s",
+            timeHr,
+            usec,
+            CategoryNames[record.Category],
+            record.Source,
+            connection,
+            record.Event,
+            static_cast<int>(size),
+            record.Payload);
+    }
+  }
+
+  void drainMain() {
+    while (!Stop_) {
+      // Lock held while printing: initialize can close and replace Output_
+      size_t drained = 0;
+      {
+        std::lock_guard lock(Mutex_);
+        for (const auto &buffer: Buffers_)
+          drained += buffer->consume([this](const CTraceRecord &record) { print(record); });
+        if (drained && Output_)
+          fflush(Output_);
+      }
+
+      if (!drained)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  }
+
+private:
+  std::mutex Mutex_;
+  std::vector<std::unique_ptr<CTraceBuffer>> Buffers_;
+  CTraceSettings Settings_;
+  FILE *Output_ = nullptr;
+  std::thread Thread_;
+  std::atomic<bool> Stop_ = false;
+
+  // Filters, read by writer threads without lock
+  std::atomic<uint64_t> UserHash_ = 0;
+  std::atomic<uint32_t> Address_ = 0;
+  std::atomic<uint16_t> Port_ = 0;
+  std::atomic<uint32_t> SampleRate_ = 1;
+
+  static thread_local CTraceBuffer *LocalBuffer_;
+  static thread_local uint32_t LocalCounter_;
+};
+
+thread_local CTraceBuffer *CTracer::LocalBuffer_ = nullptr;
+thread_local uint32_t CTracer::LocalCounter_ = 0;
+
+static CTracer &tracer()
+{
+  static CTracer instance;
+  return instance;
+}
+
+static void appendPayload(CTraceRecord *record, std::string_view data)
+{
+  size_t size = std::min(data.size(), TracePayloadSize - record->Size);
+  memcpy(record->Payload + record->Size, data.data(), size);
+  record->Size += static_cast<uint32_t>(size);
+}
+
+}
+
+const char *traceCategoryName(ETraceCategory category)
+{
+  return category < ETraceCategoriesNum ? CategoryNames[category] : "unknown";
+}
+
+bool traceInitialize(const char *path)
+{
+  return tracer().initialize(path);
+}
+
+bool traceConfigure(const CTraceSettings &settings, std::string &error)
+{
+  return tracer().configure(settings, error);
+}
+
+void traceGetStatus(CTraceStatus &status)
+{
+  tracer().getStatus(status);
+}
+
+void trace(ETraceCategory category,
+           const char *source,
+           uint32_t address,
+           uint16_t port,
+           const std::string *user,
+           const char *event,
+           std::initializer_list<std::string_view> fields)
+{
+  CTracer &instance = tracer();
+  CTraceRecord *record = instance.acquire(category, source, address, port, user, event);
+  if (!record)
+    return;
+
+  bool first = true;
+  for (const auto &field: fields) {
+    if (!first)
+      appendPayload(record, " ");
+    appendPayload(record, field);
+    first = false;
+  }
+
+  instance.commit();
+}
+
+void traceFormat(ETraceCategory category,
+                 const char *source,
+                 uint32_t address,
+                 uint16_t port,
+                 const std::string *user,
+                 const char *event,
+                 const char *format, ...)
+{
+  CTracer &instance = tracer();
+  CTraceRecord *record = instance.acquire(category, source, address, port, user, event);
+  if (!record)
+    return;
+
+  va_list args;
+  va_start(args, format);
+  int size = vsnprintf(record->Payload, TracePayloadSize, format, args);
+  va_end(args);
+  record->Size = size > 0 ? std::min(static_cast<uint32_t>(size), static_cast<uint32_t>(TracePayloadSize - 1)) : 0;
+
+  instance.commit();
+}
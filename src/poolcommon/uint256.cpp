@@ -4,7 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "poolcommon/uint256.h"
+#include "poolcommon/hex.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <string.h>
 
@@ -81,6 +83,15 @@ void base_blob<BITS>::SetHex(const char* psz)
     const char* pbegin = psz;
     while (::HexDigit(*psz) != -1)
         psz++;
+
+    // Common case: whole bytes, decode and reverse to little endian
+    size_t digitsNum = psz - pbegin;
+    if (digitsNum % 2 == 0 && digitsNum <= static_cast<size_t>(2*WIDTH)) {
+        hexDecode(pbegin, digitsNum, data);
+        std::reverse(data, data + digitsNum/2);
+        return;
+    }
+
     psz--;
     unsigned char* p1 = static_cast<unsigned char*>(data);
     unsigned char* pend = p1 + WIDTH;
@@ -3,6 +3,7 @@
 #include "poolcommon/mergeSorted.h"
 #include "poolcommon/utils.h"
 #include "poolcore/base58.h"
+#include "poolcore/poolInstance.h"
 #include "poolcore/statistics.h"
 #include "loguru.hpp"
 #include <stdarg.h>
@@ -69,6 +70,7 @@ bool AccountingDb::parseAccoutingStorageFile(CAccountingFile &file)
   LastBlockTime_ = 0;
   RecentStats_.clear();
   CurrentScores_.clear();
+  CurrentRoundWork_ = 0.0;
 
   FileDescriptor fd;
   if (!fd.open(file.Path.u8string().c_str())) {
@@ -131,12 +133,15 @@ bool AccountingDb::parseAccoutingStorageFile(CAccountingFile &file)
     LastBlockTime_ = fileData.LastBlockTime;
     RecentStats_ = std::move(fileData.Recent);
     CurrentScores_ = std::move(fileData.CurrentScores);
+    for (const auto &score: CurrentScores_)
+      CurrentRoundWork_ += score.second;
     return true;
   } else {
     LastKnownShareId_ = 0;
     LastBlockTime_ = 0;
     RecentStats_.clear();
     CurrentScores_.clear();
+    CurrentRoundWork_ = 0.0;
     LOG_F(ERROR, "AccountingDb: file %s is corrupted", file.Path.generic_string().c_str());
     return false;
   }
@@ -192,6 +197,17 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
   TaskHandler_(this, base)
 {
   FlushTimerEvent_ = newUserEvent(base, 1, nullptr, nullptr);
+  QuerySnapshotEvent_ = newUserEvent(base, 1, nullptr, nullptr);
+  TaskHandler_.setQueueDepthGauge(&metricGauge("pool_task_queue_depth", "Tasks waiting in task handler queue", metricLabels("coin", CoinInfo_.Name, "handler", "accounting")));
+  ConfirmationsLatency_ = &metricHistogram("pool_confirmations_check_seconds", "Block confirmations check cycle time", metricLabel("coin", CoinInfo_.Name));
+  ConfirmationsFailures_ = &metricCounter("pool_confirmations_check_failures_total", "Block confirmations check cycles without enough answered nodes", metricLabel("coin", CoinInfo_.Name));
+  MetricsCollector_ = metricsAddCollector([this](CMetricsWriter &writer) {
+    std::string coinLabel = metricLabel("coin", CoinInfo_.Name);
+    writer.gauge("pool_confirmations_check_max_seconds", "Longest block confirmations check cycle", coinLabel, ConfirmationsStats_.MaxLatency.load() / 1000000.0);
+    writer.gauge("pool_confirmations_responded_nodes", "Nodes answered in last block confirmations check", coinLabel, static_cast<double>(ConfirmationsStats_.LastRespondedNodes.load()));
+  });
+  PayoutFlushTime_ = &metricHistogram("pool_payout_queue_flush_seconds", "Payout journal flush time", metricLabel("coin", CoinInfo_.Name));
+  SnapshotUpdateTime_ = &metricHistogram("pool_query_snapshot_seconds", "Query snapshot build time", metricLabels("coin", CoinInfo_.Name, "db", "accounting"));
 
   int64_t currentTime = time(nullptr);
   FlushInfo_.Time = currentTime;
@@ -217,30 +233,10 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
   }
 
   {
-    unsigned payoutsNum = 0;
-    _payoutsFd.open(_cfg.dbPath / "payouts.raw");
-    if (!_payoutsFd.isOpened())
-      LOG_F(ERROR, "can't open payouts file %s (%s)", (_cfg.dbPath / "payouts.raw").u8string().c_str(), strerror(errno));
-
-    auto fileSize = _payoutsFd.size();
-    if (fileSize > 0) {
-      xmstream stream;
-      _payoutsFd.read(stream.reserve(fileSize), 0, fileSize);
-
-      stream.seekSet(0);
-      while (stream.remaining()) {
-        PayoutDbRecord element;
-        if (!element.deserializeValue(stream))
-          break;
-        _payoutQueue.push_back(element);
-        KnownTransactions_.insert(element.TransactionId);
-        payoutsNum++;
-      }
-    }
-
-    LOG_F(INFO, "loaded %u payouts from payouts.raw file", payoutsNum);
-    if (payoutsNum != _payoutQueue.size())
-      updatePayoutFile();
+    if (!_payoutQueue.open(_cfg.dbPath / "payouts.journal", _cfg.dbPath / "payouts.raw"))
+      LOG_F(ERROR, "can't open payouts journal %s", (_cfg.dbPath / "payouts.journal").u8string().c_str());
+    for (const auto &payout: _payoutQueue)
+      KnownTransactions_.insert(payout.TransactionId);
   }
 
   {
@@ -251,8 +247,10 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
       RawData data = It->value();
       if (R->deserializeValue(data.data, data.size)) {
         _allRounds.emplace_back(R);
-        if (!R->Payouts.empty())
+        if (!R->Payouts.empty()) {
           UnpayedRounds_.insert(R);
+          addQueuedPayouts(R);
+        }
       } else {
         LOG_F(ERROR, "rounds db contains invalid record");
         delete R;
@@ -268,12 +266,46 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
     for (; It->valid(); It->next()) {
       UserBalanceRecord ub;
       RawData data = It->value();
-      if (ub.deserializeValue(data.data, data.size))
+      if (ub.deserializeValue(data.data, data.size)) {
+        TotalBalance_ += ub.Balance.get();
+        TotalRequested_ += ub.Requested;
         _balanceMap[ub.Login] = ub;
+      }
     }
 
     LOG_F(INFO, "loaded %u user balance data from db", (unsigned)_balanceMap.size());
   }
+
+  {
+    // Luck needs work of all blocks, index only recent ones
+    std::unique_ptr<rocksdbBase::IteratorType> It(_foundBlocksDb.iterator());
+    unsigned blocksNum = 0;
+    It->seekFirst();
+    for (; It->valid(); It->next()) {
+      FoundBlockRecord blk;
+      RawData data = It->value();
+      if (blk.deserializeValue(data.data, data.size) && blk.ExpectedWork != 0.0)
+        addLuckPoint(blk.Time, blk.AccumulatedWork, blk.ExpectedWork);
+      blocksNum++;
+    }
+
+    It->seekLast();
+    for (unsigned i = 0; i < _cfg.FoundBlocksIndexSize && It->valid(); i++, It->prev()) {
+      FoundBlockRecord blk;
+      RawData data = It->value();
+      if (blk.deserializeValue(data.data, data.size))
+        indexFoundBlock(blk);
+    }
+    FoundBlocksTruncated_ = It->valid();
+
+    publishFoundBlocks();
+    LOG_F(INFO, "loaded %u found blocks from db, %zu indexed", blocksNum, FoundBlocks_.size());
+  }
+}
+
+AccountingDb::~AccountingDb()
+{
+  metricsRemoveCollector(MetricsCollector_);
 }
 
 void AccountingDb::enumerateStatsFiles(std::deque<CAccountingFile> &cache, const std::filesystem::path &directory, bool isOldFormat)
@@ -312,24 +344,163 @@ void AccountingDb::start()
       db->flushAccountingStorageFile(time(nullptr));
     }
   }, this, 0x20000, coroutineFinishCb, &FlushFinished_));
+
+  if (QueryThreadPool_) {
+    updateQuerySnapshot();
+    coroutineCall(coroutineNewWithCb([](void *arg) {
+      AccountingDb *db = static_cast<AccountingDb*>(arg);
+      for (;;) {
+        ioSleep(db->QuerySnapshotEvent_, std::chrono::microseconds(db->_cfg.QuerySnapshotInterval).count());
+        if (db->ShutdownRequested_)
+          break;
+        db->updateQuerySnapshot();
+      }
+    }, this, 0x20000, coroutineFinishCb, &QuerySnapshotUpdaterFinished_));
+  } else {
+    QuerySnapshotUpdaterFinished_ = true;
+  }
 }
 
 void AccountingDb::stop()
 {
   ShutdownRequested_ = true;
   userEventActivate(FlushTimerEvent_);
+  userEventActivate(QuerySnapshotEvent_);
   TaskHandler_.stop(CoinInfo_.Name.c_str(), "accounting: task handler");
   coroutineJoin(CoinInfo_.Name.c_str(), "accounting: flush thread", &FlushFinished_);
+  coroutineJoin(CoinInfo_.Name.c_str(), "accounting: query snapshot updater", &QuerySnapshotUpdaterFinished_);
 }
 
-void AccountingDb::updatePayoutFile()
+void AccountingDb::updateQuerySnapshot()
 {
-  xmstream stream;
-  for (auto &p: _payoutQueue)
-    p.serializeValue(stream);
+  auto beginPt = std::chrono::steady_clock::now();
+  std::unique_ptr<CQuerySnapshot> snapshot(new CQuerySnapshot);
+  for (const auto &It: _balanceMap)
+    snapshot->Balances[It.first].Data = It.second;
+
+  // Queued balance of users without balance record also shown
+  for (const auto &It: QueuedBalance_) {
+    UserBalanceInfo &info = snapshot->Balances[It.first];
+    if (info.Data.Login.empty())
+      info.Data = UserBalanceRecord(It.first, 0);
+    info.Queued = It.second / CoinInfo_.ExtraMultiplier;
+  }
+
+  snapshot->AcceptedWork = CurrentRoundWork_;
+
+  QuerySnapshot_.reset(snapshot.release());
+  SnapshotUpdateTime_->recordSince(beginPt);
+}
+
+void AccountingDb::addQueuedPayouts(const MiningRound *round)
+{
+  for (const auto &payout: round->Payouts) {
+    QueuedBalance_[payout.UserId] += payout.Value;
+    TotalQueued_ += payout.Value;
+  }
+}
+
+void AccountingDb::removeQueuedPayouts(const MiningRound *round)
+{
+  for (const auto &payout: round->Payouts) {
+    auto It = QueuedBalance_.find(payout.UserId);
+    if (It != QueuedBalance_.end() && (It->second -= payout.Value) == 0)
+      QueuedBalance_.erase(It);
+    TotalQueued_ -= payout.Value;
+  }
+}
+
+void AccountingDb::indexFoundBlock(const FoundBlockRecord &block)
+{
+  auto key = std::make_pair(block.Height, block.Hash);
+  auto It = FoundBlocks_.find(key);
+  if (It == FoundBlocks_.end()) {
+    if (!FoundBlocks_.empty() && FoundBlocks_.size() >= _cfg.FoundBlocksIndexSize) {
+      // Oldest block leaves index, blocks below it served from database
+      FoundBlocksTruncated_ = true;
+      if (key < FoundBlocks_.begin()->first)
+        return;
+      FoundBlocks_.erase(FoundBlocks_.begin());
+    }
+
+    // New block at height of already found blocks means chain reorganization, check them again
+    for (auto reorgIt = FoundBlocks_.lower_bound(std::make_pair(block.Height, std::string())); reorgIt != FoundBlocks_.end(); ++reorgIt)
+      reorgIt->second.Confirmations = -2;
+    It = FoundBlocks_.emplace(std::move(key), CFoundBlock()).first;
+  }
+
+  // Replace login with public name
+  CFoundBlock &foundBlock = It->second;
+  foundBlock.Record = block;
+  UserManager::Credentials credentials;
+  if (UserManager_.getUserCredentials(block.FoundBy, credentials) && !credentials.Name.empty())
+    foundBlock.Record.FoundBy = credentials.Name;
+  FoundBlocksChanged_ = true;
+}
+
+void AccountingDb::addLuckPoint(int64_t blockTime, double accumulatedWork, double expectedWork)
+{
+  // Blocks usually come in time order and appended in place: published snapshots read only points before LuckSize_
+  // Buffer reallocated with doubled capacity when full, or copied when point inserted before existing ones
+  // (prefix sums after it recalculated)
+  const CLuckPoint *points = LuckBuffer_ ? LuckBuffer_->Points.get() : nullptr;
+  size_t index = std::upper_bound(points, points + LuckSize_, blockTime, [](int64_t value, const CLuckPoint &point) { return value < point.Time; }) - points;
+  if (index != LuckSize_ || !LuckBuffer_ || LuckSize_ == LuckBuffer_->Capacity) {
+    std::shared_ptr<CLuckBuffer> buffer(new CLuckBuffer);
+    buffer->Capacity = std::max<size_t>(LuckSize_ * 2, 64);
+    buffer->Points.reset(new CLuckPoint[buffer->Capacity]);
+    std::copy(points, points + index, buffer->Points.get());
+    std::copy(points + index, points + LuckSize_, buffer->Points.get() + index + 1);
+    LuckBuffer_ = std::move(buffer);
+  }
+
+  CLuckPoint *luck = LuckBuffer_->Points.get();
+  luck[index] = CLuckPoint{blockTime, accumulatedWork, expectedWork, 0.0, 0.0};
+  LuckSize_++;
+  for (size_t i = index; i != LuckSize_; ++i) {
+    CLuckPoint &point = luck[i];
+    point.AccumulatedWorkSum = point.AccumulatedWork + (i ? luck[i-1].AccumulatedWorkSum : 0.0);
+    point.ExpectedWorkSum = point.ExpectedWork + (i ? luck[i-1].ExpectedWorkSum : 0.0);
+  }
+
+  FoundBlocksChanged_ = true;
+}
+
+void AccountingDb::updateFoundBlockConfirmations(const std::string &hash, uint64_t height, int64_t confirmations)
+{
+  // Keep last known value if nodes did not answer for this block
+  if (confirmations == -2)
+    return;
+
+  auto It = FoundBlocks_.find(std::make_pair(height, hash));
+  if (It != FoundBlocks_.end() && It->second.Confirmations != confirmations) {
+    It->second.Confirmations = confirmations;
+    FoundBlocksChanged_ = true;
+  }
+}
+
+void AccountingDb::publishFoundBlocks()
+{
+  // Copies at most FoundBlocksIndexSize blocks, luck points are shared
+  if (!FoundBlocksChanged_)
+    return;
 
-  _payoutsFd.write(stream.data(), 0, stream.sizeOf());
-  _payoutsFd.truncate(stream.sizeOf());
+  std::unique_ptr<CFoundBlocksSnapshot> snapshot(new CFoundBlocksSnapshot);
+  snapshot->Blocks.reserve(FoundBlocks_.size());
+  for (const auto &It: FoundBlocks_)
+    snapshot->Blocks.push_back(It.second);
+  snapshot->Truncated = FoundBlocksTruncated_;
+  snapshot->Luck = LuckBuffer_;
+  snapshot->LuckSize = LuckSize_;
+  FoundBlocksSnapshot_.reset(snapshot.release());
+  FoundBlocksChanged_ = false;
+}
+
+void AccountingDb::updatePayoutFile()
+{
+  auto beginPt = std::chrono::steady_clock::now();
+  _payoutQueue.flush();
+  PayoutFlushTime_->recordSince(beginPt);
 }
 
 void AccountingDb::cleanupRounds()
@@ -362,40 +533,46 @@ void AccountingDb::calculatePayments(MiningRound *R, int64_t generatedCoins)
   R->AvailableCoins = generatedCoins;
   R->Payouts.clear();
 
+  uint64_t feeConfigVersion = UserManager_.feeConfigVersion();
+  if (FeeResolution_.Version != feeConfigVersion)
+    FeeResolution_.reset(feeConfigVersion);
+
   int64_t totalPayout = 0;
   std::vector<PayoutDbRecord> payouts;
-  std::map<std::string, int64_t> feePayouts;
-  std::unordered_map<std::string, UserManager::UserFeeConfig> feePlans;
+  payouts.reserve(R->UserShares.size());
+  // Fee sums by recipient index
+  std::vector<int64_t> feeSums;
+  std::vector<int64_t> feeValues;
+  std::string debugString;
   for (const auto &record: R->UserShares) {
     // Calculate payout
     int64_t payoutValue = static_cast<int64_t>(R->AvailableCoins * (record.shareValue / R->TotalShareValue));
 
     totalPayout += payoutValue;
 
-    // get fee plan for user
-    std::string feePlanId = UserManager_.getFeePlanId(record.userId);
-    auto It = feePlans.find(feePlanId);
-    if (It == feePlans.end())
-      It = feePlans.insert(It, std::make_pair(feePlanId, UserManager_.getFeeRecord(feePlanId, CoinInfo_.Name)));
-
-    UserManager::UserFeeConfig &feeRecord = It->second;
+    uint32_t split = resolveFeeSplit(record.userId);
+    uint32_t splitBegin = FeeResolution_.SplitOffsets[split];
+    uint32_t splitEnd = FeeResolution_.SplitOffsets[split + 1];
+    if (feeSums.size() < FeeResolution_.RecipientNames.size())
+      feeSums.resize(FeeResolution_.RecipientNames.size(), 0);
 
     int64_t feeValuesSum = 0;
-    std::vector<int64_t> feeValues;
-    for (const auto &poolFeeRecord: feeRecord) {
-      int64_t value = static_cast<int64_t>(payoutValue * (poolFeeRecord.Percentage / 100.0));
+    feeValues.clear();
+    for (uint32_t i = splitBegin; i != splitEnd; ++i) {
+      int64_t value = static_cast<int64_t>(payoutValue * FeeResolution_.Rates[i]);
       feeValues.push_back(value);
       feeValuesSum += value;
     }
 
-    std::string debugString;
+    debugString.clear();
     if (feeValuesSum <= payoutValue) {
-      for (size_t i = 0, ie = feeRecord.size(); i != ie; ++i) {
-        debugString.append(feeRecord[i].UserId);
+      for (uint32_t i = 0, ie = splitEnd - splitBegin; i != ie; ++i) {
+        uint32_t recipient = FeeResolution_.Recipients[splitBegin + i];
+        debugString.append(FeeResolution_.RecipientNames[recipient]);
         debugString.push_back('(');
         debugString.append(FormatMoney(feeValues[i], rationalPartSize));
         debugString.append(") ");
-        feePayouts[feeRecord[i].UserId] += feeValues[i];
+        feeSums[recipient] += feeValues[i];
       }
 
       payoutValue -= feeValuesSum;
@@ -410,6 +587,13 @@ void AccountingDb::calculatePayments(MiningRound *R, int64_t generatedCoins)
     LOG_F(INFO, " * %s %s -> %sremaining %s", record.userId.c_str(), FormatMoney(payoutValue+feeValuesSum, rationalPartSize).c_str(), debugString.c_str(), FormatMoney(payoutValue, rationalPartSize).c_str());
   }
 
+  // Zero fee sums skipped: merge ignores them
+  std::map<std::string, int64_t> feePayouts;
+  for (size_t i = 0, ie = feeSums.size(); i != ie; ++i) {
+    if (feeSums[i])
+      feePayouts.emplace(FeeResolution_.RecipientNames[i], feeSums[i]);
+  }
+
   mergeSorted(payouts.begin(), payouts.end(), feePayouts.begin(), feePayouts.end(),
     [](const PayoutDbRecord &l, const std::pair<std::string, int64_t> &r) { return l.UserId < r.first; },
     [](const std::pair<std::string, int64_t> &l, const PayoutDbRecord &r) { return l.first < r.UserId; },
@@ -445,10 +629,40 @@ void AccountingDb::calculatePayments(MiningRound *R, int64_t generatedCoins)
   }
 }
 
+uint32_t AccountingDb::resolveFeeSplit(const std::string &userId)
+{
+  auto It = FeeResolution_.UserSplit.find(userId);
+  if (It != FeeResolution_.UserSplit.end())
+    return It->second;
+
+  std::string feePlanId = UserManager_.getFeePlanId(userId);
+  auto PlanIt = FeeResolution_.PlanSplit.find(feePlanId);
+  if (PlanIt == FeeResolution_.PlanSplit.end()) {
+    uint32_t split = static_cast<uint32_t>(FeeResolution_.SplitOffsets.size() - 1);
+    for (const auto &pair: UserManager_.getFeeRecord(feePlanId, CoinInfo_.Name)) {
+      auto RecipientIt = FeeResolution_.RecipientIndex.find(pair.UserId);
+      if (RecipientIt == FeeResolution_.RecipientIndex.end()) {
+        RecipientIt = FeeResolution_.RecipientIndex.emplace(pair.UserId, static_cast<uint32_t>(FeeResolution_.RecipientNames.size())).first;
+        FeeResolution_.RecipientNames.push_back(pair.UserId);
+      }
+
+      FeeResolution_.Recipients.push_back(RecipientIt->second);
+      FeeResolution_.Rates.push_back(pair.Percentage / 100.0);
+    }
+
+    FeeResolution_.SplitOffsets.push_back(static_cast<uint32_t>(FeeResolution_.Recipients.size()));
+    PlanIt = FeeResolution_.PlanSplit.emplace(feePlanId, split).first;
+  }
+
+  FeeResolution_.UserSplit.emplace(userId, PlanIt->second);
+  return PlanIt->second;
+}
+
 void AccountingDb::addShare(const CShare &share)
 {
   // increment score
   CurrentScores_[share.userId] += share.WorkValue;
+  CurrentRoundWork_ += share.WorkValue;
   LastKnownShareId_ = share.UniqueShareId;
 
   if (share.isBlock) {
@@ -469,6 +683,10 @@ void AccountingDb::addShare(const CShare &share)
       if (hasUnknownReward())
         blk.PublicHash = "?";
       _foundBlocksDb.put(blk);
+      indexFoundBlock(blk);
+      if (blk.ExpectedWork != 0.0)
+        addLuckPoint(blk.Time, blk.AccumulatedWork, blk.ExpectedWork);
+      publishFoundBlocks();
     }
 
     MiningRound *R = new MiningRound;
@@ -507,6 +725,7 @@ void AccountingDb::addShare(const CShare &share)
     }
 
     CurrentScores_.clear();
+    CurrentRoundWork_ = 0.0;
 
     // Calculate total share value
     for (const auto &element: R->UserShares)
@@ -520,6 +739,7 @@ void AccountingDb::addShare(const CShare &share)
     _allRounds.emplace_back(R);
     _roundsDb.put(*R);
     UnpayedRounds_.insert(R);
+    addQueuedPayouts(R);
 
     // Query statistics
     StatisticDb_.exportRecentStats(RecentStats_);
@@ -527,6 +747,7 @@ void AccountingDb::addShare(const CShare &share)
 
     // Reset aggregated data
     CurrentScores_.clear();
+    CurrentRoundWork_ = 0.0;
 
     // Remove old data
     for (const auto &file: AccountingDiskStorage_)
@@ -543,6 +764,7 @@ void AccountingDb::replayShare(const CShare &share)
   if (share.UniqueShareId > FlushInfo_.ShareId) {
     // increment score
     CurrentScores_[share.userId] += share.WorkValue;
+    CurrentRoundWork_ += share.WorkValue;
   }
 
   LastKnownShareId_ = std::max(LastKnownShareId_, share.UniqueShareId);
@@ -577,30 +799,70 @@ void AccountingDb::mergeRound(const Round*)
 {
 }
 
-void AccountingDb::checkBlockConfirmations()
+void AccountingDb::updateConfirmationsStats(std::chrono::time_point<std::chrono::steady_clock> startTime, bool success, unsigned respondedNodes)
 {
-  if (UnpayedRounds_.empty())
-    return;
+  int64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+  ConfirmationsLatency_->record(latency * 1000);
+  ConfirmationsStats_.Cycles++;
+  if (!success) {
+    ConfirmationsStats_.FailedCycles++;
+    ConfirmationsFailures_->add();
+  }
+  ConfirmationsStats_.LastLatency = latency;
+  ConfirmationsStats_.LastRespondedNodes = respondedNodes;
+  if (latency > ConfirmationsStats_.MaxLatency)
+    ConfirmationsStats_.MaxLatency = latency;
+  LOG_F(1, "[%s] block confirmations check: %u nodes answered, latency %.3lfms", CoinInfo_.Name.c_str(), respondedNodes, latency / 1000.0);
+}
 
-  LOG_F(INFO, "Checking %zu blocks for confirmations...", UnpayedRounds_.size());
+void AccountingDb::checkBlockConfirmations()
+{
   std::vector<MiningRound*> rounds(UnpayedRounds_.begin(), UnpayedRounds_.end());
-
+  std::set<std::pair<uint64_t, std::string>> roundBlocks;
   std::vector<CNetworkClient::GetBlockConfirmationsQuery> confirmationsQuery(rounds.size());
   for (size_t i = 0, ie = rounds.size(); i != ie; ++i) {
     confirmationsQuery[i].Hash = rounds[i]->BlockHash;
     confirmationsQuery[i].Height = rounds[i]->Height;
+    roundBlocks.emplace(rounds[i]->Height, rounds[i]->BlockHash);
+  }
+
+  // Update cache of found blocks query in same request
+  unsigned cacheQueryLimit = _cfg.ConfirmationsCacheBatch;
+  for (auto It = FoundBlocks_.rbegin(), ItE = FoundBlocks_.rend(); It != ItE && cacheQueryLimit; ++It) {
+    int64_t confirmations = It->second.Confirmations;
+    if (confirmations == -1 || confirmations >= static_cast<int64_t>(_cfg.RequiredConfirmations) || roundBlocks.count(It->first))
+      continue;
+    confirmationsQuery.emplace_back(It->first.second, It->first.first);
+    cacheQueryLimit--;
   }
 
-  if (!ClientDispatcher_.ioGetBlockConfirmations(Base_, _cfg.RequiredConfirmations, confirmationsQuery)) {
+  if (confirmationsQuery.empty())
+    return;
+
+  LOG_F(1, "Checking %zu blocks for confirmations (%zu unpayed)...", confirmationsQuery.size(), rounds.size());
+
+  // Other coroutines (share processing) continue working while nodes are queried
+  unsigned respondedNodes = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  bool success = ClientDispatcher_.ioGetBlockConfirmations(Base_, _cfg.RequiredConfirmations, confirmationsQuery, _cfg.ConfirmationsQuorum, &respondedNodes);
+  updateConfirmationsStats(startTime, success, respondedNodes);
+  if (!success) {
     LOG_F(ERROR, "ioGetBlockConfirmations api call failed");
     return;
   }
 
-  for (size_t i = 0; i < confirmationsQuery.size(); i++) {
+  for (const auto &query: confirmationsQuery)
+    updateFoundBlockConfirmations(query.Hash, query.Height, query.Confirmations);
+  publishFoundBlocks();
+
+  for (size_t i = 0; i < rounds.size(); i++) {
     MiningRound *R = rounds[i];
+    if (!UnpayedRounds_.count(R))
+      continue;
 
     if (confirmationsQuery[i].Confirmations == -1) {
       LOG_F(INFO, "block %" PRIu64 "/%s marked as orphan, can't do any payout", R->Height, confirmationsQuery[i].Hash.c_str());
+      removeQueuedPayouts(R);
       R->Payouts.clear();
       UnpayedRounds_.erase(R);
       _roundsDb.put(*R);
@@ -610,6 +872,7 @@ void AccountingDb::checkBlockConfirmations()
         requestPayout(I->UserId, I->Value);
       }
 
+      removeQueuedPayouts(R);
       R->Payouts.clear();
 
       UnpayedRounds_.erase(R);
@@ -632,13 +895,20 @@ void AccountingDb::checkBlockExtraInfo()
   for (const auto &round: unpayedRounds)
     confirmationsQuery.emplace_back(round->BlockHash, round->Height, round->TxFee, round->AvailableCoins);
 
-  if (!ClientDispatcher_.ioGetBlockExtraInfo(Base_, _cfg.RequiredConfirmations, confirmationsQuery)) {
+  unsigned respondedNodes = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  bool success = ClientDispatcher_.ioGetBlockExtraInfo(Base_, _cfg.RequiredConfirmations, confirmationsQuery, _cfg.ConfirmationsQuorum, &respondedNodes);
+  updateConfirmationsStats(startTime, success, respondedNodes);
+  if (!success) {
     LOG_F(ERROR, "ioGetBlockExtraInfo api call failed");
     return;
   }
 
   for (size_t i = 0; i < confirmationsQuery.size(); i++) {
+    updateFoundBlockConfirmations(confirmationsQuery[i].Hash, confirmationsQuery[i].Height, confirmationsQuery[i].Confirmations);
     MiningRound *R = unpayedRounds[i];
+    if (!UnpayedRounds_.count(R))
+      continue;
 
     if (R->AvailableCoins != confirmationsQuery[i].BlockReward) {
       // Update found block database
@@ -652,15 +922,19 @@ void AccountingDb::checkBlockExtraInfo()
       blk.AccumulatedWork = R->AccumulatedWork;
       blk.PublicHash = confirmationsQuery[i].PublicHash;
       _foundBlocksDb.put(blk);
+      indexFoundBlock(blk);
 
       // Update payment info
       R->TxFee = confirmationsQuery[i].TxFee;
+      removeQueuedPayouts(R);
       calculatePayments(R, confirmationsQuery[i].BlockReward);
+      addQueuedPayouts(R);
       _roundsDb.put(*R);
     }
 
     if (confirmationsQuery[i].Confirmations == -1) {
       LOG_F(INFO, "block %" PRIu64 "/%s marked as orphan, can't do any payout", R->Height, confirmationsQuery[i].Hash.c_str());
+      removeQueuedPayouts(R);
       R->Payouts.clear();
       UnpayedRounds_.erase(R);
       _roundsDb.put(*R);
@@ -670,6 +944,7 @@ void AccountingDb::checkBlockExtraInfo()
         requestPayout(I->UserId, I->Value);
       }
 
+      removeQueuedPayouts(R);
       R->Payouts.clear();
 
       UnpayedRounds_.erase(R);
@@ -677,12 +952,12 @@ void AccountingDb::checkBlockExtraInfo()
     }
   }
 
+  publishFoundBlocks();
   updatePayoutFile();
 }
 
-void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout)
+bool AccountingDb::checkPayoutRecipient(const PayoutDbRecord &payout, unsigned index, std::string &recipient)
 {
-  *needSkipPayout = false;
   if (payout.Value < _cfg.MinimalAllowedPayout) {
     LOG_F(INFO,
           "[%u] Accounting: ignore this payout to %s, value is %s, minimal is %s",
@@ -690,8 +965,7 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
           payout.UserId.c_str(),
           FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(),
           FormatMoney(_cfg.MinimalAllowedPayout, CoinInfo_.RationalPartSize).c_str());
-    *needSkipPayout = true;
-    return;
+    return false;
   }
 
   // Get address for payment
@@ -699,13 +973,22 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   bool hasSettings = UserManager_.getUserCoinSettings(payout.UserId, CoinInfo_.Name, settings);
   if (!hasSettings || settings.Address.empty()) {
     LOG_F(WARNING, "user %s did not setup payout address, ignoring", payout.UserId.c_str());
-    *needSkipPayout = true;
-    return;
+    return false;
   }
 
   recipient = settings.Address;
   if (!CoinInfo_.checkAddress(settings.Address, CoinInfo_.PayoutAddressType)) {
     LOG_F(ERROR, "Invalid payment address %s for %s", settings.Address.c_str(), payout.UserId.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout)
+{
+  *needSkipPayout = false;
+  if (!checkPayoutRecipient(payout, index, recipient)) {
     *needSkipPayout = true;
     return;
   }
@@ -714,14 +997,14 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   // For bitcoin-based API it's sequential call of createrawtransaction, fundrawtransaction and signrawtransaction
   CNetworkClient::BuildTransactionResult transaction;
   CNetworkClient::EOperationStatus status =
-    ClientDispatcher_.ioBuildTransaction(Base_, settings.Address.c_str(), _cfg.MiningAddresses.get().MiningAddress, payout.Value, transaction);
+    ClientDispatcher_.ioBuildTransaction(Base_, recipient.c_str(), _cfg.MiningAddresses.get().MiningAddress, payout.Value, transaction);
   if (status == CNetworkClient::EStatusOk) {
     // Nothing to do
   } else if (status == CNetworkClient::EStatusInsufficientFunds) {
     LOG_F(INFO, "No money left to pay");
     return;
   } else {
-    LOG_F(ERROR, "Payment %s to %s failed with error \"%s\"", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), settings.Address.c_str(), transaction.Error.c_str());
+    LOG_F(ERROR, "Payment %s to %s failed with error \"%s\"", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), recipient.c_str(), transaction.Error.c_str());
     return;
   }
 
@@ -729,6 +1012,7 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   if (delta > 0) {
     // Correct payout value and request balance
     payout.Value -= delta;
+    _payoutQueue.update(payout);
 
     // Update user balance
     auto It = _balanceMap.find(payout.UserId);
@@ -740,9 +1024,10 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
     LOG_F(INFO, "   * correct requested balance for %s by %s", payout.UserId.c_str(), FormatMoney(delta, CoinInfo_.RationalPartSize).c_str());
     UserBalanceRecord &balance = It->second;
     balance.Requested -= delta;
+    TotalRequested_ -= delta;
     _balanceDb.put(balance);
   } else if (delta < 0) {
-    LOG_F(ERROR, "Payment %s to %s failed: too big transaction amount", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), settings.Address.c_str());
+    LOG_F(ERROR, "Payment %s to %s failed: too big transaction amount", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), recipient.c_str());
     return;
   }
 
@@ -757,90 +1042,292 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   payout.Time = time(nullptr);
   payout.Status = PayoutDbRecord::ETxCreated;
   _payoutDb.put(payout);
+  _payoutQueue.update(payout);
+}
+
+bool AccountingDb::buildBatchTransaction(std::vector<PayoutDbRecord*> &batch, const std::vector<CNetworkClient::TransactionOutput> &outputs, CNetworkClient::EOperationStatus *status)
+{
+  // Build one transaction for all payouts in batch, network fee is subtracted from outputs
+  CNetworkClient::BuildTransactionResult transaction;
+  *status = ClientDispatcher_.ioBuildBatchTransaction(Base_, outputs, _cfg.MiningAddresses.get().MiningAddress, transaction);
+  if (*status == CNetworkClient::EStatusOk) {
+    // Nothing to do
+  } else if (*status == CNetworkClient::EStatusInsufficientFunds) {
+    LOG_F(INFO, "No money left to pay");
+    return false;
+  } else if (*status == CNetworkClient::EStatusMethodNotFound) {
+    return false;
+  } else {
+    LOG_F(ERROR, "Batch payment of %zu outputs failed with error \"%s\"", outputs.size(), transaction.Error.c_str());
+    return false;
+  }
+
+  int64_t batchValue = 0;
+  for (const PayoutDbRecord *payout: batch)
+    batchValue += payout->Value;
+
+  int64_t delta = batchValue - (transaction.Value + transaction.Fee);
+  if (delta < 0) {
+    LOG_F(ERROR, "Batch payment of %zu outputs failed: too big transaction amount", outputs.size());
+    return false;
+  }
+
+  // Save transaction to database
+  if (!KnownTransactions_.insert(transaction.TxId).second) {
+    LOG_F(ERROR, "Node generated duplicate for transaction %s !!!", transaction.TxId.c_str());
+    return false;
+  }
+
+  if (delta > 0) {
+    // Correct payout values and requested balances, difference split in proportion to payout value
+    std::vector<int64_t> deltaShares;
+    splitByValue(batch, delta, deltaShares);
+    for (size_t i = 0, ie = batch.size(); i != ie; ++i) {
+      PayoutDbRecord &payout = *batch[i];
+      if (!deltaShares[i])
+        continue;
+
+      payout.Value -= deltaShares[i];
+      auto It = _balanceMap.find(payout.UserId);
+      if (It == _balanceMap.end()) {
+        LOG_F(ERROR, "payout to unknown address %s", payout.UserId.c_str());
+        continue;
+      }
+
+      LOG_F(INFO, "   * correct requested balance for %s by %s", payout.UserId.c_str(), FormatMoney(deltaShares[i], CoinInfo_.RationalPartSize).c_str());
+      UserBalanceRecord &balance = It->second;
+      balance.Requested -= deltaShares[i];
+      TotalRequested_ -= deltaShares[i];
+      _balanceDb.put(balance);
+    }
+  }
+
+  // Network fee subtracted from outputs: payout value becomes net amount, fee share stored in TxFee
+  std::vector<int64_t> feeShares;
+  splitByValue(batch, transaction.Fee, feeShares);
+  for (size_t i = 0, ie = batch.size(); i != ie; ++i) {
+    batch[i]->Value -= feeShares[i];
+    batch[i]->TxFee = feeShares[i];
+  }
+
+  // Transaction data stored only once per batch (in first payout record)
+  int64_t currentTime = time(nullptr);
+  for (size_t i = 0, ie = batch.size(); i != ie; ++i) {
+    PayoutDbRecord &payout = *batch[i];
+    if (i == 0)
+      payout.TransactionData = transaction.TxData;
+    payout.TransactionId = transaction.TxId;
+    payout.Time = currentTime;
+    payout.Status = PayoutDbRecord::ETxCreated;
+    _payoutDb.put(payout);
+    _payoutQueue.update(payout);
+  }
+
+  LOG_F(INFO,
+        " * batch transaction %s: %zu outputs, value %s, fee %s",
+        transaction.TxId.c_str(),
+        outputs.size(),
+        FormatMoney(transaction.Value, CoinInfo_.RationalPartSize).c_str(),
+        FormatMoney(transaction.Fee, CoinInfo_.RationalPartSize).c_str());
+  return true;
 }
 
-bool AccountingDb::sendTransaction(PayoutDbRecord &payout)
+void AccountingDb::splitByValue(const std::vector<PayoutDbRecord*> &records, int64_t amount, std::vector<int64_t> &shares)
 {
+  int64_t total = 0;
+  for (const PayoutDbRecord *record: records)
+    total += record->Value;
+
+  // Rounding remainder goes to last record
+  shares.assign(records.size(), 0);
+  int64_t distributed = 0;
+  for (size_t i = 0, ie = records.size(); i + 1 < ie && total > 0; ++i) {
+    shares[i] = static_cast<int64_t>(amount * (static_cast<double>(records[i]->Value) / total));
+    distributed += shares[i];
+  }
+
+  if (!records.empty())
+    shares.back() = amount - distributed;
+}
+
+void AccountingDb::rejectTransaction(std::vector<PayoutDbRecord*> &records)
+{
+  for (auto payout: records) {
+    // Update transaction in database
+    payout->Status = PayoutDbRecord::ETxRejected;
+    _payoutDb.put(*payout);
+
+    // Clear all data and re-schedule payout, batch fee share returns to payout value
+    payout->TransactionId.clear();
+    payout->TransactionData.clear();
+    payout->Value += payout->TxFee;
+    payout->TxFee = 0;
+    payout->Status = PayoutDbRecord::EInitialized;
+    _payoutQueue.update(*payout);
+  }
+}
+
+bool AccountingDb::sendTransaction(std::vector<PayoutDbRecord*> &records)
+{
+  PayoutDbRecord &payout = *records.front();
+
+  // Batch transaction data stored in one record only
+  const std::string *txData = &payout.TransactionData;
+  for (auto record: records) {
+    if (!record->TransactionData.empty()) {
+      txData = &record->TransactionData;
+      break;
+    }
+  }
+
   // Send transaction and change it status to 'Sent'
   // For bitcoin-based API it's 'sendrawtransaction'
   std::string error;
-  CNetworkClient::EOperationStatus status = ClientDispatcher_.ioSendTransaction(Base_, payout.TransactionData, payout.TransactionId, error);
+  CNetworkClient::EOperationStatus status = ClientDispatcher_.ioSendTransaction(Base_, *txData, payout.TransactionId, error);
   if (status == CNetworkClient::EStatusOk) {
     // Nothing to do
   } else if (status == CNetworkClient::EStatusVerifyRejected) {
     // Sending failed, transaction is rejected
-    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", payout.TransactionId.c_str(), payout.UserId.c_str());
-
-    // Update transaction in database
-    payout.Status = PayoutDbRecord::ETxRejected;
-    _payoutDb.put(payout);
-
-    // Clear all data and re-schedule payout
-    payout.TransactionId.clear();
-    payout.TransactionData.clear();
-    payout.Status = PayoutDbRecord::EInitialized;
+    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", payout.TransactionId.c_str(), payoutRecipientsName(records).c_str());
+    rejectTransaction(records);
     return false;
   } else {
-    LOG_F(WARNING, "Sending transaction %s to %s error \"%s\", will try send later...", payout.TransactionId.c_str(), payout.UserId.c_str(), error.c_str());
+    LOG_F(WARNING, "Sending transaction %s to %s error \"%s\", will try send later...", payout.TransactionId.c_str(), payoutRecipientsName(records).c_str(), error.c_str());
     return false;
   }
 
-  payout.Status = PayoutDbRecord::ETxSent;
-  _payoutDb.put(payout);
+  for (auto record: records) {
+    record->Status = PayoutDbRecord::ETxSent;
+    _payoutDb.put(*record);
+    _payoutQueue.update(*record);
+  }
+
   return true;
 }
 
-bool AccountingDb::checkTxConfirmations(PayoutDbRecord &payout)
+bool AccountingDb::checkTxConfirmations(std::vector<PayoutDbRecord*> &records)
 {
+  PayoutDbRecord &payout = *records.front();
   int64_t confirmations = 0;
+  int64_t txFee = 0;
   std::string error;
-  CNetworkClient::EOperationStatus status = ClientDispatcher_.ioGetTxConfirmations(Base_, payout.TransactionId, &confirmations, &payout.TxFee, error);
+  CNetworkClient::EOperationStatus status = ClientDispatcher_.ioGetTxConfirmations(Base_, payout.TransactionId, &confirmations, &txFee, error);
   if (status == CNetworkClient::EStatusOk) {
     // Nothing to do
   } else if (status == CNetworkClient::EStatusInvalidAddressOrKey) {
     // Wallet don't know about this transaction
-    payout.Status = PayoutDbRecord::ETxCreated;
+    for (auto record: records) {
+      record->Status = PayoutDbRecord::ETxCreated;
+      _payoutQueue.update(*record);
+    }
+    return false;
   } else if (status == CNetworkClient::EStatusVerifyRejected) {
     // Sending failed, transaction is rejected
-    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", payout.TransactionId.c_str(), payout.UserId.c_str());
-
-    // Update transaction in database
-    payout.Status = PayoutDbRecord::ETxRejected;
-    _payoutDb.put(payout);
-
-    // Clear all data and re-schedule payout
-    payout.TransactionId.clear();
-    payout.TransactionData.clear();
-    payout.Status = PayoutDbRecord::EInitialized;
+    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", payout.TransactionId.c_str(), payoutRecipientsName(records).c_str());
+    rejectTransaction(records);
     return false;
   } else {
-    LOG_F(WARNING, "Checking transaction %s to %s error \"%s\", will do it later...", payout.TransactionId.c_str(), payout.UserId.c_str(), error.c_str());
+    LOG_F(WARNING, "Checking transaction %s to %s error \"%s\", will do it later...", payout.TransactionId.c_str(), payoutRecipientsName(records).c_str(), error.c_str());
     return false;
   }
 
   // Update database
   if (confirmations > _cfg.RequiredConfirmations) {
-    payout.Status = PayoutDbRecord::ETxConfirmed;
-    _payoutDb.put(payout);
+    bool result = true;
+    for (auto record: records) {
+      // Batch payouts: value is net amount and fee share already stored in TxFee, requested amount includes both
+      // Single payouts: fee reported by node paid over requested value
+      int64_t requested = record->Value + record->TxFee;
+      if (record->TxFee == 0 && records.size() == 1)
+        record->TxFee = txFee;
+      record->Status = PayoutDbRecord::ETxConfirmed;
+      _payoutDb.put(*record);
+      _payoutQueue.update(*record);
+
+      // Update user balance
+      auto It = _balanceMap.find(record->UserId);
+      if (It == _balanceMap.end()) {
+        LOG_F(ERROR, "payout to unknown address %s", record->UserId.c_str());
+        result = false;
+        continue;
+      }
 
-    // Update user balance
-    auto It = _balanceMap.find(payout.UserId);
-    if (It == _balanceMap.end()) {
-      LOG_F(ERROR, "payout to unknown address %s", payout.UserId.c_str());
-      return false;
+      UserBalanceRecord &balance = It->second;
+      balance.Balance.subRational(record->Value + record->TxFee, CoinInfo_.ExtraMultiplier);
+      balance.Requested -= requested;
+      TotalBalance_ -= (record->Value + record->TxFee) * CoinInfo_.ExtraMultiplier;
+      TotalRequested_ -= requested;
+      balance.Paid += record->Value;
+      _balanceDb.put(balance);
     }
 
-    UserBalanceRecord &balance = It->second;
-    balance.Balance.subRational(payout.Value + payout.TxFee, CoinInfo_.ExtraMultiplier);
-    balance.Requested -= payout.Value;
-    balance.Paid += payout.Value;
-    _balanceDb.put(balance);
-    return true;
+    return result;
   }
 
   return false;
 }
 
+std::string AccountingDb::payoutRecipientsName(const std::vector<PayoutDbRecord*> &records)
+{
+  return records.size() == 1 ? records.front()->UserId : std::to_string(records.size()) + " users";
+}
+
+void AccountingDb::makeBatchPayouts()
+{
+  std::vector<PayoutDbRecord*> batch;
+  std::vector<CNetworkClient::TransactionOutput> outputs;
+  std::unordered_set<std::string> batchAddresses;
+  int64_t batchValue = 0;
+  size_t maxOutputs = std::max(_cfg.PayoutBatchMaxOutputs, 1u);
+
+  auto flushBatch = [&]() -> bool {
+    CNetworkClient::EOperationStatus status;
+    bool result = buildBatchTransaction(batch, outputs, &status);
+    if (result) {
+      // Send transaction and change it status to 'Sent'
+      if (sendTransaction(batch))
+        LOG_F(INFO, " * sent %s to %zu users with txid %s", FormatMoney(batchValue, CoinInfo_.RationalPartSize).c_str(), batch.size(), batch.front()->TransactionId.c_str());
+    } else if (status == CNetworkClient::EStatusMethodNotFound) {
+      LOG_F(WARNING, "%s: batch payouts not supported by node, will use one transaction per payout", CoinInfo_.Name.c_str());
+      BatchPayoutsSupported_ = false;
+    }
+
+    batch.clear();
+    outputs.clear();
+    batchAddresses.clear();
+    batchValue = 0;
+    return result;
+  };
+
+  for (PayoutDbRecord *record: _payoutQueue.collect(PayoutDbRecord::EInitialized)) {
+    PayoutDbRecord &payout = *record;
+    std::string recipientAddress;
+    if (!checkPayoutRecipient(payout, 0, recipientAddress))
+      continue;
+
+    // Transaction can't contain two outputs with same address, such payout will be done in next session
+    if (batchAddresses.count(recipientAddress))
+      continue;
+
+    if (_cfg.PayoutBatchMaxValue && !batch.empty() && batchValue + payout.Value > _cfg.PayoutBatchMaxValue) {
+      if (!flushBatch())
+        return;
+    }
+
+    batch.push_back(&payout);
+    outputs.emplace_back(recipientAddress, payout.Value);
+    batchAddresses.insert(recipientAddress);
+    batchValue += payout.Value;
+    if (batch.size() >= maxOutputs) {
+      if (!flushBatch())
+        return;
+    }
+  }
+
+  if (!batch.empty())
+    flushBatch();
+}
+
 void AccountingDb::makePayout()
 {
   if (!_payoutQueue.empty()) {
@@ -849,32 +1336,56 @@ void AccountingDb::makePayout()
     // Merge small payouts and payouts to invalid address
     {
       std::map<std::string, int64_t> payoutAccMap;
-      for (auto I = _payoutQueue.begin(), IE = _payoutQueue.end(); I != IE;) {
-        if (I->Status != PayoutDbRecord::EInitialized) {
-          ++I;
-          continue;
-        }
-
-        if (I->Value < _cfg.MinimalAllowedPayout) {
-          payoutAccMap[I->UserId] += I->Value;
+      for (PayoutDbRecord *payout: _payoutQueue.collect(PayoutDbRecord::EInitialized)) {
+        if (payout->Value < _cfg.MinimalAllowedPayout) {
+          payoutAccMap[payout->UserId] += payout->Value;
           LOG_F(INFO,
                 "Accounting: merge payout %s for %s (total already %s)",
-                FormatMoney(I->Value, CoinInfo_.RationalPartSize).c_str(),
-                I->UserId.c_str(),
-                FormatMoney(payoutAccMap[I->UserId], CoinInfo_.RationalPartSize).c_str());
-          _payoutQueue.erase(I++);
-        } else {
-          ++I;
+                FormatMoney(payout->Value, CoinInfo_.RationalPartSize).c_str(),
+                payout->UserId.c_str(),
+                FormatMoney(payoutAccMap[payout->UserId], CoinInfo_.RationalPartSize).c_str());
+          _payoutQueue.erase(*payout);
         }
       }
 
       for (const auto &I: payoutAccMap)
-        _payoutQueue.push_back(PayoutDbRecord(I.first, I.second));
+        _payoutQueue.push(PayoutDbRecord(I.first, I.second));
+    }
+
+    // Resend transactions and check confirmations
+    // Payouts sharing one batch transaction are processed together
+    {
+      std::vector<std::string> transactionIds;
+      std::unordered_map<std::string, std::vector<PayoutDbRecord*>> transactions;
+      for (uint32_t status: {PayoutDbRecord::ETxCreated, PayoutDbRecord::ETxSent}) {
+        for (PayoutDbRecord *payout: _payoutQueue.collect(status)) {
+          auto &records = transactions[payout->TransactionId];
+          if (records.empty())
+            transactionIds.push_back(payout->TransactionId);
+          records.push_back(payout);
+        }
+      }
+
+      for (const auto &txId: transactionIds) {
+        auto &records = transactions[txId];
+        if (records.front()->Status == PayoutDbRecord::ETxCreated) {
+          // Resend transaction
+          if (sendTransaction(records))
+            LOG_F(INFO, " * retry send txid %s to %s", txId.c_str(), payoutRecipientsName(records).c_str());
+        } else if (records.front()->Status == PayoutDbRecord::ETxSent) {
+          // Check confirmations
+          if (checkTxConfirmations(records))
+            LOG_F(INFO, " * transaction txid %s to %s confirmed", txId.c_str(), payoutRecipientsName(records).c_str());
+        }
+      }
     }
 
-    unsigned index = 0;
-    for (auto &payout: _payoutQueue) {
-      if (payout.Status == PayoutDbRecord::EInitialized) {
+    if (_cfg.PayoutBatchEnabled && BatchPayoutsSupported_) {
+      makeBatchPayouts();
+    } else {
+      unsigned index = 0;
+      for (PayoutDbRecord *record: _payoutQueue.collect(PayoutDbRecord::EInitialized)) {
+        PayoutDbRecord &payout = *record;
         // Build transaction
         // For bitcoin-based API it's sequential call of createrawtransaction, fundrawtransaction and signrawtransaction
         bool needSkipPayout;
@@ -886,32 +1397,19 @@ void AccountingDb::makePayout()
         if (payout.Status == PayoutDbRecord::ETxCreated) {
           // Send transaction and change it status to 'Sent'
           // For bitcoin-based API it's 'sendrawtransaction'
-          if (sendTransaction(payout))
+          std::vector<PayoutDbRecord*> records = {&payout};
+          if (sendTransaction(records))
             LOG_F(INFO, " * sent %s to %s(%s) with txid %s", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), payout.UserId.c_str(), recipientAddress.c_str(), payout.TransactionId.c_str());
         } else {
           break;
         }
-      } else if (payout.Status == PayoutDbRecord::ETxCreated) {
-        // Resend transaction
-        if (sendTransaction(payout))
-          LOG_F(INFO, " * retry send txid %s to %s", payout.TransactionId.c_str(), payout.UserId.c_str());
-      } else if (payout.Status == PayoutDbRecord::ETxSent) {
-        // Check confirmations
-        if (checkTxConfirmations(payout))
-          LOG_F(INFO, " * transaction txid %s to %s confirmed", payout.TransactionId.c_str(), payout.UserId.c_str());
-      } else {
-        // Invalid status
       }
     }
 
     // Cleanup confirmed payouts
-    for (auto I = _payoutQueue.begin(), IE = _payoutQueue.end(); I != IE;) {
-      if (I->Status == PayoutDbRecord::ETxConfirmed) {
-        KnownTransactions_.erase(I->TransactionId);
-        _payoutQueue.erase(I++);
-      } else {
-        ++I;
-      }
+    for (PayoutDbRecord *payout: _payoutQueue.collect(PayoutDbRecord::ETxConfirmed)) {
+      KnownTransactions_.erase(payout->TransactionId);
+      _payoutQueue.erase(*payout);
     }
 
     updatePayoutFile();
@@ -968,13 +1466,8 @@ void AccountingDb::makePayout()
   }
 
   // Check consistency
-  bool needRebuild = false;
-  std::unordered_map<std::string, int64_t> enqueued;
-  for (const auto &payout: _payoutQueue)
-    enqueued[payout.UserId] += payout.Value;
-
   for (auto &userIt: _balanceMap) {
-    int64_t enqueuedBalance = enqueued[userIt.first];
+    int64_t enqueuedBalance = _payoutQueue.userQueued(userIt.first).Value;
     if (userIt.second.Requested != enqueuedBalance) {
       LOG_F(ERROR,
             "User %s: enqueued: %s, control sum: %s",
@@ -984,9 +1477,6 @@ void AccountingDb::makePayout()
     }
   }
 
-  if (needRebuild)
-    LOG_F(ERROR, "Payout database inconsistent, restart pool for rebuild recommended");
-
   // Make a service after every payment session
   {
     std::string serviceError;
@@ -1023,23 +1513,11 @@ void AccountingDb::checkBalance()
   balance = getBalanceResult.Balance + zbalance;
   immature = getBalanceResult.Immatured;
 
-  for (auto &userIt: _balanceMap) {
-    userBalance += userIt.second.Balance.get();
-    requestedInBalance += userIt.second.Requested;
-  }
-  userBalance /= CoinInfo_.ExtraMultiplier;
-
-  for (auto &p: _payoutQueue) {
-    requestedInQueue += p.Value;
-    if (p.Status == PayoutDbRecord::ETxSent)
-      confirmationWait += p.Value + p.TxFee;
-  }
-
-  for (auto &roundIt: UnpayedRounds_) {
-    for (auto &pIt: roundIt->Payouts)
-      queued += pIt.Value;
-  }
-  queued /= CoinInfo_.ExtraMultiplier;
+  userBalance = TotalBalance_ / CoinInfo_.ExtraMultiplier;
+  requestedInBalance = TotalRequested_;
+  requestedInQueue = _payoutQueue.totalValue();
+  confirmationWait = _payoutQueue.statusAmount(PayoutDbRecord::ETxSent);
+  queued = TotalQueued_ / CoinInfo_.ExtraMultiplier;
 
   net = balance + immature - userBalance - queued + confirmationWait;
 
@@ -1076,13 +1554,15 @@ bool AccountingDb::requestPayout(const std::string &address, int64_t value, bool
 
   UserBalanceRecord &balance = It->second;
   balance.Balance.add(value);
+  TotalBalance_ += value;
 
   UserSettingsRecord settings;
   bool hasSettings = UserManager_.getUserCoinSettings(balance.Login, CoinInfo_.Name, settings);
   int64_t nonQueuedBalance = balance.Balance.getRational(CoinInfo_.ExtraMultiplier) - balance.Requested;
   if (hasSettings && (force || (settings.AutoPayout && nonQueuedBalance >= settings.MinimalPayout))) {
-    _payoutQueue.push_back(PayoutDbRecord(address, nonQueuedBalance));
+    _payoutQueue.push(PayoutDbRecord(address, nonQueuedBalance));
     balance.Requested += nonQueuedBalance;
+    TotalRequested_ += nonQueuedBalance;
     result = true;
   }
 
@@ -1115,23 +1595,55 @@ void AccountingDb::manualPayoutImpl(const std::string &user, DefaultCb callback)
   }
 }
 
+bool AccountingDb::queryCachedFoundBlocks(const CFoundBlocksSnapshot *data, int64_t heightFrom, const std::string &hashFrom, uint32_t count, std::vector<FoundBlockRecord> &foundBlocks, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &confirmationsQuery)
+{
+  if (!data)
+    return true;
+
+  // Page starts before (heightFrom, hashFrom) in descending order
+  const std::vector<CFoundBlock> &blocks = data->Blocks;
+  auto endIt = blocks.end();
+  if (heightFrom != -1) {
+    uint64_t height = static_cast<uint64_t>(heightFrom);
+    endIt = std::lower_bound(blocks.begin(), blocks.end(), hashFrom, [height](const CFoundBlock &block, const std::string &hash) -> bool {
+      return block.Record.Height < height || (block.Record.Height == height && block.Record.Hash < hash);
+    });
+  }
+
+  for (auto It = endIt; It != blocks.begin() && foundBlocks.size() < count; ) {
+    --It;
+    foundBlocks.push_back(It->Record);
+    confirmationsQuery.emplace_back(It->Record.Hash, It->Record.Height).Confirmations = It->Confirmations;
+  }
+
+  return foundBlocks.size() == count || !data->Truncated;
+}
+
 void AccountingDb::queryFoundBlocksImpl(int64_t heightFrom, const std::string &hashFrom, uint32_t count, QueryFoundBlocksCallback callback)
 {
+  intrusive_ptr<CFoundBlocksSnapshot> snapshot(FoundBlocksSnapshot_);
+  std::vector<CNetworkClient::GetBlockConfirmationsQuery> confirmationsQuery;
+  std::vector<FoundBlockRecord> foundBlocks;
+  if (queryCachedFoundBlocks(snapshot.get(), heightFrom, hashFrom, count, foundBlocks, confirmationsQuery)) {
+    callback(foundBlocks, confirmationsQuery);
+    return;
+  }
+
+  // Rest of page is older than index, read it from database and query confirmations
   auto &db = getFoundBlocksDb();
   std::unique_ptr<rocksdbBase::IteratorType> It(db.iterator());
-  if (heightFrom != -1) {
+  if (!foundBlocks.empty() || heightFrom != -1) {
     FoundBlockRecord blk;
-    blk.Height = heightFrom;
-    blk.Hash = hashFrom;
+    blk.Height = !foundBlocks.empty() ? foundBlocks.back().Height : heightFrom;
+    blk.Hash = !foundBlocks.empty() ? foundBlocks.back().Hash : hashFrom;
     It->seek(blk);
     It->prev();
   } else {
     It->seekLast();
   }
 
-  std::vector<CNetworkClient::GetBlockConfirmationsQuery> confirmationsQuery;
-  std::vector<FoundBlockRecord> foundBlocks;
-  for (unsigned i = 0; i < count && It->valid(); i++) {
+  std::vector<CNetworkClient::GetBlockConfirmationsQuery> historyQuery;
+  while (foundBlocks.size() < count && It->valid()) {
     FoundBlockRecord dbBlock;
     RawData data = It->value();
     if (!dbBlock.deserializeValue(data.data, data.size))
@@ -1143,79 +1655,56 @@ void AccountingDb::queryFoundBlocksImpl(int64_t heightFrom, const std::string &h
       dbBlock.FoundBy = credentials.Name;
 
     foundBlocks.push_back(dbBlock);
-    confirmationsQuery.emplace_back(dbBlock.Hash, dbBlock.Height);
+    historyQuery.emplace_back(dbBlock.Hash, dbBlock.Height);
     It->prev();
   }
 
-  // query confirmations
-  if (count)
-    ClientDispatcher_.ioGetBlockConfirmations(Base_, _cfg.RequiredConfirmations, confirmationsQuery);
-
+  if (!historyQuery.empty())
+    ClientDispatcher_.ioGetBlockConfirmations(Base_, _cfg.RequiredConfirmations, historyQuery);
+  confirmationsQuery.insert(confirmationsQuery.end(), historyQuery.begin(), historyQuery.end());
   callback(foundBlocks, confirmationsQuery);
 }
 
 void AccountingDb::poolLuckImpl(const std::vector<int64_t> &intervals, PoolLuckCallback callback)
 {
+  poolLuckImpl(intervals, CurrentRoundWork_, callback);
+}
+
+void AccountingDb::poolLuckImpl(const std::vector<int64_t> &intervals, double acceptedWork, PoolLuckCallback callback)
+{
+  // Uses only published snapshot, can be called from any thread
   int64_t currentTime = time(nullptr);
   std::vector<double> result;
-
-  auto &db = getFoundBlocksDb();
-  std::unique_ptr<rocksdbBase::IteratorType> It(db.iterator());
-  It->seekLast();
-
-  auto intervalIt = intervals.begin();
-  if (intervalIt == intervals.end()) {
-    callback(result);
-    return;
-  }
-
-  double acceptedWork = 0.0;
-  double expectedWork = 0.0;
-  for (const auto &score: CurrentScores_)
-    acceptedWork += score.second;
-
-  int64_t currentTimePoint = currentTime - *intervalIt;
-  while (It->valid()) {
-    FoundBlockRecord dbBlock;
-    RawData data = It->value();
-    if (!dbBlock.deserializeValue(data.data, data.size))
-      break;
-
-    while (dbBlock.Time < currentTimePoint) {
-      result.push_back(expectedWork != 0.0 ? acceptedWork / expectedWork : 0.0);
-      if (++intervalIt == intervals.end()) {
-        callback(result);
-        return;
+  intrusive_ptr<CFoundBlocksSnapshot> snapshot(FoundBlocksSnapshot_);
+  const CFoundBlocksSnapshot *data = snapshot.get();
+  for (int64_t interval: intervals) {
+    double intervalAcceptedWork = acceptedWork;
+    double intervalExpectedWork = 0.0;
+    if (data && data->LuckSize) {
+      // Work of blocks found in interval is difference of prefix sums
+      const CLuckPoint *begin = data->Luck->Points.get();
+      const CLuckPoint *end = begin + data->LuckSize;
+      const CLuckPoint *It = std::lower_bound(begin, end, currentTime - interval, [](const CLuckPoint &point, int64_t value) { return point.Time < value; });
+      if (It != end) {
+        double acceptedBefore = It != begin ? std::prev(It)->AccumulatedWorkSum : 0.0;
+        double expectedBefore = It != begin ? std::prev(It)->ExpectedWorkSum : 0.0;
+        intervalAcceptedWork += std::prev(end)->AccumulatedWorkSum - acceptedBefore;
+        intervalExpectedWork = std::prev(end)->ExpectedWorkSum - expectedBefore;
       }
-
-      currentTimePoint = currentTime - *intervalIt;
     }
 
-    if (dbBlock.ExpectedWork != 0.0) {
-      acceptedWork += dbBlock.AccumulatedWork;
-      expectedWork += dbBlock.ExpectedWork;
-    }
-
-    It->prev();
+    result.push_back(intervalExpectedWork != 0.0 ? intervalAcceptedWork / intervalExpectedWork : 0.0);
   }
 
-  while (intervalIt++ != intervals.end())
-    result.push_back(expectedWork != 0.0 ? acceptedWork / expectedWork : 0.0);
   callback(result);
 }
 
 void AccountingDb::queryBalanceImpl(const std::string &user, QueryBalanceCallback callback)
 {
   UserBalanceInfo info;
-
-  // Calculate queued balance
-  info.Queued = 0;
-  for (const auto &It: UnpayedRounds_) {
-    auto payout = std::lower_bound(It->Payouts.begin(), It->Payouts.end(), user, [](const PayoutDbRecord &record, const std::string &user) -> bool { return record.UserId < user; });
-    if (payout != It->Payouts.end() && payout->UserId == user)
-      info.Queued += payout->Value;
-  }
-  info.Queued /= CoinInfo_.ExtraMultiplier;
+  auto queuedIt = QueuedBalance_.find(user);
+  if (queuedIt != QueuedBalance_.end())
+    info.Queued = queuedIt->second / CoinInfo_.ExtraMultiplier;
 
   auto &balanceMap = getUserBalanceMap();
   auto It = balanceMap.find(user);
@@ -1231,3 +1720,56 @@ void AccountingDb::queryBalanceImpl(const std::string &user, QueryBalanceCallbac
 
   callback(info);
 }
+
+void AccountingDb::queryFoundBlocks(int64_t heightFrom, const std::string &hashFrom, uint32_t count, QueryFoundBlocksCallback callback)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskQueryFoundBlocks(heightFrom, hashFrom, count, callback));
+    return;
+  }
+
+  QueryThreadPool_->startAsyncCall([this, heightFrom, hashFrom, count, callback]() {
+    // Recent pages served from published snapshot, older ones need database and nodes (backend thread)
+    intrusive_ptr<CFoundBlocksSnapshot> snapshot(FoundBlocksSnapshot_);
+    std::vector<CNetworkClient::GetBlockConfirmationsQuery> confirmationsQuery;
+    std::vector<FoundBlockRecord> foundBlocks;
+    if (queryCachedFoundBlocks(snapshot.get(), heightFrom, hashFrom, count, foundBlocks, confirmationsQuery))
+      callback(foundBlocks, confirmationsQuery);
+    else
+      TaskHandler_.push(new TaskQueryFoundBlocks(heightFrom, hashFrom, count, callback));
+  });
+}
+
+void AccountingDb::queryUserBalance(const std::string &user, QueryBalanceCallback callback)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskQueryBalance(user, callback));
+    return;
+  }
+
+  QueryThreadPool_->startAsyncCall([this, user, callback]() {
+    UserBalanceInfo info;
+    info.Data = UserBalanceRecord(user, 0);
+    intrusive_ptr<CQuerySnapshot> snapshot(QuerySnapshot_);
+    if (const CQuerySnapshot *data = snapshot.get()) {
+      auto It = data->Balances.find(user);
+      if (It != data->Balances.end())
+        info = It->second;
+    }
+
+    callback(info);
+  });
+}
+
+void AccountingDb::poolLuck(std::vector<int64_t> &&intervals, PoolLuckCallback callback)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskPoolLuck(std::move(intervals), callback));
+    return;
+  }
+
+  QueryThreadPool_->startAsyncCall([this, intervals = std::move(intervals), callback]() {
+    intrusive_ptr<CQuerySnapshot> snapshot(QuerySnapshot_);
+    poolLuckImpl(intervals, snapshot.get() ? snapshot.get()->AcceptedWork : 0.0, callback);
+  });
+}
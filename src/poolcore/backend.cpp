@@ -12,11 +12,10 @@ static void checkConsistency(AccountingDb *accounting)
   std::map<std::string, int64_t> balancesRequested;
   std::map<std::string, int64_t> queueRequested;
 
-  int64_t totalQueued = 0;
-  for (auto &p: accounting->getPayoutsQueue()) {
-    queueRequested[p.UserId] += p.Value;
-    totalQueued += p.Value;
-  }
+  auto &payoutQueue = accounting->getPayoutsQueue();
+  int64_t totalQueued = payoutQueue.totalValue();
+  for (const auto &p: payoutQueue.users())
+    queueRequested[p.first] = p.second.Value;
 
   int64_t totalInBalance = 0;
   auto &balanceDb = accounting->getBalanceDb();
@@ -47,9 +46,16 @@ PoolBackend::PoolBackend(asyncBase *base, const PoolBackendConfig &cfg, const CC
   CheckBalanceEvent_ = newUserEvent(base, 1, nullptr, nullptr);
   clientDispatcher.setBackend(this);
   _timeout = 8*1000000;
+  TaskHandler_.setQueueDepthGauge(&metricGauge("pool_task_queue_depth", "Tasks waiting in task handler queue", metricLabels("coin", CoinInfo_.Name, "handler", "backend")));
+  SharesMetric_ = &metricCounter("pool_backend_shares_total", "Shares processed by backend", metricLabel("coin", CoinInfo_.Name));
 
   _statistics.reset(new StatisticDb(_base, _cfg, CoinInfo_));
   _accounting.reset(new AccountingDb(_base, _cfg, CoinInfo_, UserMgr_, ClientDispatcher_, *_statistics.get()));
+  if (_cfg.QueryThreadsNum) {
+    QueryThreadPool_.reset(new CThreadPool(_cfg.QueryThreadsNum));
+    _statistics->setQueryThreadPool(QueryThreadPool_.get());
+    _accounting->setQueryThreadPool(QueryThreadPool_.get());
+  }
 
   ShareLogConfig shareLogConfig(_accounting.get(), _statistics.get());
   ShareLog_.init(cfg.dbPath / "shares.log.v1", cfg.dbPath / "shares.log", info.Name, _base, _cfg.ShareLogFlushInterval, _cfg.ShareLogFileSizeLimit, shareLogConfig);
@@ -63,6 +69,8 @@ PoolBackend::PoolBackend(asyncBase *base, const PoolBackendConfig &cfg, const CC
 
 void PoolBackend::start()
 {
+  if (QueryThreadPool_)
+    QueryThreadPool_->start();
   _thread = std::thread([](PoolBackend *backend){ backend->backendMain(); }, this);
 }
 
@@ -81,6 +89,8 @@ void PoolBackend::stop()
 
   postQuitOperation(_base);
   _thread.join();
+  if (QueryThreadPool_)
+    QueryThreadPool_->stop();
   ShareLog_.flush();
 }
 
@@ -88,6 +98,9 @@ void PoolBackend::backendMain()
 {
   InitializeWorkerThread();
   loguru::set_thread_name(CoinInfo_.Name.c_str());
+  if (!SetCurrentThreadAffinity(_cfg.BackendCpus))
+    LOG_F(WARNING, "%s: can't set backend thread affinity", CoinInfo_.Name.c_str());
+  ReportThreadTopology((CoinInfo_.Name + " backend").c_str());
   ShareLog_.start();
 
   TaskHandler_.start();
@@ -142,6 +155,7 @@ void PoolBackend::checkBalanceHandler()
 
 void PoolBackend::onShare(CShare *share)
 {
+  SharesMetric_->add();
   ShareLog_.addShare(*share);
   _statistics->addShare(*share, true, true);
   _accounting->addShare(*share);
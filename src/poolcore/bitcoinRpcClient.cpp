@@ -3,6 +3,7 @@
 #include "poolcore/blockTemplate.h"
 #include "poolcore/clientDispatcher.h"
 #include "poolcommon/arith_uint256.h"
+#include "poolcommon/crc32.h"
 #include "poolcommon/jsonSerializer.h"
 #include "poolcommon/utils.h"
 #include "asyncio/asyncio.h"
@@ -94,6 +95,34 @@ static void buildPostQuery(const char *data, size_t size, const std::string &hos
     out.write(data, size);
 }
 
+// Checksum of fields affecting mining work: time fields (curtime, mintime) excluded, they changed every second
+// Transactions identified by txid (hash or raw data for old nodes)
+static uint32_t blockTemplateContentHash(const rapidjson::Value &resultObject)
+{
+  uint32_t hash = 0;
+  for (const char *name: {"previousblockhash", "bits", "mweb"}) {
+    if (resultObject.HasMember(name) && resultObject[name].IsString())
+      hash = crc32c(hash, resultObject[name].GetString(), resultObject[name].GetStringLength());
+  }
+
+  if (resultObject.HasMember("coinbasevalue") && resultObject["coinbasevalue"].IsInt64()) {
+    int64_t coinbaseValue = resultObject["coinbasevalue"].GetInt64();
+    hash = crc32c(hash, &coinbaseValue, sizeof(coinbaseValue));
+  }
+
+  if (resultObject.HasMember("transactions") && resultObject["transactions"].IsArray()) {
+    for (const auto &tx: resultObject["transactions"].GetArray()) {
+      if (!tx.IsObject())
+        continue;
+      const char *idField = tx.HasMember("txid") ? "txid" : tx.HasMember("hash") ? "hash" : "data";
+      if (tx.HasMember(idField) && tx[idField].IsString())
+        hash = crc32c(hash, tx[idField].GetString(), tx[idField].GetStringLength());
+    }
+  }
+
+  return hash ? hash : 1;
+}
+
 static std::string buildGetBlockTemplate(const std::string &longPollId, bool segwitEnabled, bool mwebEnabled)
 {
   char buffer[2048];
@@ -212,6 +241,40 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::signRawTransaction(CConnecti
   return EStatusOk;
 }
 
+CNetworkClient::EOperationStatus CBitcoinRpcClient::decodeRawTransaction(CConnection *connection, const std::string &transaction, std::string &txId, std::string &error)
+{
+  xmstream postData;
+  {
+    JSON::Object object(postData);
+    object.addString("method", "decoderawtransaction");
+    object.addField("params");
+    {
+      JSON::Array params(postData);
+      params.addString(transaction);
+    }
+  }
+
+  {
+    rapidjson::Document document;
+    CNetworkClient::EOperationStatus status = ioQueryJson(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
+    if (status != CNetworkClient::EStatusOk) {
+      error = connection->LastError;
+      return status;
+    }
+
+    if (!document.HasMember("result") || !document["result"].IsObject())
+      return CNetworkClient::EStatusProtocolError;
+
+    rapidjson::Value &decodeResult = document["result"];
+    if (!decodeResult.HasMember("txid") || !decodeResult["txid"].IsString())
+      return CNetworkClient::EStatusProtocolError;
+
+    txId = decodeResult["txid"].GetString();
+  }
+
+  return EStatusOk;
+}
+
 CBitcoinRpcClient::CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const CCoinInfo &coinInfo, const char *address, const char *login, const char *password, bool longPollEnabled) :
   CNetworkClient(threadsNum),
   WorkFetcherBase_(base), ThreadsNum_(threadsNum), CoinInfo_(coinInfo), HasLongPoll_(longPollEnabled)
@@ -262,6 +325,8 @@ CBitcoinRpcClient::CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const
   }
 
   FullHostName_ = HostName_ + ":" + std::to_string(port);
+  RequestTime_ = &metricHistogram("pool_rpc_request_seconds", "Node RPC round trip time", metricLabels("coin", coinInfo.Name, "node", FullHostName_));
+  RequestErrors_ = &metricCounter("pool_rpc_errors_total", "Node RPC network errors and timeouts", metricLabels("coin", coinInfo.Name, "node", FullHostName_));
 
   std::string basicAuth = login;
   basicAuth.push_back(':');
@@ -541,14 +606,46 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildTransaction(asyncBase
   }
 
   // get transaction id
-  postData.reset();
+  return decodeRawTransaction(connection.get(), result.TxData, result.TxId, result.Error);
+}
+
+CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildBatchTransaction(asyncBase *base, const std::vector<TransactionOutput> &outputs, const std::string &changeAddress, BuildTransactionResult &result)
+{
+  // Without fundrawtransaction options we can't subtract fee from outputs
+  if (!CoinInfo_.HasExtendedFundRawTransaction)
+    return CNetworkClient::EStatusMethodNotFound;
+
+  std::unique_ptr<CConnection> connection(getConnection(base));
+  if (!connection)
+    return CNetworkClient::EStatusNetworkError;
+  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
+    return CNetworkClient::EStatusNetworkError;
+
+  std::string rawTransaction;
+  std::string fundedTransaction;
+
+  // createrawtransaction
+  result.Value = 0;
+  xmstream postData;
   {
     JSON::Object object(postData);
-    object.addString("method", "decoderawtransaction");
+    object.addString("method", "createrawtransaction");
     object.addField("params");
     {
       JSON::Array params(postData);
-      params.addString(result.TxData);
+      params.addField();
+      {
+        JSON::Array inputs(postData);
+      }
+
+      params.addField();
+      {
+        JSON::Object outputsObject(postData);
+        for (const auto &output: outputs) {
+          outputsObject.addCustom(output.Address.c_str(), FormatMoney(output.Value, CoinInfo_.RationalPartSize));
+          result.Value += output.Value;
+        }
+      }
     }
   }
 
@@ -559,18 +656,72 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildTransaction(asyncBase
       result.Error = connection->LastError;
       return status;
     }
+    if (!document.HasMember("result") || !document["result"].IsString())
+      return CNetworkClient::EStatusProtocolError;
+    rawTransaction = document["result"].GetString();
+  }
+
+  // fundrawtransaction, fee shared between all outputs
+  postData.reset();
+  {
+    JSON::Object object(postData);
+    object.addString("method", "fundrawtransaction");
+    object.addField("params");
+    {
+      JSON::Array params(postData);
+      params.addString(rawTransaction);
+      params.addField();
+      {
+        JSON::Object options(postData);
+        options.addString("changeAddress", changeAddress);
+        options.addField("subtractFeeFromOutputs");
+        {
+          JSON::Array subtractFeeFromOutputs(postData);
+          for (size_t i = 0, ie = outputs.size(); i != ie; ++i)
+            subtractFeeFromOutputs.addInt(i);
+        }
+      }
+    }
+  }
+
+  {
+    rapidjson::Document document;
+    CNetworkClient::EOperationStatus status = ioQueryJson<rapidjson::kParseNumbersAsStringsFlag>(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
+    if (status != CNetworkClient::EStatusOk) {
+      static constexpr int RPC_WALLET_INSUFFICIENT_FUNDS = -6;
+      result.Error = connection->LastError;
+      return connection->LastErrorCode == RPC_WALLET_INSUFFICIENT_FUNDS ? EStatusInsufficientFunds : status;
+    }
 
     if (!document.HasMember("result") || !document["result"].IsObject())
       return CNetworkClient::EStatusProtocolError;
 
-    rapidjson::Value &decodeResult = document["result"];
-    if (!decodeResult.HasMember("txid") || !decodeResult["txid"].IsString())
+    rapidjson::Value &fundTxResult = document["result"];
+    if (!fundTxResult.HasMember("hex") || !fundTxResult["hex"].IsString() ||
+        !fundTxResult.HasMember("fee") || !fundTxResult["fee"].IsString())
+      return CNetworkClient::EStatusProtocolError;
+
+    fundedTransaction = fundTxResult["hex"].GetString();
+    if (!parseMoneyValue(fundTxResult["fee"].GetString(), CoinInfo_.RationalPartSize, &result.Fee))
       return CNetworkClient::EStatusProtocolError;
+  }
 
-    result.TxId = decodeResult["txid"].GetString();
+  // Fee already included into output values
+  result.Value -= result.Fee;
+  if (result.Value <= 0) {
+    result.Error = "too big fee";
+    return CNetworkClient::EStatusUnknownError;
   }
 
-  return EStatusOk;
+  // signrawtransaction
+  {
+    EOperationStatus status = signRawTransaction(connection.get(), fundedTransaction, result.TxData, result.Error);
+    if (status != EStatusOk)
+      return status;
+  }
+
+  // get transaction id
+  return decodeRawTransaction(connection.get(), result.TxData, result.TxId, result.Error);
 }
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioSendTransaction(asyncBase *base, const std::string &txData, const std::string&, std::string &error)
@@ -836,7 +987,6 @@ void CBitcoinRpcClient::poll()
   WorkFetcher_.Client = httpClientNew(WorkFetcherBase_, object);
   WorkFetcher_.LongPollId = HasLongPoll_ ? "0000000000000000000000000000000000000000000000000000000000000000" : "";
   WorkFetcher_.WorkId = 0;
-  WorkFetcher_.LastTemplateTime = std::chrono::time_point<std::chrono::steady_clock>::min();
   dynamicBufferClear(&WorkFetcher_.ParseCtx.buffer);
 
   aioHttpConnect(WorkFetcher_.Client, &Address_, nullptr, 3000000, [](AsyncOpStatus status, HTTPClient*, void *arg){
@@ -890,8 +1040,6 @@ void CBitcoinRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
     return;
   }
 
-  auto now = std::chrono::steady_clock::now();
-
   int64_t height = 0;
   std::string prevBlockHash;
   std::string bits;
@@ -917,6 +1065,7 @@ void CBitcoinRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
 
   // Get unique work id
   uint64_t workId = blockTemplate->UniqueWorkId = readHexBE<uint64_t>(prevBlockHash.c_str(), 16);
+  blockTemplate->ContentHash = blockTemplateContentHash(resultObject);
 
   arith_uint256 powLimit = UintToArith256(CoinInfo_.PowLimit);
   arith_uint256 target;
@@ -927,23 +1076,11 @@ void CBitcoinRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
 //  double difficulty = BTC::getDifficulty(strtoul(bits.c_str(), nullptr, 16)) * 4294967296.0 / CoinInfo_.WorkMultiplier;
   blockTemplate->Difficulty = difficulty;
 
-  // Check new work available
-  if (!WorkFetcher_.LongPollId.empty()) {
-    // With long polling enabled now we check time since last response
-    uint64_t timeInterval = std::chrono::duration_cast<std::chrono::seconds>(now - WorkFetcher_.LastTemplateTime).count();
-    if (timeInterval) {
-      LOG_F(INFO, "%s: new work available; previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), difficulty);
-      Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
-    }
-  } else {
-    // Without long polling we send new task to miner on new block found
-    if (WorkFetcher_.WorkId != workId) {
-      LOG_F(INFO, "%s: new work available; previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), difficulty);
-      Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
-    }
-  }
+  // Dispatcher decides when to send template to miners: new block immediately, updates coalesced
+  if (WorkFetcher_.WorkId != workId)
+    LOG_F(INFO, "%s: new work available; previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), difficulty);
+  Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
 
-  WorkFetcher_.LastTemplateTime = now;
   WorkFetcher_.WorkId = workId;
 
   // Send next request
@@ -1,8 +1,10 @@
 #include "poolcore/clientDispatcher.h"
 
+#include "poolcore/backend.h"
 #include "poolcore/blockTemplate.h"
 #include "poolcore/thread.h"
 #include "loguru.hpp"
+#include <algorithm>
 
 bool CNetworkClientDispatcher::ioGetBalance(asyncBase *base, CNetworkClient::GetBalanceResult &result)
 {
@@ -17,30 +19,143 @@ bool CNetworkClientDispatcher::ioGetBalance(asyncBase *base, CNetworkClient::Get
   return false;
 }
 
-bool CNetworkClientDispatcher::ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query)
+// Parallel request to all RPC clients
+// State shared between caller and per-client coroutines, caller can return before all clients answered
+template<typename QueryTy>
+struct CParallelQuery {
+  asyncBase *Base;
+  int64_t OrphanAgeLimit;
+  aioUserEvent *Event;
+  std::vector<std::vector<QueryTy>> Answers;
+  std::vector<bool> Valid;
+  size_t Running = 0;
+  size_t ValidNum = 0;
+  bool Waiting = true;
+
+  ~CParallelQuery() { deleteUserEvent(Event); }
+};
+
+template<typename QueryTy>
+struct CParallelQueryCall {
+  std::shared_ptr<CParallelQuery<QueryTy>> State;
+  CNetworkClient *Client;
+  size_t Index;
+};
+
+static bool ioQueryClient(CNetworkClient *client, asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query)
 {
-  unsigned threadId = GetGlobalThreadId();
-  size_t &currentClientIdx = CurrentClientIdx_[threadId];
-  for (size_t i = 0, ie = RPCClients_.size(); i != ie; ++i) {
-    if (RPCClients_[currentClientIdx]->ioGetBlockConfirmations(base, orphanAgeLimit, query))
-      return true;
-    currentClientIdx = (currentClientIdx + 1) % RPCClients_.size();
+  return client->ioGetBlockConfirmations(base, orphanAgeLimit, query);
+}
+
+static bool ioQueryClient(CNetworkClient *client, asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query)
+{
+  return client->ioGetBlockExtraInfo(base, orphanAgeLimit, query);
+}
+
+// Sends query to all clients at once, waits for 'quorum' valid answers (or for all clients finished)
+template<typename QueryTy>
+static size_t ioParallelQuery(asyncBase *base,
+                              std::vector<std::unique_ptr<CNetworkClient>> &clients,
+                              int64_t orphanAgeLimit,
+                              size_t quorum,
+                              const std::vector<QueryTy> &query,
+                              std::vector<std::vector<QueryTy>> &answers)
+{
+  auto state = std::make_shared<CParallelQuery<QueryTy>>();
+  state->Base = base;
+  state->OrphanAgeLimit = orphanAgeLimit;
+  state->Event = newUserEvent(base, 0, nullptr, nullptr);
+  state->Answers.assign(clients.size(), query);
+  state->Valid.assign(clients.size(), false);
+  state->Running = clients.size();
+
+  for (size_t i = 0, ie = clients.size(); i != ie; ++i) {
+    coroutineCall(coroutineNew([](void *arg) {
+      std::unique_ptr<CParallelQueryCall<QueryTy>> call(static_cast<CParallelQueryCall<QueryTy>*>(arg));
+      CParallelQuery<QueryTy> &state = *call->State;
+      bool valid = ioQueryClient(call->Client, state.Base, state.OrphanAgeLimit, state.Answers[call->Index]);
+      state.Valid[call->Index] = valid;
+      state.ValidNum += valid;
+      state.Running--;
+      if (state.Waiting)
+        userEventActivate(state.Event);
+    }, new CParallelQueryCall<QueryTy>{state, clients[i].get(), i}, 0x20000));
   }
 
-  return false;
+  quorum = std::min(std::max(quorum, static_cast<size_t>(1)), clients.size());
+  while (state->ValidNum < quorum && state->Running)
+    ioWaitUserEvent(state->Event);
+  state->Waiting = false;
+
+  answers.clear();
+  for (size_t i = 0, ie = clients.size(); i != ie; ++i) {
+    if (state->Valid[i])
+      answers.emplace_back(std::move(state->Answers[i]));
+  }
+
+  return answers.size();
 }
 
-bool CNetworkClientDispatcher::ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query)
+// Confirmations merge rule: orphan only if all nodes agree, otherwise minimal confirmations number;
+// any disagreement about block status means 'unknown' (-2) and block will be checked again
+static int64_t mergeConfirmations(int64_t merged, int64_t confirmations)
 {
-  unsigned threadId = GetGlobalThreadId();
-  size_t &currentClientIdx = CurrentClientIdx_[threadId];
-  for (size_t i = 0, ie = RPCClients_.size(); i != ie; ++i) {
-    if (RPCClients_[currentClientIdx]->ioGetBlockExtraInfo(base, orphanAgeLimit, query))
-      return true;
-    currentClientIdx = (currentClientIdx + 1) % RPCClients_.size();
+  if (merged == confirmations)
+    return merged;
+  if (merged < 0 || confirmations < 0)
+    return -2;
+  return std::min(merged, confirmations);
+}
+
+bool CNetworkClientDispatcher::ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query, unsigned quorum, unsigned *respondedNodes)
+{
+  std::vector<std::vector<CNetworkClient::GetBlockConfirmationsQuery>> answers;
+  size_t answersNum = ioParallelQuery(base, RPCClients_, orphanAgeLimit, quorum, query, answers);
+  if (respondedNodes)
+    *respondedNodes = static_cast<unsigned>(answersNum);
+  if (!answersNum) {
+    for (auto &It: query)
+      It.Confirmations = -2;
+    return false;
   }
 
-  return false;
+  query = std::move(answers[0]);
+  for (size_t i = 1; i < answersNum; i++) {
+    for (size_t j = 0, je = query.size(); j != je; ++j)
+      query[j].Confirmations = mergeConfirmations(query[j].Confirmations, answers[i][j].Confirmations);
+  }
+
+  return true;
+}
+
+bool CNetworkClientDispatcher::ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query, unsigned quorum, unsigned *respondedNodes)
+{
+  std::vector<CNetworkClient::GetBlockExtraInfoQuery> source = query;
+  std::vector<std::vector<CNetworkClient::GetBlockExtraInfoQuery>> answers;
+  size_t answersNum = ioParallelQuery(base, RPCClients_, orphanAgeLimit, quorum, query, answers);
+  if (respondedNodes)
+    *respondedNodes = static_cast<unsigned>(answersNum);
+  if (!answersNum) {
+    for (auto &It: query)
+      It.Confirmations = -2;
+    return false;
+  }
+
+  query = std::move(answers[0]);
+  for (size_t i = 1; i < answersNum; i++) {
+    for (size_t j = 0, je = query.size(); j != je; ++j) {
+      const auto &answer = answers[i][j];
+      query[j].Confirmations = mergeConfirmations(query[j].Confirmations, answer.Confirmations);
+      if (query[j].BlockReward != answer.BlockReward || query[j].TxFee != answer.TxFee) {
+        // Nodes disagree about reward, keep last known values
+        query[j].BlockReward = source[j].BlockReward;
+        query[j].TxFee = source[j].TxFee;
+        query[j].Confirmations = -2;
+      }
+    }
+  }
+
+  return true;
 }
 
 CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioListUnspent(asyncBase *base, CNetworkClient::ListUnspentResult &result)
@@ -73,6 +188,21 @@ CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioBuildTransaction(as
   return status;
 }
 
+CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioBuildBatchTransaction(asyncBase *base, const std::vector<CNetworkClient::TransactionOutput> &outputs, const std::string &changeAddress, CNetworkClient::BuildTransactionResult &result)
+{
+  CNetworkClient::EOperationStatus status = CNetworkClient::EStatusUnknownError;
+  unsigned threadId = GetGlobalThreadId();
+  size_t &currentClientIdx = CurrentClientIdx_[threadId];
+  for (size_t i = 0, ie = RPCClients_.size(); i != ie; ++i) {
+    status = RPCClients_[currentClientIdx]->ioBuildBatchTransaction(base, outputs, changeAddress, result);
+    if (status == CNetworkClient::EStatusOk)
+      return CNetworkClient::EStatusOk;
+    currentClientIdx = (currentClientIdx + 1) % RPCClients_.size();
+  }
+
+  return status;
+}
+
 CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error)
 {
   CNetworkClient::EOperationStatus status = CNetworkClient::EStatusUnknownError;
@@ -178,36 +308,103 @@ void CNetworkClientDispatcher::onWorkFetchReconnectTimer()
     }
   }
 
-  CurrentWorkFetcherIdx = (CurrentWorkFetcherIdx + 1) % GetWorkClients_.size();
   GetWorkClients_[CurrentWorkFetcherIdx]->poll();
 }
 
-void CNetworkClientDispatcher::onWorkFetcherConnectionError()
+void CNetworkClientDispatcher::retryWorkFetch(uint64_t baseDelay)
 {
   if (WorkState_ == EWorkOk) {
     WorkState_ = EWorkLost;
     ConnectionLostTime_ = std::chrono::steady_clock::now();
   }
 
+  // Switch to next node, delay grows with sequential errors of this node (healthy node retried after base delay)
+  WorkFetcherErrors_[CurrentWorkFetcherIdx]++;
+  CurrentWorkFetcherIdx = (CurrentWorkFetcherIdx + 1) % GetWorkClients_.size();
+  unsigned errors = std::min(WorkFetcherErrors_[CurrentWorkFetcherIdx], 16u);
+  uint64_t limit = std::chrono::duration_cast<std::chrono::microseconds>(Backend_->getConfig().WorkFetchBackoffLimit).count();
+  uint64_t delay = std::max(baseDelay, std::min(baseDelay << errors, limit));
+  userEventStartTimer(WorkFetcherReconnectTimer_, delay, 1);
+}
+
+void CNetworkClientDispatcher::onWorkFetcherConnectionError()
+{
   // 500 milliseconds
-  userEventStartTimer(WorkFetcherReconnectTimer_, 500000, 1);
+  retryWorkFetch(500000);
 }
 
 void CNetworkClientDispatcher::onWorkFetcherConnectionLost()
 {
-  if (WorkState_ == EWorkOk) {
-    WorkState_ = EWorkLost;
-    ConnectionLostTime_ = std::chrono::steady_clock::now();
-  }
-
   // 100 milliseconds
-  userEventStartTimer(WorkFetcherReconnectTimer_, 100000, 1);
+  retryWorkFetch(100000);
 }
 
 void CNetworkClientDispatcher::onWorkFetcherNewWork(CBlockTemplate *blockTemplate)
 {
-  WorkState_ = EWorkOk;
   intrusive_ptr<CBlockTemplate> holder(blockTemplate);
+  WorkFetcherErrors_[CurrentWorkFetcherIdx] = 0;
+
+  // Always push work after connection loss (miners can be stopped)
+  if (WorkState_ == EWorkOk && HasWork_ && blockTemplate->UniqueWorkId == LastWorkId_) {
+    // Same block: skip duplicates and coalesce updates within refresh interval
+    if (blockTemplate->ContentHash && blockTemplate->ContentHash == LastContentHash_) {
+      // Latest state already sent to miners, coalesced update not needed
+      intrusive_ptr<CBlockTemplate> pending(std::move(PendingWork_));
+      TemplatesDuplicate_->add();
+      return;
+    }
+
+    if (startWorkPushTimer()) {
+      TemplatesCoalesced_->add();
+      PendingWork_ = holder;
+      return;
+    }
+  }
+
+  WorkState_ = EWorkOk;
+  pushWork(blockTemplate);
+}
+
+bool CNetworkClientDispatcher::startWorkPushTimer()
+{
+  auto now = std::chrono::steady_clock::now();
+  auto pushTime = LastPushTime_ + Backend_->getConfig().WorkRefreshInterval;
+  if (now >= pushTime)
+    return false;
+
+  if (!WorkPushTimerActive_) {
+    userEventStartTimer(WorkPushTimer_, std::chrono::ceil<std::chrono::microseconds>(pushTime - now).count(), 1);
+    WorkPushTimerActive_ = true;
+  }
+  return true;
+}
+
+void CNetworkClientDispatcher::onWorkPushTimer()
+{
+  WorkPushTimerActive_ = false;
+  if (!PendingWork_.get() || WorkState_ != EWorkOk) {
+    intrusive_ptr<CBlockTemplate> pending(std::move(PendingWork_));
+    return;
+  }
+
+  // Timer was armed before pushWork flushed previous pending template: wait refresh interval from last push
+  if (startWorkPushTimer())
+    return;
+
+  intrusive_ptr<CBlockTemplate> pending(std::move(PendingWork_));
+  pushWork(pending.get());
+}
+
+void CNetworkClientDispatcher::pushWork(CBlockTemplate *blockTemplate)
+{
+  // Newer template replaces coalesced one; timer stays armed and re-arms itself if it fires before refresh interval
+  intrusive_ptr<CBlockTemplate> pending(std::move(PendingWork_));
+
+  HasWork_ = true;
+  LastWorkId_ = blockTemplate->UniqueWorkId;
+  LastContentHash_ = blockTemplate->ContentHash;
+  LastPushTime_ = std::chrono::steady_clock::now();
+  TemplatesPushed_->add();
   for (auto &instance : LinkedInstances_)
     instance->checkNewBlockTemplate(blockTemplate, Backend_);
 }
@@ -5,6 +5,7 @@
 #include "poolcore/backend.h"
 #include "poolcore/blockTemplate.h"
 #include "poolcore/clientDispatcher.h"
+#include "poolcommon/crc32.h"
 #include "poolcommon/jsonSerializer.h"
 #include "poolcommon/uint_str.h"
 #include "asyncio/asyncio.h"
@@ -107,6 +108,8 @@ CEthereumRpcClient::CEthereumRpcClient(asyncBase *base, unsigned threadsNum, con
   }
 
   FullHostName_ = HostName_ + ":" + std::to_string(port);
+  RequestTime_ = &metricHistogram("pool_rpc_request_seconds", "Node RPC round trip time", metricLabels("coin", coinInfo.Name, "node", FullHostName_));
+  RequestErrors_ = &metricCounter("pool_rpc_errors_total", "Node RPC network errors and timeouts", metricLabels("coin", coinInfo.Name, "node", FullHostName_));
 
   if (config.MiningAddresses.size() != 1) {
     LOG_F(ERROR, "ERROR: ethereum-based backends support working with only one mining address\n");
@@ -553,6 +556,8 @@ void CEthereumRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
     height = strtoul(resultValue[3].GetString()+2, nullptr, 16);
     // Use height as unique block identifier
     workId = height;
+    // Header hash changes with transactions set
+    blockTemplate->ContentHash = crc32c(0, resultValue[0].GetString(), resultValue[0].GetStringLength());
 
     // Check DAG presence
     int epochNumber = ethashGetEpochNumber(seedHash.begin());
@@ -574,13 +579,16 @@ void CEthereumRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
   }
 
   if (templateIsOk) {
+    blockTemplate->UniqueWorkId = workId;
     if (WorkFetcher_.WorkId != workId) {
-      Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
       WorkFetcher_.Height = height;
       WorkFetcher_.WorkId = workId;
       LOG_F(INFO, "%s: new work available; height: %" PRIu64 "; difficulty: %lf", CoinInfo_.Name.c_str(), height, difficulty);
     }
 
+    // Dispatcher decides when to send template to miners: new block immediately, updates coalesced
+    Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
+
     // Wait 100ms
     userEventStartTimer(WorkFetcher_.TimerEvent, 1*100000, 1);
   } else {
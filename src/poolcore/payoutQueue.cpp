@@ -0,0 +1,282 @@
+#include "poolcore/payoutQueue.h"
+#include "poolcommon/crc32.h"
+#include "poolcommon/serialize.h"
+#include "loguru.hpp"
+#include <errno.h>
+#include <string.h>
+
+static constexpr size_t JournalFrameHeaderSize = 8;
+static constexpr size_t JournalCompactMinSize = 1u << 20;
+
+bool CPayoutQueue::open(const std::filesystem::path &journalPath, const std::filesystem::path &legacyPath)
+{
+  Path_ = journalPath;
+  bool journalExists = std::filesystem::exists(journalPath);
+  if (!Fd_.open(journalPath)) {
+    LOG_F(ERROR, "can't open payouts journal %s (%s)", journalPath.u8string().c_str(), strerror(errno));
+    return false;
+  }
+
+  std::map<uint64_t, PayoutDbRecord> records;
+  if (journalExists) {
+    size_t fileSize = Fd_.size();
+    xmstream stream(fileSize);
+    if (Fd_.read(stream.reserve(fileSize), 0, fileSize) != static_cast<ssize_t>(fileSize)) {
+      LOG_F(ERROR, "can't read payouts journal %s", journalPath.u8string().c_str());
+      return false;
+    }
+
+    size_t validSize = 0;
+    stream.seekSet(0);
+    if (!replay(stream, records, &validSize)) {
+      // Torn write at the end of journal, drop incomplete frames
+      LOG_F(WARNING, "payouts journal %s: corrupted tail at offset %zu, truncating", journalPath.u8string().c_str(), validSize);
+      Fd_.truncate(validSize);
+    }
+
+    JournalSize_ = validSize;
+  } else {
+    // Import old style payouts file
+    FileDescriptor legacyFd;
+    if (std::filesystem::exists(legacyPath) && legacyFd.open(legacyPath)) {
+      size_t fileSize = legacyFd.size();
+      xmstream stream(fileSize);
+      legacyFd.read(stream.reserve(fileSize), 0, fileSize);
+      legacyFd.close();
+
+      uint64_t id = 0;
+      stream.seekSet(0);
+      while (stream.remaining()) {
+        PayoutDbRecord element;
+        if (!element.deserializeValue(stream))
+          break;
+        records[++id] = element;
+      }
+
+      LOG_F(INFO, "imported %zu payouts from %s", records.size(), legacyPath.u8string().c_str());
+    }
+  }
+
+  for (auto &It: records) {
+    iterator recordIt = Records_.insert(Records_.end(), std::move(It.second));
+    CEntry &entry = Entries_[&*recordIt];
+    entry.Id = It.first;
+    entry.It = recordIt;
+    indexAdd(entry, *recordIt);
+    LastId_ = std::max(LastId_, It.first);
+  }
+
+  LOG_F(INFO, "loaded %zu payouts from journal %s", Records_.size(), journalPath.u8string().c_str());
+  if (!journalExists || JournalSize_ >= JournalCompactMinSize)
+    return compact();
+
+  LiveSize_ = JournalSize_;
+  Fd_.seekSet(JournalSize_);
+  return true;
+}
+
+PayoutDbRecord &CPayoutQueue::push(const PayoutDbRecord &record)
+{
+  iterator recordIt = Records_.insert(Records_.end(), record);
+  CEntry &entry = Entries_[&*recordIt];
+  entry.Id = ++LastId_;
+  entry.It = recordIt;
+  indexAdd(entry, *recordIt);
+  Dirty_.insert(&*recordIt);
+  return *recordIt;
+}
+
+void CPayoutQueue::erase(PayoutDbRecord &record)
+{
+  auto It = Entries_.find(&record);
+  if (It == Entries_.end())
+    return;
+
+  CEntry &entry = It->second;
+  indexRemove(entry, record);
+  Removed_.push_back(entry.Id);
+  Dirty_.erase(&record);
+  iterator recordIt = entry.It;
+  Entries_.erase(It);
+  Records_.erase(recordIt);
+}
+
+void CPayoutQueue::update(PayoutDbRecord &record)
+{
+  auto It = Entries_.find(&record);
+  if (It == Entries_.end())
+    return;
+
+  indexRemove(It->second, record);
+  indexAdd(It->second, record);
+  Dirty_.insert(&record);
+}
+
+void CPayoutQueue::flush()
+{
+  if (Dirty_.empty() && Removed_.empty())
+    return;
+
+  if (CompactRequired_ || (JournalSize_ >= JournalCompactMinSize && JournalSize_ >= LiveSize_*4)) {
+    compact();
+    return;
+  }
+
+  xmstream stream;
+  for (uint64_t id: Removed_)
+    writeFrame(stream, EOpRemove, id, nullptr);
+  for (const PayoutDbRecord *record: Dirty_)
+    writeFrame(stream, EOpPut, Entries_[record].Id, record);
+
+  // One retry after failed write, then journal rewritten; changes kept for next flush if both failed
+  for (unsigned i = 0; i < 2 && !CompactRequired_; i++) {
+    if (append(stream.data(), stream.sizeOf())) {
+      JournalSize_ += stream.sizeOf();
+      Dirty_.clear();
+      Removed_.clear();
+      return;
+    }
+  }
+
+  compact();
+}
+
+bool CPayoutQueue::append(const void *data, size_t size)
+{
+  if (Fd_.write(data, size) == static_cast<ssize_t>(size))
+    return true;
+
+  // Replay stops at first bad frame, so torn frame must be cut before next append
+  LOG_F(ERROR, "can't write payouts journal %s (%s)", Path_.u8string().c_str(), strerror(errno));
+  if (!Fd_.truncate(JournalSize_) || Fd_.seekSet(JournalSize_) != JournalSize_) {
+    LOG_F(ERROR, "can't truncate payouts journal %s (%s), will be rewritten", Path_.u8string().c_str(), strerror(errno));
+    CompactRequired_ = true;
+  }
+
+  return false;
+}
+
+void CPayoutQueue::indexAdd(CEntry &entry, PayoutDbRecord &record)
+{
+  entry.Status = record.Status < EStatusNum ? record.Status : EStatusNum;
+  entry.Value = record.Value;
+  entry.TxFee = record.TxFee;
+
+  StatusIndex_[entry.Status].emplace(entry.Id, &record);
+  // Batched payouts hold net value and fee share, requested balance is their sum
+  StatusAmount_[entry.Status] += entry.Value + entry.TxFee;
+  CUserQueued &user = UserIndex_[record.UserId];
+  user.Value += entry.Value + entry.TxFee;
+  user.Count++;
+  TotalValue_ += entry.Value + entry.TxFee;
+}
+
+void CPayoutQueue::indexRemove(CEntry &entry, PayoutDbRecord &record)
+{
+  StatusIndex_[entry.Status].erase(entry.Id);
+  StatusAmount_[entry.Status] -= entry.Value + entry.TxFee;
+  auto It = UserIndex_.find(record.UserId);
+  if (It != UserIndex_.end()) {
+    It->second.Value -= entry.Value + entry.TxFee;
+    if (--It->second.Count == 0)
+      UserIndex_.erase(It);
+  }
+  TotalValue_ -= entry.Value + entry.TxFee;
+}
+
+void CPayoutQueue::writeFrame(xmstream &stream, EJournalOp op, uint64_t id, const PayoutDbRecord *record)
+{
+  // Reserve place for header, fill it after payload serialization
+  size_t headerOffset = stream.offsetOf();
+  stream.reserve(JournalFrameHeaderSize);
+  size_t payloadOffset = stream.offsetOf();
+  stream.write<uint8_t>(op);
+  stream.writele<uint64_t>(id);
+  if (record)
+    record->serializeValue(stream);
+
+  size_t payloadSize = stream.offsetOf() - payloadOffset;
+  uint8_t *frame = stream.data<uint8_t>() + headerOffset;
+  uint32_t size = static_cast<uint32_t>(payloadSize);
+  uint32_t checksum = crc32c(0, frame + JournalFrameHeaderSize, payloadSize);
+  for (unsigned i = 0; i < 4; i++) {
+    frame[i] = static_cast<uint8_t>(size >> (i*8));
+    frame[4+i] = static_cast<uint8_t>(checksum >> (i*8));
+  }
+}
+
+bool CPayoutQueue::replay(xmstream &stream, std::map<uint64_t, PayoutDbRecord> &records, size_t *validSize)
+{
+  *validSize = 0;
+  while (stream.remaining()) {
+    if (stream.remaining() < JournalFrameHeaderSize)
+      return false;
+    uint32_t size = stream.readle<uint32_t>();
+    uint32_t checksum = stream.readle<uint32_t>();
+    if (stream.remaining() < size || size < 9)
+      return false;
+
+    const uint8_t *payload = stream.seek<uint8_t>(size);
+    if (crc32c(0, payload, size) != checksum)
+      return false;
+
+    xmstream frame(const_cast<uint8_t*>(payload), size);
+    uint8_t op = frame.read<uint8_t>();
+    uint64_t id = frame.readle<uint64_t>();
+    if (op == EOpPut) {
+      PayoutDbRecord record;
+      if (!record.deserializeValue(frame))
+        return false;
+      records[id] = std::move(record);
+    } else if (op == EOpRemove) {
+      records.erase(id);
+    } else {
+      return false;
+    }
+
+    *validSize = stream.offsetOf();
+  }
+
+  return true;
+}
+
+bool CPayoutQueue::compact()
+{
+  // Write snapshot to temporary file and atomically replace journal
+  std::filesystem::path tmpPath = Path_;
+  tmpPath += ".tmp";
+
+  xmstream stream;
+  for (auto &record: Records_)
+    writeFrame(stream, EOpPut, Entries_[&record].Id, &record);
+
+  {
+    FileDescriptor fd;
+    if (!fd.open(tmpPath) ||
+        !fd.truncate(0) ||
+        fd.write(stream.data(), 0, stream.sizeOf()) != static_cast<ssize_t>(stream.sizeOf())) {
+      LOG_F(ERROR, "can't write payouts journal snapshot %s (%s)", tmpPath.u8string().c_str(), strerror(errno));
+      return false;
+    }
+    fd.close();
+  }
+
+  std::error_code errc;
+  std::filesystem::rename(tmpPath, Path_, errc);
+  if (errc) {
+    LOG_F(ERROR, "can't replace payouts journal %s (%s)", Path_.u8string().c_str(), errc.message().c_str());
+    return false;
+  }
+
+  if (!Fd_.open(Path_)) {
+    LOG_F(ERROR, "can't open payouts journal %s (%s)", Path_.u8string().c_str(), strerror(errno));
+    return false;
+  }
+
+  JournalSize_ = LiveSize_ = stream.sizeOf();
+  Fd_.seekSet(JournalSize_);
+  CompactRequired_ = false;
+  Dirty_.clear();
+  Removed_.clear();
+  return true;
+}
@@ -3,12 +3,14 @@
 #include "loguru.hpp"
 
 
-CThreadPool::CThreadPool(unsigned threadsNum) : ThreadsNum_(threadsNum)
+CThreadPool::CThreadPool(unsigned threadsNum, const std::vector<unsigned> &cpus) : ThreadsNum_(threadsNum)
 {
   Threads_.reset(new ThreadData[threadsNum]);
   for (unsigned i = 0; i < threadsNum; i++) {
     ThreadData &threadData = Threads_[i];
     threadData.Id = i;
+    if (!cpus.empty())
+      threadData.Cpu = static_cast<int>(cpus[i % cpus.size()]);
     threadData.Base = createAsyncBase(amOSDefault);
     // Temporary use "semaphore" event
     threadData.NewTaskEvent = newUserEvent(threadData.Base, 1, [](aioUserEvent*, void *arg) {
@@ -28,7 +30,11 @@ void CThreadPool::start()
       loguru::set_thread_name(name);
       InitializeWorkerThread();
       SetLocalThreadId(threadData->Id);
+      // Pin before any per-thread allocation: memory placed to local NUMA node on first touch
+      if (threadData->Cpu >= 0 && !SetCurrentThreadAffinity({static_cast<unsigned>(threadData->Cpu)}))
+        LOG_F(WARNING, "worker %u: can't pin to cpu %i", threadData->Id, threadData->Cpu);
       LOG_F(INFO, "worker %u started tid=%u", threadData->Id, GetGlobalThreadId());
+      ReportThreadTopology(name);
       asyncLoop(threadData->Base);
     }, &threadData);
   }
@@ -1,4 +1,5 @@
 #include "poolcore/rocksdbBase.h"
+#include "poolcommon/metrics.h"
 #include "loguru.hpp"
 
 rocksdbBase::IteratorType::~IteratorType()
@@ -255,6 +256,7 @@ rocksdb::DB *rocksdbBase::getOrCreatePartition(const std::string &id)
 
 rocksdbBase::rocksdbBase(const std::filesystem::path &path) : _path(path)
 {
+  WriteTime_ = &metricHistogram("pool_rocksdb_write_seconds", "RocksDB synchronous write time", metricLabel("db", path.u8string()));
   std::filesystem::create_directories(path);
   
   std::filesystem::directory_iterator dirItEnd;
@@ -285,7 +287,10 @@ bool rocksdbBase::put(const std::string &partitionId, const void *key, size_t ke
     rocksdb::Slice K((const char*)key, keySize);
     rocksdb::Slice V((const char*)value, valueSize);
     write_options.sync = true;
-    return db->Put(write_options, K, V).ok();
+    auto beginPt = std::chrono::steady_clock::now();
+    bool result = db->Put(write_options, K, V).ok();
+    WriteTime_->recordSince(beginPt);
+    return result;
   } else {
     return false;
   }
@@ -297,7 +302,10 @@ bool rocksdbBase::deleteRow(const std::string &partitionId, const void *key, siz
     rocksdb::WriteOptions write_options;
     rocksdb::Slice K((const char*)key, keySize);
     write_options.sync = true;
-    return db->Delete(write_options, K).ok();
+    auto beginPt = std::chrono::steady_clock::now();
+    bool result = db->Delete(write_options, K).ok();
+    WriteTime_->recordSince(beginPt);
+    return result;
   } else {
     return false;
   }
@@ -337,7 +345,9 @@ bool rocksdbBase::writeBatch(PartitionBatchType &batch)
   if (partition) {
     rocksdb::WriteOptions options;
     options.sync = true;
+    auto beginPt = std::chrono::steady_clock::now();
     partition->Write(options, &batch.Batch);
+    WriteTime_->recordSince(beginPt);
     return true;
   } else {
     return false;
@@ -1,13 +1,73 @@
 #include "poolcore/statistics.h"
 #include "poolcore/accounting.h"
+#include "poolcore/poolInstance.h"
+#include "poolcore/statsCache.h"
 #include "poolcommon/coroutineJoin.h"
 #include "poolcommon/debug.h"
 #include "poolcommon/serialize.h"
 #include "loguru.hpp"
 #include <algorithm>
 
+bool StatisticDb::loadCachedRound(CStatsAccumulator &acc, const CStatsFile &file, int64_t lastShareTime, uint64_t shareCount, double shareWork, uint32_t primePOWTarget)
+{
+  if (!acc.Recent.empty() && acc.Recent.timeLabel(acc.Recent.size() - 1) >= file.TimeLabel) {
+    LOG_F(ERROR, "<%s> StatisticDb: duplicate data in %s", CoinInfo_.Name.c_str(), file.Path.u8string().c_str());
+    return false;
+  }
+
+  acc.LastShareTime = lastShareTime;
+  acc.Recent.push(file.TimeLabel, static_cast<uint32_t>(shareCount), shareWork, primePOWTarget, recentCapacity(acc));
+  return true;
+}
+
+bool StatisticDb::parseColumnarStatsCacheFile(CStatsFile &file)
+{
+  CStatsCacheFile cache;
+  std::string error;
+  if (!cache.open(file.Path, error)) {
+    LOG_F(ERROR, "<%s> StatisticDb: corrupted file %s (%s)", CoinInfo_.Name.c_str(), file.Path.u8string().c_str(), error.c_str());
+    return false;
+  }
+
+  // Records of one user are stored together, resolve user tables once per user
+  const uint32_t *logins = cache.login();
+  const uint32_t *workerIds = cache.workerId();
+  const int64_t *lastShareTimes = cache.lastShareTime();
+  const uint64_t *shareCounts = cache.shareCount();
+  const double *shareWorks = cache.shareWork();
+  const uint32_t *primePOWTargets = cache.primePOWTarget();
+  uint32_t currentLogin = 0;
+  std::unordered_map<std::string, CStatsAccumulator> *currentWorkers = nullptr;
+  for (size_t i = 0, ie = cache.size(); i != ie; ++i) {
+    CStatsAccumulator *acc = nullptr;
+    if (logins[i] && workerIds[i]) {
+      if (!currentWorkers || logins[i] != currentLogin) {
+        currentLogin = logins[i];
+        currentWorkers = &LastWorkerStats_[std::string(cache.name(currentLogin))];
+      }
+      acc = &(*currentWorkers)[std::string(cache.name(workerIds[i]))];
+    } else if (logins[i]) {
+      acc = &LastUserStats_[std::string(cache.name(logins[i]))];
+    } else {
+      acc = &PoolStatsAcc_;
+    }
+
+    if (!loadCachedRound(*acc, file, lastShareTimes[i], shareCounts[i], shareWorks[i], primePOWTargets[i]))
+      return false;
+  }
+
+  file.LastShareId = cache.lastShareId();
+  if (isDebugStatistic())
+    LOG_F(1, "<%s> Loaded %zu records from statistic cache", CoinInfo_.Name.c_str(), cache.size());
+  LOG_F(INFO, "<%s> Statistic cache file %s loaded successfully", CoinInfo_.Name.c_str(), file.Path.u8string().c_str());
+  return true;
+}
+
 bool StatisticDb::parseStatsCacheFile(CStatsFile &file)
 {
+  if (file.Format == EStatsFileColumnar)
+    return parseColumnarStatsCacheFile(file);
+
   FileDescriptor fd;
   if (!fd.open(file.Path.u8string().c_str())) {
     LOG_F(ERROR, "StatisticDb: can't open file %s", file.Path.u8string().c_str());
@@ -28,7 +88,7 @@ bool StatisticDb::parseStatsCacheFile(CStatsFile &file)
   CStatsFileData fileData;
 
   // parse stats file
-  if (file.IsOldFormat) {
+  if (file.Format == EStatsFileV1) {
     DbIo<decltype(fileData.LastShareId)>::unserialize(stream, fileData.LastShareId);
     while (stream.remaining()) {
       uint32_t version;
@@ -39,6 +99,7 @@ bool StatisticDb::parseStatsCacheFile(CStatsFile &file)
       DbIo<decltype(record.Time)>::unserialize(stream, record.Time);
       DbIo<decltype(record.ShareCount)>::unserialize(stream, record.ShareCount);
       DbIo<decltype(record.ShareWork)>::unserialize(stream, record.ShareWork);
+      record.PrimePOWTarget = -1U;
     }
   } else {
     DbIo<CStatsFileData>::unserialize(stream, fileData);
@@ -56,19 +117,8 @@ bool StatisticDb::parseStatsCacheFile(CStatsFile &file)
         acc = &PoolStatsAcc_;
 
 
-      if (!acc->Recent.empty() && acc->Recent.back().TimeLabel >= file.TimeLabel) {
-        LOG_F(ERROR, "<%s> StatisticDb: duplicate data in %s", CoinInfo_.Name.c_str(), file.Path.u8string().c_str());
+      if (!loadCachedRound(*acc, file, record.Time, record.ShareCount, record.ShareWork, record.PrimePOWTarget))
         return false;
-      }
-
-      acc->Recent.emplace_back();
-      CStatsElement &stats = acc->Recent.back();
-      acc->LastShareTime = record.Time;
-      stats.SharesNum = static_cast<uint32_t>(record.ShareCount);
-      stats.SharesWork = record.ShareWork;
-      stats.TimeLabel = file.TimeLabel;
-      stats.PrimePOWTarget = record.PrimePOWTarget;
-      stats.PrimePOWSharesNum.assign(record.PrimePOWShareCount.begin(), record.PrimePOWShareCount.end());
       if (isDebugStatistic()) {
         LOG_F(1, "<%s> Loaded data from statistic cache: %s/%s shares: %" PRIu64 " work: %.3lf",
               CoinInfo_.Name.c_str(),
@@ -94,13 +144,29 @@ StatisticDb::StatisticDb(asyncBase *base, const PoolBackendConfig &config, const
 {
   WorkerStatsUpdaterEvent_ = newUserEvent(base, 1, nullptr, nullptr);
   PoolStatsUpdaterEvent_ = newUserEvent(base, 1, nullptr, nullptr);
+  QuerySnapshotEvent_ = newUserEvent(base, 1, nullptr, nullptr);
+
+  // Extra rounds for unaligned flush time labels
+  int64_t keepTime = std::chrono::seconds(_cfg.StatisticKeepTime).count();
+  WorkersRecentCapacity_ = keepTime / std::max<int64_t>(std::chrono::seconds(_cfg.StatisticWorkersAggregateTime).count(), 1) + 2;
+  PoolRecentCapacity_ = keepTime / std::max<int64_t>(std::chrono::seconds(_cfg.StatisticPoolAggregateTime).count(), 1) + 2;
+
+  std::string coinLabel = metricLabel("coin", CoinInfo_.Name);
+  TaskHandler_.setQueueDepthGauge(&metricGauge("pool_task_queue_depth", "Tasks waiting in task handler queue", metricLabels("coin", CoinInfo_.Name, "handler", "statistic")));
+  WorkersUpdateTime_ = &metricHistogram("pool_statistic_update_seconds", "Statistic aggregation and cache write time", metricLabels("coin", CoinInfo_.Name, "stage", "workers"));
+  PoolUpdateTime_ = &metricHistogram("pool_statistic_update_seconds", "Statistic aggregation and cache write time", metricLabels("coin", CoinInfo_.Name, "stage", "pool"));
+  SnapshotUpdateTime_ = &metricHistogram("pool_query_snapshot_seconds", "Query snapshot build time", metricLabels("coin", CoinInfo_.Name, "db", "statistic"));
+  PoolClientsMetric_ = &metricGauge("pool_clients", "Active clients", coinLabel);
+  PoolWorkersMetric_ = &metricGauge("pool_workers", "Active workers", coinLabel);
+  PoolPowerMetric_ = &metricGauge("pool_power", "Average pool power (coin specific units)", coinLabel);
 
   int64_t currentTime = time(nullptr);
   WorkersFlushInfo_.Time = currentTime;
   WorkersFlushInfo_.ShareId = 0;
   std::deque<CStatsFile> workerStatsCache;
-  enumerateStatsFiles(workerStatsCache, config.dbPath / "stats.workers.cache", true);
-  enumerateStatsFiles(workerStatsCache, config.dbPath / "stats.workers.cache.2", false);
+  enumerateStatsFiles(workerStatsCache, config.dbPath / "stats.workers.cache", EStatsFileV1);
+  enumerateStatsFiles(workerStatsCache, config.dbPath / "stats.workers.cache.2", EStatsFileV2);
+  enumerateStatsFiles(workerStatsCache, config.dbPath / "stats.workers.cache.3", EStatsFileColumnar);
   for (auto &file: workerStatsCache) {
     if (parseStatsCacheFile(file)) {
       WorkersFlushInfo_.Time = file.TimeLabel;
@@ -114,8 +180,9 @@ StatisticDb::StatisticDb(asyncBase *base, const PoolBackendConfig &config, const
   PoolFlushInfo_.Time = currentTime;
   PoolFlushInfo_.ShareId = 0;
   std::deque<CStatsFile> poolStatsCache;
-  enumerateStatsFiles(poolStatsCache, config.dbPath / "stats.pool.cache", true);
-  enumerateStatsFiles(poolStatsCache, config.dbPath / "stats.pool.cache.2", false);
+  enumerateStatsFiles(poolStatsCache, config.dbPath / "stats.pool.cache", EStatsFileV1);
+  enumerateStatsFiles(poolStatsCache, config.dbPath / "stats.pool.cache.2", EStatsFileV2);
+  enumerateStatsFiles(poolStatsCache, config.dbPath / "stats.pool.cache.3", EStatsFileColumnar);
   for (auto &file: poolStatsCache) {
     if (parseStatsCacheFile(file)) {
       PoolFlushInfo_.Time = file.TimeLabel;
@@ -131,7 +198,7 @@ StatisticDb::StatisticDb(asyncBase *base, const PoolBackendConfig &config, const
     LOG_F(1, "%s: last aggregated id: %" PRIu64 " last known id: %" PRIu64 "", coinInfo.Name.c_str(), lastAggregatedShareId(), lastKnownShareId());
 }
 
-void StatisticDb::enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, bool isOldFormat)
+void StatisticDb::enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, EStatsFileFormat format)
 {
   std::error_code errc;
   std::filesystem::create_directories(directory, errc);
@@ -148,13 +215,13 @@ void StatisticDb::enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::
     cache.emplace_back();
     cache.back().Path = *I;
     cache.back().TimeLabel = xatoi<uint64_t>(fileName.c_str());
-    cache.back().IsOldFormat = isOldFormat;
+    cache.back().Format = format;
   }
 
   std::sort(cache.begin(), cache.end(), [](const CStatsFile &l, const CStatsFile &r){ return l.TimeLabel < r.TimeLabel; });
 }
 
-void StatisticDb::updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData)
+void StatisticDb::updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, CStatsCacheWriter &cacheWriter)
 {
   // Push current accumulated data to ring buffer
   if ((currentTime - acc.LastShareTime) < std::chrono::seconds(_cfg.StatisticKeepWorkerNamesTime).count()) {
@@ -163,13 +230,13 @@ void StatisticDb::updateAcc(const std::string &login, const std::string &workerI
 
     // Update in-memory data
     acc.Current.TimeLabel = currentTime;
-    acc.Recent.push_back(acc.Current);
+    acc.Recent.push(currentTime, acc.Current.SharesNum, acc.Current.SharesWork, acc.Current.PrimePOWTarget, recentCapacity(acc));
 
     // Update on-disk data
     // Update [user,worker,time] -> state database
     if (acc.Current.SharesNum)
       writeStatsToDb(login, workerId, acc.Current);
-    writeStatsToCache(login, workerId, acc.Current, acc.LastShareTime, statsFileData);
+    cacheWriter.add(login, workerId, acc.LastShareTime, acc.Current.SharesNum, acc.Current.SharesWork, acc.Current.PrimePOWTarget);
   }
 
   // Reset current worker state
@@ -177,8 +244,7 @@ void StatisticDb::updateAcc(const std::string &login, const std::string &workerI
 
   // Remove old data
   auto removeTimePoint = currentTime - std::chrono::seconds(_cfg.StatisticKeepTime).count();
-  while (!acc.Recent.empty() && acc.Recent.front().TimeLabel < removeTimePoint)
-    acc.Recent.pop_front();
+  acc.Recent.removeOlder(removeTimePoint);
 }
 
 void StatisticDb::calcAverageMetrics(const StatisticDb::CStatsAccumulator &acc, std::chrono::seconds calculateInterval, std::chrono::seconds aggregateTime, CStats &result)
@@ -191,16 +257,13 @@ void StatisticDb::calcAverageMetrics(const StatisticDb::CStatsAccumulator &acc,
   int64_t startTimePoint = time(nullptr);
   int64_t stopTimePoint = startTimePoint - calculateInterval.count();
   int64_t lastTimePoint = startTimePoint - aggregateTime.count();
-  unsigned counter = 0;
-  for (auto statsIt = acc.Recent.rbegin(), statsItEnd = acc.Recent.rend(); statsIt != statsItEnd; ++statsIt) {
-    if (statsIt->TimeLabel < stopTimePoint)
-      break;
-
-    lastTimePoint = statsIt->TimeLabel - aggregateTime.count();
-    workerSharesNum += statsIt->SharesNum;
-    workerSharesWork += statsIt->SharesWork;
-    primePOWTarget = std::min(primePOWTarget, statsIt->PrimePOWTarget);
-    counter++;
+  size_t from = acc.Recent.lowerBound(stopTimePoint);
+  unsigned counter = static_cast<unsigned>(acc.Recent.size() - from);
+  if (counter) {
+    lastTimePoint = acc.Recent.timeLabel(from) - aggregateTime.count();
+    workerSharesNum += static_cast<uint32_t>(acc.Recent.sharesNumSum(from));
+    workerSharesWork += acc.Recent.sharesWorkSum(from);
+    primePOWTarget = std::min(primePOWTarget, acc.Recent.primePOWTarget(from));
   }
 
   uint64_t timeInterval = startTimePoint - lastTimePoint;
@@ -230,22 +293,6 @@ void StatisticDb::writeStatsToDb(const std::string &loginId, const std::string &
     PoolStatsDb_.put(record);
 }
 
-void StatisticDb::writeStatsToCache(const std::string &loginId, const std::string &workerId, const CStatsElement &element, int64_t lastShareTime, xmstream &statsFileData)
-{
-  // TODO: use separate format for statistic cache record
-  CStatsFileRecord record;
-  record.Login = loginId;
-  record.WorkerId = workerId;
-  // record.Time is a last share time
-  // record creation time already have in statistic cache file
-  record.Time = lastShareTime;
-  record.ShareCount = element.SharesNum;
-  record.ShareWork = element.SharesWork;
-  record.PrimePOWTarget = element.PrimePOWTarget;
-  record.PrimePOWShareCount.assign(element.PrimePOWSharesNum.begin(), element.PrimePOWSharesNum.end());
-  DbIo<CStatsFileRecord>::serialize(statsFileData, record);
-}
-
 void StatisticDb::addShare(const CShare &share, bool updateWorkerAndUserStats, bool updatePoolStats)
 {
 
@@ -334,6 +381,21 @@ void StatisticDb::start()
       db->updatePoolStats(time(nullptr));
     }
   }, this, 0x20000, coroutineFinishCb, &PoolStatsUpdaterFinished_));
+
+  if (QueryThreadPool_) {
+    updateQuerySnapshot();
+    coroutineCall(coroutineNewWithCb([](void *arg) {
+      StatisticDb *db = static_cast<StatisticDb*>(arg);
+      for (;;) {
+        ioSleep(db->QuerySnapshotEvent_, std::chrono::microseconds(db->_cfg.QuerySnapshotInterval).count());
+        if (db->ShutdownRequested_)
+          break;
+        db->updateQuerySnapshot();
+      }
+    }, this, 0x20000, coroutineFinishCb, &QuerySnapshotUpdaterFinished_));
+  } else {
+    QuerySnapshotUpdaterFinished_ = true;
+  }
 }
 
 void StatisticDb::stop()
@@ -341,20 +403,23 @@ void StatisticDb::stop()
   ShutdownRequested_ = true;
   userEventActivate(WorkerStatsUpdaterEvent_);
   userEventActivate(PoolStatsUpdaterEvent_);
+  userEventActivate(QuerySnapshotEvent_);
   TaskHandler_.stop(CoinInfo_.Name.c_str(), "statisticDb task handler");
   coroutineJoin(CoinInfo_.Name.c_str(), "statisticDb worker stats updater", &WorkerStatsUpdaterFinished_);
   coroutineJoin(CoinInfo_.Name.c_str(), "statisticDb pool stats updater", &PoolStatsUpdaterFinished_);
+  coroutineJoin(CoinInfo_.Name.c_str(), "statisticDb query snapshot updater", &QuerySnapshotUpdaterFinished_);
 }
 
 void StatisticDb::updateWorkersStats(int64_t timeLabel)
 {
-  xmstream statsFileData;
+  auto beginPt = std::chrono::steady_clock::now();
+  CStatsCacheWriter cacheWriter;
   std::vector<std::string> userDeleteList;
   for (auto &userIt: LastWorkerStats_) {
     std::vector<std::string> workerDeleteList;
     for (auto &workerIt: userIt.second) {
       CStatsAccumulator &acc = workerIt.second;
-      updateAcc(userIt.first, workerIt.first, acc, timeLabel, statsFileData);
+      updateAcc(userIt.first, workerIt.first, acc, timeLabel, cacheWriter);
       if (acc.Recent.empty())
         workerDeleteList.push_back(workerIt.first);
     }
@@ -365,19 +430,21 @@ void StatisticDb::updateWorkersStats(int64_t timeLabel)
 
   for (auto &userIt: LastUserStats_) {
     CStatsAccumulator &acc = userIt.second;
-    updateAcc(userIt.first, "", acc, timeLabel, statsFileData);
+    updateAcc(userIt.first, "", acc, timeLabel, cacheWriter);
     if (acc.Recent.empty())
       userDeleteList.push_back(userIt.first);
   }
 
-  updateWorkersStatsDiskCache(timeLabel, LastKnownShareId_, statsFileData.data(), statsFileData.sizeOf());
+  updateWorkersStatsDiskCache(timeLabel, LastKnownShareId_, cacheWriter);
 
   // Cleanup users table
   std::for_each(userDeleteList.begin(), userDeleteList.end(), [this](const std::string &name) { LastWorkerStats_.erase(name);});
+  WorkersUpdateTime_->recordSince(beginPt);
 }
 
 void StatisticDb::updatePoolStats(int64_t timeLabel)
 {
+  auto beginPt = std::chrono::steady_clock::now();
   PoolStatsCached_.ClientsNum = 0;
   PoolStatsCached_.WorkersNum = 0;
 
@@ -400,9 +467,13 @@ void StatisticDb::updatePoolStats(int64_t timeLabel)
     LOG_F(1, "update pool stats:");
   calcAverageMetrics(PoolStatsAcc_, _cfg.StatisticPoolPowerCalculateInterval, _cfg.StatisticPoolAggregateTime, PoolStatsCached_);
 
-  xmstream statsFileData;
-  updateAcc("", "", PoolStatsAcc_, timeLabel, statsFileData);
-  updatePoolStatsDiskCache(timeLabel, LastKnownShareId_, statsFileData.data(), statsFileData.sizeOf());
+  CStatsCacheWriter cacheWriter;
+  updateAcc("", "", PoolStatsAcc_, timeLabel, cacheWriter);
+  updatePoolStatsDiskCache(timeLabel, LastKnownShareId_, cacheWriter);
+  PoolUpdateTime_->recordSince(beginPt);
+  PoolClientsMetric_->set(PoolStatsCached_.ClientsNum);
+  PoolWorkersMetric_->set(PoolStatsCached_.WorkersNum);
+  PoolPowerMetric_->set(PoolStatsCached_.AveragePower);
 
   LOG_F(INFO,
         "clients: %u, workers: %u, power: %" PRIu64 ", share rate: %.3lf shares/s",
@@ -412,10 +483,10 @@ void StatisticDb::updatePoolStats(int64_t timeLabel)
         PoolStatsCached_.SharesPerSecond);
 }
 
-void StatisticDb::updateStatsDiskCache(const char *name, std::deque<CStatsFile> &cache, int64_t timeLabel, uint64_t lastShareId, const void *data, size_t size)
+void StatisticDb::updateStatsDiskCache(const char *name, std::deque<CStatsFile> &cache, int64_t timeLabel, uint64_t lastShareId, const CStatsCacheWriter &cacheWriter)
 {
   // Don't write empty files to disk
-  if (!size)
+  if (cacheWriter.empty())
     return;
 
   CStatsFile &statsFile = cache.emplace_back();
@@ -429,14 +500,10 @@ void StatisticDb::updateStatsDiskCache(const char *name, std::deque<CStatsFile>
     return;
   }
 
-  {
-    uint32_t version = xhtole(static_cast<uint32_t>(CStatsFileData::CurrentRecordVersion));
-    uint64_t serializedShareId = xhtole(lastShareId);
-    fd.write(&version, sizeof(version));
-    fd.write(&serializedShareId, sizeof(serializedShareId));
-  }
-
-  fd.write(data, size);
+  xmstream data;
+  cacheWriter.serialize(data, lastShareId);
+  fd.write(data.data(), data.sizeOf());
+  fd.truncate(data.sizeOf());
   fd.close();
 
   auto removeTimePoint = timeLabel - std::chrono::seconds(_cfg.StatisticKeepTime).count();
@@ -448,26 +515,19 @@ void StatisticDb::updateStatsDiskCache(const char *name, std::deque<CStatsFile>
   }
 }
 
-void StatisticDb::getUserStats(const std::string &user, CStats &userStats, std::vector<CStats> &workerStats, size_t offset, size_t size, EStatsColumn sortBy, bool sortDescending)
+void StatisticDb::calcUserStats(const std::unordered_map<std::string, CStatsAccumulator> &workers, CStats &userStats, std::vector<CStats> &allStats)
 {
-  auto userIt = LastWorkerStats_.find(user);
-  if (userIt == LastWorkerStats_.end())
-    return;
-
   userStats.ClientsNum = 1;
   userStats.WorkersNum = 0;
 
   // Iterate over all workers
-  std::vector<CStats> allStats;
-  allStats.resize(userIt->second.size());
+  allStats.resize(workers.size());
   size_t workerStatsIndex = 0;
   int64_t lastShareTime = 0;
-  for (const auto &workerIt: userIt->second) {
+  for (const auto &workerIt: workers) {
     const CStatsAccumulator &acc = workerIt.second;
     CStats &result = allStats[workerStatsIndex];
     result.WorkerId = workerIt.first;
-    if (isDebugStatistic())
-      LOG_F(1, "Retrieve statistic for %s/%s", user.c_str(), workerIt.first.c_str());
     calcAverageMetrics(acc, _cfg.StatisticWorkersPowerCalculateInterval, _cfg.StatisticWorkersAggregateTime, result);
 
     userStats.SharesPerSecond += result.SharesPerSecond;
@@ -482,43 +542,104 @@ void StatisticDb::getUserStats(const std::string &user, CStats &userStats, std::
   }
 
   userStats.LastShareTime = lastShareTime;
+}
 
-  // Build response
-  // Sorting results
-  switch (sortBy) {
-    case EStatsColumnName :
-      if (!sortDescending)
-        std::sort(allStats.begin(), allStats.end(), [](const CStats &l, const CStats &r){ return l.WorkerId < r.WorkerId; });
-      else
-        std::sort(allStats.rbegin(), allStats.rend(), [](const CStats &l, const CStats &r){ return l.WorkerId < r.WorkerId; });
-      break;
-    case EStatsColumnAveragePower:
-      if (!sortDescending)
-        std::sort(allStats.begin(), allStats.end(), [](const CStats &l, const CStats &r){ return l.AveragePower < r.AveragePower; });
-      else
-        std::sort(allStats.rbegin(), allStats.rend(), [](const CStats &l, const CStats &r){ return l.AveragePower < r.AveragePower; });
-      break;
-    case EStatsColumnSharesPerSecond:
-      if (!sortDescending)
-        std::sort(allStats.begin(), allStats.end(), [](const CStats &l, const CStats &r){ return l.SharesPerSecond < r.SharesPerSecond; });
-      else
-        std::sort(allStats.rbegin(), allStats.rend(), [](const CStats &l, const CStats &r){ return l.SharesPerSecond < r.SharesPerSecond; });
-      break;
-    case EStatsColumnLastShareTime:
-      if (!sortDescending)
-        std::sort(allStats.begin(), allStats.end(), [](const CStats &l, const CStats &r){ return l.LastShareTime < r.LastShareTime; });
-      else
-        std::sort(allStats.rbegin(), allStats.rend(), [](const CStats &l, const CStats &r){ return l.LastShareTime < r.LastShareTime; });
-      break;
+static inline bool workerStatsLess(const StatisticDb::CStats &l, const StatisticDb::CStats &r, StatisticDb::EStatsColumn column)
+{
+  switch (column) {
+    case StatisticDb::EStatsColumnName : return l.WorkerId < r.WorkerId;
+    case StatisticDb::EStatsColumnAveragePower : return l.AveragePower < r.AveragePower;
+    case StatisticDb::EStatsColumnSharesPerSecond : return l.SharesPerSecond < r.SharesPerSecond;
+    case StatisticDb::EStatsColumnLastShareTime : return l.LastShareTime < r.LastShareTime;
   }
 
-  // Make page
-  if (offset < allStats.size()) {
-    size_t endIdx = std::min(offset + size, allStats.size());
-    workerStats.insert(workerStats.end(), std::make_move_iterator(allStats.begin() + offset), std::make_move_iterator(allStats.begin() + endIdx));
+  return false;
+}
+
+static inline bool userStatsLess(const StatisticDb::CredentialsWithStatistic &l, const StatisticDb::CredentialsWithStatistic &r, StatisticDb::CredentialsWithStatistic::EColumns column)
+{
+  switch (column) {
+    case StatisticDb::CredentialsWithStatistic::ELogin : return l.Credentials.Login < r.Credentials.Login;
+    case StatisticDb::CredentialsWithStatistic::EWorkersNum : return l.WorkersNum < r.WorkersNum;
+    case StatisticDb::CredentialsWithStatistic::EAveragePower : return l.AveragePower < r.AveragePower;
+    case StatisticDb::CredentialsWithStatistic::ESharesPerSecord : return l.SharesPerSecond < r.SharesPerSecond;
+    case StatisticDb::CredentialsWithStatistic::ELastShareTime : return l.LastShareTime < r.LastShareTime;
+    default : return false;
   }
 }
 
+// Sorts only elements of page [offset, offset+size): O(N + size*log(size))
+template<typename T, typename Less>
+static void sortPage(std::vector<T> &elements, size_t offset, size_t endIdx, Less less)
+{
+  if (offset)
+    std::nth_element(elements.begin(), elements.begin() + offset, elements.end(), less);
+  std::partial_sort(elements.begin() + offset, elements.begin() + endIdx, elements.end(), less);
+}
+
+const std::vector<uint32_t> *StatisticDb::CQuerySnapshot::CUserStats::order(EStatsColumn column) const
+{
+  unsigned index = static_cast<unsigned>(column);
+  if (index >= OrdersNum)
+    return nullptr;
+
+  std::call_once(OrderFlags_[index], [this, index, column]() {
+    std::vector<uint32_t> &order = Orders_[index];
+    order.resize(Workers.size());
+    for (uint32_t i = 0, ie = static_cast<uint32_t>(order.size()); i != ie; ++i)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [this, column](uint32_t l, uint32_t r) { return workerStatsLess(Workers[l], Workers[r], column); });
+  });
+
+  return &Orders_[index];
+}
+
+void StatisticDb::sortWorkerStats(std::vector<CStats> &allStats, std::vector<CStats> &workerStats, size_t offset, size_t size, EStatsColumn sortBy, bool sortDescending)
+{
+  if (offset >= allStats.size())
+    return;
+
+  size_t endIdx = std::min(offset + size, allStats.size());
+  sortPage(allStats, offset, endIdx, [sortBy, sortDescending](const CStats &l, const CStats &r) {
+    return sortDescending ? workerStatsLess(r, l, sortBy) : workerStatsLess(l, r, sortBy);
+  });
+
+  workerStats.insert(workerStats.end(), std::make_move_iterator(allStats.begin() + offset), std::make_move_iterator(allStats.begin() + endIdx));
+}
+
+void StatisticDb::getUserStats(const std::string &user, CStats &userStats, std::vector<CStats> &workerStats, size_t offset, size_t size, EStatsColumn sortBy, bool sortDescending)
+{
+  auto userIt = LastWorkerStats_.find(user);
+  if (userIt == LastWorkerStats_.end())
+    return;
+
+  if (isDebugStatistic())
+    LOG_F(1, "Retrieve statistic for %s", user.c_str());
+
+  std::vector<CStats> allStats;
+  calcUserStats(userIt->second, userStats, allStats);
+  sortWorkerStats(allStats, workerStats, offset, size, sortBy, sortDescending);
+}
+
+void StatisticDb::updateQuerySnapshot()
+{
+  auto beginPt = std::chrono::steady_clock::now();
+  std::unique_ptr<CQuerySnapshot> snapshot(new CQuerySnapshot);
+  snapshot->Pool = PoolStatsCached_;
+  snapshot->Workers.reserve(LastWorkerStats_.size());
+  for (const auto &userIt: LastWorkerStats_) {
+    CQuerySnapshot::CUserStats &userStats = snapshot->Workers[userIt.first];
+    calcUserStats(userIt.second, userStats.Aggregate, userStats.Workers);
+  }
+
+  snapshot->Users.reserve(LastUserStats_.size());
+  for (const auto &userIt: LastUserStats_)
+    calcAverageMetrics(userIt.second, _cfg.StatisticWorkersPowerCalculateInterval, _cfg.StatisticWorkersAggregateTime, snapshot->Users[userIt.first]);
+
+  QuerySnapshot_.reset(snapshot.release());
+  SnapshotUpdateTime_->recordSince(beginPt);
+}
+
 void StatisticDb::getHistory(const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, std::vector<CStats> &history)
 {
   if (groupByInterval < 60)
@@ -621,12 +742,11 @@ void StatisticDb::exportRecentStats(std::vector<CStatsExportData> &result)
 
     // Recent share work (up to N minutes)
     int64_t lastAcceptTime = timeLabel - 30*60;
-    for (auto It = userIt.second.Recent.rbegin(), ItE = userIt.second.Recent.rend(); It != ItE; ++It) {
-      if (It->TimeLabel < lastAcceptTime)
-        break;
+    const CStatsRing &userRecent = userIt.second.Recent;
+    for (size_t i = userRecent.size(); i > 0 && userRecent.timeLabel(i - 1) >= lastAcceptTime; i--) {
       auto &recent = userRecord.Recent.emplace_back();
-      recent.SharesWork = It->SharesWork;
-      recent.TimeLabel = It->TimeLabel;
+      recent.SharesWork = userRecent.sharesWork(i - 1);
+      recent.TimeLabel = userRecent.timeLabel(i - 1);
     }
   }
 
@@ -672,61 +792,139 @@ void StatisticDb::queryAllUserStatsImpl(const std::vector<UserManager::Credentia
     dst.LastShareTime = userStats.LastShareTime;
   }
 
+  std::vector<CredentialsWithStatistic> result;
+  sortUserListStats(usersWithStatistic, result, offset, size, sortBy, sortDescending);
+  callback(result);
+}
+
+void StatisticDb::sortUserListStats(std::vector<CredentialsWithStatistic> &usersWithStatistic,
+                                    std::vector<CredentialsWithStatistic> &result,
+                                    size_t offset,
+                                    size_t size,
+                                    CredentialsWithStatistic::EColumns sortBy,
+                                    bool sortDescending)
+{
+  if (offset >= usersWithStatistic.size())
+    return;
+
+  // Other columns are not sortable, page taken in source order
+  size_t endIdx = std::min(offset + size, usersWithStatistic.size());
   switch (sortBy) {
     case CredentialsWithStatistic::ELogin :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.Credentials.Login < r.Credentials.Login; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.Credentials.Login < r.Credentials.Login; });
-      break;
     case CredentialsWithStatistic::EWorkersNum :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.WorkersNum < r.WorkersNum; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.WorkersNum < r.WorkersNum; });
-      break;
     case CredentialsWithStatistic::EAveragePower :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.AveragePower < r.AveragePower; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.AveragePower < r.AveragePower; });
-      break;
     case CredentialsWithStatistic::ESharesPerSecord :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.SharesPerSecond < r.SharesPerSecond; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.SharesPerSecond < r.SharesPerSecond; });
-      break;
     case CredentialsWithStatistic::ELastShareTime :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.LastShareTime < r.LastShareTime; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.LastShareTime < r.LastShareTime; });
+      sortPage(usersWithStatistic, offset, endIdx, [sortBy, sortDescending](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) {
+        return sortDescending ? userStatsLess(r, l, sortBy) : userStatsLess(l, r, sortBy);
+      });
       break;
     default:
       break;
   }
 
-  // Make page
-  std::vector<CredentialsWithStatistic> result;
-  if (offset < usersWithStatistic.size()) {
-    size_t endIdx = std::min(offset + size, usersWithStatistic.size());
-    result.insert(result.end(), std::make_move_iterator(usersWithStatistic.begin() + offset), std::make_move_iterator(usersWithStatistic.begin() + endIdx));
+  result.insert(result.end(), std::make_move_iterator(usersWithStatistic.begin() + offset), std::make_move_iterator(usersWithStatistic.begin() + endIdx));
+}
+
+void StatisticDb::queryPoolStats(QueryPoolStatsCallback callback)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskQueryPoolStats(callback));
+    return;
   }
 
-  callback(result);
+  QueryThreadPool_->startAsyncCall([this, callback]() {
+    intrusive_ptr<CQuerySnapshot> snapshot(QuerySnapshot_);
+    callback(snapshot.get() ? snapshot.get()->Pool : CStats());
+  });
+}
+
+void StatisticDb::queryUserStats(const std::string &user, QueryUserStatsCallback callback, size_t offset, size_t size, StatisticDb::EStatsColumn sortBy, bool sortDescending)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskQueryUserStats(user, callback, offset, size, sortBy, sortDescending));
+    return;
+  }
+
+  QueryThreadPool_->startAsyncCall([this, user, callback, offset, size, sortBy, sortDescending]() {
+    CStats aggregate;
+    std::vector<CStats> workers;
+    intrusive_ptr<CQuerySnapshot> snapshot(QuerySnapshot_);
+    if (const CQuerySnapshot *data = snapshot.get()) {
+      auto userIt = data->Workers.find(user);
+      if (userIt != data->Workers.end()) {
+        const CQuerySnapshot::CUserStats &userStats = userIt->second;
+        aggregate = userStats.Aggregate;
+        // Page from cached order, without copying and sorting all workers
+        // Unknown column has no order (as in statistic thread, where it compares all workers equal)
+        const std::vector<uint32_t> *order = userStats.order(sortBy);
+        size_t workersNum = userStats.Workers.size();
+        for (size_t i = offset, ie = std::min(offset + size, workersNum); i < ie; i++) {
+          size_t position = sortDescending ? workersNum - 1 - i : i;
+          workers.push_back(userStats.Workers[order ? (*order)[position] : position]);
+        }
+      }
+    }
+
+    callback(aggregate, workers);
+  });
+}
+
+void StatisticDb::queryAllusersStats(std::vector<UserManager::Credentials> &&users,
+                                     QueryAllUsersStatisticCallback callback,
+                                     size_t offset,
+                                     size_t size,
+                                     CredentialsWithStatistic::EColumns sortBy,
+                                     bool sortDescending)
+{
+  if (!QueryThreadPool_) {
+    TaskHandler_.push(new TaskQueryAllUsersStats(std::move(users), callback, offset, size, sortBy, sortDescending));
+    return;
+  }
+
+  QueryThreadPool_->startAsyncCall([this, users = std::move(users), callback, offset, size, sortBy, sortDescending]() {
+    intrusive_ptr<CQuerySnapshot> snapshot(QuerySnapshot_);
+    const CQuerySnapshot *data = snapshot.get();
+    std::vector<CredentialsWithStatistic> usersWithStatistic(users.size());
+    for (size_t i = 0, ie = users.size(); i != ie; ++i) {
+      CredentialsWithStatistic &dst = usersWithStatistic[i];
+      dst.Credentials = users[i];
+      if (!data)
+        continue;
+
+      auto userIt = data->Users.find(dst.Credentials.Login);
+      if (userIt == data->Users.end())
+        continue;
+
+      dst.WorkersNum = userIt->second.WorkersNum;
+      dst.AveragePower = userIt->second.AveragePower;
+      dst.SharesPerSecond = userIt->second.SharesPerSecond;
+      dst.LastShareTime = userIt->second.LastShareTime;
+    }
+
+    std::vector<CredentialsWithStatistic> result;
+    sortUserListStats(usersWithStatistic, result, offset, size, sortBy, sortDescending);
+    callback(result);
+  });
 }
 
 StatisticServer::StatisticServer(asyncBase *base, const PoolBackendConfig &config, const CCoinInfo &coinInfo) :
   Base_(base), Cfg_(config), CoinInfo_(coinInfo), TaskHandler_(this, base)
 {
+  TaskHandler_.setQueueDepthGauge(&metricGauge("pool_task_queue_depth", "Tasks waiting in task handler queue", metricLabels("coin", CoinInfo_.Name, "handler", "statisticServer")));
   Statistics_.reset(new StatisticDb(Base_, config, CoinInfo_));
+  if (config.QueryThreadsNum) {
+    QueryThreadPool_.reset(new CThreadPool(config.QueryThreadsNum));
+    Statistics_->setQueryThreadPool(QueryThreadPool_.get());
+  }
   StatisticShareLogConfig shareLogConfig(Statistics_.get());
   ShareLog_.init(config.dbPath / "shares.log.v1", config.dbPath / "shares.log", coinInfo.Name, Base_, config.ShareLogFlushInterval, config.ShareLogFileSizeLimit, shareLogConfig);
 }
 
 void StatisticServer::start()
 {
+  if (QueryThreadPool_)
+    QueryThreadPool_->start();
   Thread_ = std::thread([](StatisticServer *server){ server->statisticServerMain(); }, this);
 }
 
@@ -736,6 +934,8 @@ void StatisticServer::stop()
   TaskHandler_.stop(CoinInfo_.Name.c_str(), "StatisticServer task handler");
   postQuitOperation(Base_);
   Thread_.join();
+  if (QueryThreadPool_)
+    QueryThreadPool_->stop();
   ShareLog_.flush();
 }
 
@@ -743,6 +943,9 @@ void StatisticServer::statisticServerMain()
 {
   InitializeWorkerThread();
   loguru::set_thread_name(CoinInfo_.Name.c_str());
+  if (!SetCurrentThreadAffinity(Cfg_.StatisticCpus))
+    LOG_F(WARNING, "%s: can't set statistic thread affinity", CoinInfo_.Name.c_str());
+  ReportThreadTopology((CoinInfo_.Name + " statistic").c_str());
   ShareLog_.start();
   TaskHandler_.start();
   Statistics_->start();
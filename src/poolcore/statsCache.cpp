@@ -0,0 +1,167 @@
+#include "poolcore/statsCache.h"
+#include "poolcommon/crc32.h"
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "statistic cache columns are read in place, little endian host required"
+#endif
+
+namespace {
+
+struct CStatsCacheLayout {
+  uint64_t NameOffsets;
+  uint64_t Names;
+  uint64_t LastShareTime;
+  uint64_t ShareWork;
+  uint64_t ShareCount;
+  uint64_t Login;
+  uint64_t WorkerId;
+  uint64_t PrimePOWTarget;
+  uint64_t Size;
+};
+
+static CStatsCacheLayout statsCacheLayout(uint64_t recordsNum, uint64_t namesNum, uint64_t namesSize)
+{
+  CStatsCacheLayout layout;
+  layout.NameOffsets = sizeof(CStatsCacheHeader);
+  layout.Names = layout.NameOffsets + (namesNum + 1) * sizeof(uint32_t);
+  layout.LastShareTime = (layout.Names + namesSize + 7) & ~static_cast<uint64_t>(7);
+  layout.ShareWork = layout.LastShareTime + recordsNum * sizeof(int64_t);
+  layout.ShareCount = layout.ShareWork + recordsNum * sizeof(double);
+  layout.Login = layout.ShareCount + recordsNum * sizeof(uint64_t);
+  layout.WorkerId = layout.Login + recordsNum * sizeof(uint32_t);
+  layout.PrimePOWTarget = layout.WorkerId + recordsNum * sizeof(uint32_t);
+  layout.Size = layout.PrimePOWTarget + recordsNum * sizeof(uint32_t);
+  return layout;
+}
+
+static uint32_t headerChecksum(const CStatsCacheHeader &header)
+{
+  CStatsCacheHeader copy = header;
+  copy.HeaderChecksum = 0;
+  return crc32c(0, &copy, sizeof(copy));
+}
+
+}
+
+uint32_t CStatsCacheWriter::nameIndex(const std::string &name)
+{
+  if (name.empty())
+    return 0;
+
+  auto It = NameIndex_.find(name);
+  if (It != NameIndex_.end())
+    return It->second;
+
+  uint32_t index = static_cast<uint32_t>(NameOffsets_.size() - 1);
+  Names_.append(name);
+  NameOffsets_.push_back(static_cast<uint32_t>(Names_.size()));
+  NameIndex_.emplace(name, index);
+  return index;
+}
+
+void CStatsCacheWriter::add(const std::string &login, const std::string &workerId, int64_t lastShareTime, uint64_t shareCount, double shareWork, uint32_t primePOWTarget)
+{
+  Login_.push_back(nameIndex(login));
+  WorkerId_.push_back(nameIndex(workerId));
+  LastShareTime_.push_back(lastShareTime);
+  ShareWork_.push_back(shareWork);
+  ShareCount_.push_back(shareCount);
+  PrimePOWTarget_.push_back(primePOWTarget);
+}
+
+void CStatsCacheWriter::serialize(xmstream &out, uint64_t lastShareId) const
+{
+  size_t recordsNum = LastShareTime_.size();
+  CStatsCacheLayout layout = statsCacheLayout(recordsNum, NameOffsets_.size() - 1, Names_.size());
+
+  size_t offset = out.offsetOf();
+  uint8_t *data = out.reserve<uint8_t>(layout.Size);
+  memset(data, 0, layout.Size);
+  memcpy(data + layout.NameOffsets, NameOffsets_.data(), NameOffsets_.size() * sizeof(uint32_t));
+  memcpy(data + layout.Names, Names_.data(), Names_.size());
+  memcpy(data + layout.LastShareTime, LastShareTime_.data(), recordsNum * sizeof(int64_t));
+  memcpy(data + layout.ShareWork, ShareWork_.data(), recordsNum * sizeof(double));
+  memcpy(data + layout.ShareCount, ShareCount_.data(), recordsNum * sizeof(uint64_t));
+  memcpy(data + layout.Login, Login_.data(), recordsNum * sizeof(uint32_t));
+  memcpy(data + layout.WorkerId, WorkerId_.data(), recordsNum * sizeof(uint32_t));
+  memcpy(data + layout.PrimePOWTarget, PrimePOWTarget_.data(), recordsNum * sizeof(uint32_t));
+
+  CStatsCacheHeader header;
+  header.Magic = CStatsCacheHeader::CurrentMagic;
+  header.Version = CStatsCacheHeader::CurrentVersion;
+  header.LastShareId = lastShareId;
+  header.RecordsNum = static_cast<uint32_t>(recordsNum);
+  header.NamesNum = static_cast<uint32_t>(NameOffsets_.size() - 1);
+  header.NamesSize = static_cast<uint32_t>(Names_.size());
+  header.DataChecksum = crc32c(0, data + sizeof(CStatsCacheHeader), layout.Size - sizeof(CStatsCacheHeader));
+  header.Reserved = 0;
+  header.HeaderChecksum = headerChecksum(header);
+  // xmstream can reallocate buffer, data pointer valid until next write
+  memcpy(out.data<uint8_t>() + offset, &header, sizeof(header));
+}
+
+bool CStatsCacheFile::open(const std::filesystem::path &path, std::string &error)
+{
+  if (!File_.open(path)) {
+    error = "can't map file";
+    return false;
+  }
+
+  const uint8_t *data = static_cast<const uint8_t*>(File_.data());
+  if (File_.size() < sizeof(CStatsCacheHeader)) {
+    error = "file too small";
+    return false;
+  }
+
+  Header_ = reinterpret_cast<const CStatsCacheHeader*>(data);
+  if (Header_->Magic != CStatsCacheHeader::CurrentMagic || Header_->Version != CStatsCacheHeader::CurrentVersion) {
+    error = "unknown format";
+    return false;
+  }
+
+  if (headerChecksum(*Header_) != Header_->HeaderChecksum) {
+    error = "header checksum mismatch";
+    return false;
+  }
+
+  CStatsCacheLayout layout = statsCacheLayout(Header_->RecordsNum, Header_->NamesNum, Header_->NamesSize);
+  if (layout.Size != File_.size()) {
+    error = "invalid file size";
+    return false;
+  }
+
+  if (crc32c(0, data + sizeof(CStatsCacheHeader), layout.Size - sizeof(CStatsCacheHeader)) != Header_->DataChecksum) {
+    error = "data checksum mismatch";
+    return false;
+  }
+
+  NameOffsets_ = reinterpret_cast<const uint32_t*>(data + layout.NameOffsets);
+  Names_ = reinterpret_cast<const char*>(data + layout.Names);
+  LastShareTime_ = reinterpret_cast<const int64_t*>(data + layout.LastShareTime);
+  ShareWork_ = reinterpret_cast<const double*>(data + layout.ShareWork);
+  ShareCount_ = reinterpret_cast<const uint64_t*>(data + layout.ShareCount);
+  Login_ = reinterpret_cast<const uint32_t*>(data + layout.Login);
+  WorkerId_ = reinterpret_cast<const uint32_t*>(data + layout.WorkerId);
+  PrimePOWTarget_ = reinterpret_cast<const uint32_t*>(data + layout.PrimePOWTarget);
+
+  // Checksum protects from corruption, not from writer bugs: check dictionary before use
+  if (NameOffsets_[0] != 0 || NameOffsets_[Header_->NamesNum] != Header_->NamesSize) {
+    error = "invalid names dictionary";
+    return false;
+  }
+  for (uint32_t i = 0; i < Header_->NamesNum; i++) {
+    if (NameOffsets_[i] > NameOffsets_[i + 1]) {
+      error = "invalid names dictionary";
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < Header_->RecordsNum; i++) {
+    if (Login_[i] >= Header_->NamesNum || WorkerId_[i] >= Header_->NamesNum) {
+      error = "invalid name index";
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -5,7 +5,18 @@
 
 #include "poolcore/thread.h"
 #include <asyncio/asyncioTypes.h>
+#include "loguru.hpp"
 #include <atomic>
+#include <set>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
  
 static std::atomic<unsigned> threadCounter = 0;
 // Use 8-byte aligned TLS
@@ -31,3 +42,80 @@ void SetLocalThreadId(unsigned threadId)
 {
   localThreadId = threadId;
 }
+
+bool SetCurrentThreadAffinity(const std::vector<unsigned> &cpus)
+{
+  if (cpus.empty())
+    return true;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu: cpus) {
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+int GetCpuNumaNode(unsigned cpu)
+{
+#ifdef __linux__
+  // cpu directory contains 'nodeN' link
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+  DIR *dir = opendir(path);
+  if (!dir)
+    return -1;
+
+  int node = -1;
+  while (struct dirent *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+
+  closedir(dir);
+  return node;
+#else
+  return -1;
+#endif
+}
+
+void ReportThreadTopology(const char *name)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    return;
+
+  std::string cpuList;
+  std::set<int> nodes;
+  unsigned cpusNum = 0;
+  for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &set))
+      continue;
+    if (!cpuList.empty())
+      cpuList.push_back(',');
+    cpuList.append(std::to_string(cpu));
+    nodes.insert(GetCpuNumaNode(cpu));
+    cpusNum++;
+  }
+
+  std::string nodeList;
+  for (int node: nodes) {
+    if (!nodeList.empty())
+      nodeList.push_back(',');
+    nodeList.append(node >= 0 ? std::to_string(node) : "?");
+  }
+
+  LOG_F(INFO, "topology: %s tid=%u running on cpu %i; allowed %u cpus [%s], NUMA nodes [%s]", name, GetGlobalThreadId(), sched_getcpu(), cpusNum, cpuList.c_str(), nodeList.c_str());
+#else
+  LOG_F(INFO, "topology: %s tid=%u (affinity not supported)", name, GetGlobalThreadId());
+#endif
+}
@@ -303,8 +303,10 @@ bool UserManager::acceptFeePlanRecord(const UserFeePlanRecord &record, std::stri
   for (const auto &specificFee: record.CoinSpecificFee)
     plan.CoinSpecificFee[specificFee.CoinName] = specificFee.Config;
 
+  updateLinkedFeePlans(record.FeePlanId, plan);
   FeePlanCache_.erase(record.FeePlanId);
   FeePlanCache_.insert(std::make_pair(record.FeePlanId, plan));
+  FeeConfigVersion_.fetch_add(1, std::memory_order_release);
 
   LOG_F(INFO, "UserManager: accepted fee plan %s", record.FeePlanId.c_str());
   LOG_F(INFO, " * default: %s", feeConfigToString(record.Default).c_str());
@@ -330,20 +332,55 @@ void UserManager::buildFeePlanRecord(const std::string &feePlanId, const FeePlan
   std::sort(result.CoinSpecificFee.begin(), result.CoinSpecificFee.end(), [](const CoinSpecificFeeRecord2 &l, const CoinSpecificFeeRecord2 &r) { return l.CoinName < r.CoinName; });
 }
 
-void UserManager::collectLinkedFeePlans(const std::string &userId, std::unordered_set<std::string> &plans)
+void UserManager::updateLinkedFeePlans(const std::string &feePlanId, const FeePlan &plan)
 {
-  for (const auto &plan: FeePlanCache_) {
-    for (const auto &pair: plan.second.Default) {
-      if (pair.UserId == userId)
-        plans.insert(plan.first);
+  auto collectUsers = [](const FeePlan &plan, std::unordered_set<std::string> &users) {
+    for (const auto &pair: plan.Default)
+      users.insert(pair.UserId);
+    for (const auto &coin: plan.CoinSpecificFee) {
+      for (const auto &pair: coin.second)
+        users.insert(pair.UserId);
     }
-    for (const auto &coin: plan.second.CoinSpecificFee) {
-      for (const auto &pair: coin.second) {
-        if (pair.UserId == userId)
-          plans.insert(plan.first);
-      }
+  };
+
+  std::unordered_set<std::string> oldUsers;
+  std::unordered_set<std::string> newUsers;
+  {
+    decltype (FeePlanCache_)::const_accessor accessor;
+    if (FeePlanCache_.find(accessor, feePlanId))
+      collectUsers(accessor->second, oldUsers);
+  }
+  collectUsers(plan, newUsers);
+
+  for (const auto &userId: oldUsers) {
+    if (newUsers.count(userId))
+      continue;
+    decltype (UserLinkedFeePlans_)::accessor accessor;
+    if (UserLinkedFeePlans_.find(accessor, userId)) {
+      accessor->second.erase(feePlanId);
+      if (accessor->second.empty())
+        UserLinkedFeePlans_.erase(accessor);
     }
   }
+
+  for (const auto &userId: newUsers) {
+    decltype (UserLinkedFeePlans_)::accessor accessor;
+    UserLinkedFeePlans_.insert(accessor, userId);
+    accessor->second.insert(feePlanId);
+  }
+}
+
+void UserManager::collectLinkedFeePlans(const std::string &userId, std::unordered_set<std::string> &plans)
+{
+  decltype (UserLinkedFeePlans_)::const_accessor accessor;
+  if (UserLinkedFeePlans_.find(accessor, userId))
+    plans.insert(accessor->second.begin(), accessor->second.end());
+}
+
+bool UserManager::isLinkedFeePlan(const std::string &userId, const std::string &feePlanId)
+{
+  decltype (UserLinkedFeePlans_)::const_accessor accessor;
+  return UserLinkedFeePlans_.find(accessor, userId) && accessor->second.count(feePlanId);
 }
 
 void UserManager::userManagerMain()
@@ -393,7 +430,10 @@ void UserManager::userManagerCleanup()
           if (UsersCache_.find(accessor, action.second.Login)) {
             AllEmails_.erase(accessor->second.EMail);
             UsersDb_.deleteRow(accessor->second);
+            bool hasFeePlan = !accessor->second.FeePlanId.empty() && accessor->second.FeePlanId != "default";
             UsersCache_.erase(accessor);
+            if (hasFeePlan)
+              FeeConfigVersion_.fetch_add(1, std::memory_order_release);
             usersDeletedCount++;
           }
         }
@@ -685,6 +725,10 @@ void UserManager::userCreateImpl(const std::string &login, Credentials &credenti
     return;
   }
 
+  // Unknown user had default fee plan
+  if (feePlan != "default")
+    FeeConfigVersion_.fetch_add(1, std::memory_order_release);
+
   if (!credentials.IsActive) {
     if (SMTP.Enabled) {
       HostAddress localAddress;
@@ -1070,6 +1114,8 @@ void UserManager::changeFeePlanImpl(const std::string &sessionId, const std::str
     record = accessor->second;
   }
 
+  FeeConfigVersion_.fetch_add(1, std::memory_order_release);
+
   UsersDb_.put(record);
   callback("ok");
 }
@@ -1223,14 +1269,18 @@ bool UserManager::validateSession(const std::string &id, const std::string &targ
       return true;
     }
   } else if (!targetLogin.empty()) {
-    std::unordered_set<std::string> linkedFeePlans;
-    collectLinkedFeePlans(resultLogin, linkedFeePlans);
-
-    decltype (UsersCache_)::const_accessor accessor;
-    if (!UsersCache_.find(accessor, targetLogin))
+    if (needWriteAccess)
       return false;
 
-    if (linkedFeePlans.count(accessor->second.FeePlanId) && !needWriteAccess) {
+    std::string targetFeePlan;
+    {
+      decltype (UsersCache_)::const_accessor accessor;
+      if (!UsersCache_.find(accessor, targetLogin))
+        return false;
+      targetFeePlan = accessor->second.FeePlanId;
+    }
+
+    if (isLinkedFeePlan(resultLogin, targetFeePlan)) {
       resultLogin = targetLogin;
       return true;
     } else {
@@ -1318,6 +1368,38 @@ bool UserManager::enumerateFeePlan(const std::string &sessionId, std::string &st
   return true;
 }
 
+bool UserManager::setTraceSettings(const std::string &sessionId, const CTraceSettings &settings, std::string &status)
+{
+  std::string login;
+  if (!validateSession(sessionId, "", login, true) || login != "admin") {
+    status = "unknown_id";
+    return false;
+  }
+
+  std::string error;
+  if (!traceConfigure(settings, error)) {
+    LOG_F(WARNING, "Can't apply trace settings: %s", error.c_str());
+    status = "invalid_trace_settings";
+    return false;
+  }
+
+  status = "ok";
+  return true;
+}
+
+bool UserManager::getTraceStatus(const std::string &sessionId, std::string &status, CTraceStatus &result)
+{
+  std::string login;
+  if (!validateSession(sessionId, "", login, false) || login != "admin") {
+    status = "unknown_id";
+    return false;
+  }
+
+  traceGetStatus(result);
+  status = "ok";
+  return true;
+}
+
 UserManager::UserFeeConfig UserManager::getFeeRecord(const std::string &feePlanId, const std::string &coin)
 {
   decltype (FeePlanCache_)::const_accessor accessor;
@@ -1,4 +1,5 @@
 #include "poolinstances/fabric.h"
+#include "poolinstances/prometheus.h"
 #include "poolinstances/stratum.h"
 #include "poolinstances/zmq.h"
 
@@ -19,7 +20,8 @@ std::unordered_map<std::string, PoolInstanceFabric::NewPoolInstanceFunction> Poo
   {"ETH.stratum", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new StratumInstance<ETH::X>(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }},
   {"LTC.stratum", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new StratumInstance<LTC::X>(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }},
   {"ZEC.stratum", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new StratumInstance<ZEC::X>(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }},
-  {"XPM.zmq", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new ZmqInstance<XPM::X>(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }}
+  {"XPM.zmq", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new ZmqInstance<XPM::X>(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }},
+  {"metrics.prometheus", [](asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend*> &linkedBackends, CThreadPool &pool, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config) { return new PrometheusInstance(base, userMgr, linkedBackends, pool, instanceId, instancesNum, config); }}
 };
 
 CPoolInstance *PoolInstanceFabric::get(asyncBase *base, UserManager &userMgr, const std::vector<PoolBackend *> &linkedBackends, CThreadPool &pool, const std::string &type, const std::string &protocol, unsigned instanceId, unsigned instancesNum, rapidjson::Value &config)
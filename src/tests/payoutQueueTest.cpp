@@ -0,0 +1,85 @@
+// Payout queue journal: short write in the middle of flush must not lose records appended after it
+// Short write injected by file size limit (RLIMIT_FSIZE with SIGXFSZ ignored)
+
+#include "poolcore/payoutQueue.h"
+#include <filesystem>
+#include <string>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static bool setFileSizeLimit(rlim_t limit)
+{
+  struct rlimit value;
+  if (getrlimit(RLIMIT_FSIZE, &value) != 0)
+    return false;
+  value.rlim_cur = limit;
+  return setrlimit(RLIMIT_FSIZE, &value) == 0;
+}
+
+static void pushRecords(CPayoutQueue &queue, unsigned from, unsigned count)
+{
+  // Long user names, so journal frame is much bigger than allowed tail
+  for (unsigned i = from; i < from + count; i++)
+    queue.push(PayoutDbRecord("user" + std::to_string(i) + std::string(64, 'x'), 1000 + i));
+}
+
+int main()
+{
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / ("payoutQueueTest-" + std::to_string(getpid()));
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  std::filesystem::path journalPath = directory / "payouts.journal";
+  std::filesystem::path legacyPath = directory / "payouts.raw";
+  signal(SIGXFSZ, SIG_IGN);
+
+  int result = 0;
+  {
+    CPayoutQueue queue;
+    if (!queue.open(journalPath, legacyPath)) {
+      fprintf(stderr, "can't open journal\n");
+      return 1;
+    }
+
+    pushRecords(queue, 0, 3);
+    queue.flush();
+    size_t journalSize = std::filesystem::file_size(journalPath);
+
+    // Flush writes only part of frames, retry and snapshot rewrite fail too
+    if (!setFileSizeLimit(journalSize + 32)) {
+      fprintf(stderr, "can't set file size limit\n");
+      return 1;
+    }
+    pushRecords(queue, 3, 10);
+    queue.flush();
+    setFileSizeLimit(RLIM_INFINITY);
+
+    if (std::filesystem::file_size(journalPath) != journalSize) {
+      fprintf(stderr, "torn frame left in journal: size %zu, expected %zu\n", static_cast<size_t>(std::filesystem::file_size(journalPath)), journalSize);
+      result = 1;
+    }
+
+    // Changes of failed flush written with next one
+    pushRecords(queue, 13, 1);
+    queue.flush();
+  }
+
+  {
+    CPayoutQueue queue;
+    if (!queue.open(journalPath, legacyPath)) {
+      fprintf(stderr, "can't reopen journal\n");
+      return 1;
+    }
+
+    if (queue.size() != 14 || queue.totalValue() != 14*1000 + 13*14/2) {
+      fprintf(stderr, "replayed %zu records with total value %lli, expected 14 records\n", queue.size(), static_cast<long long>(queue.totalValue()));
+      result = 1;
+    }
+  }
+
+  std::filesystem::remove_all(directory);
+  if (result == 0)
+    printf("payout queue journal ok\n");
+  return result;
+}
@@ -0,0 +1,74 @@
+// Statistic queries served by query thread pool of statistic server: callbacks must run in pool thread
+// (named "workerN"), not in statistic server thread (named as coin)
+
+#include "poolcore/statistics.h"
+#include "loguru.hpp"
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <stdio.h>
+#include <unistd.h>
+
+static std::string threadName()
+{
+  char name[64];
+  loguru::get_thread_name(name, sizeof(name), false);
+  return name;
+}
+
+int main()
+{
+  loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / ("queryThreadPoolTest-" + std::to_string(getpid()));
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  PoolBackendConfig config;
+  config.isMaster = true;
+  config.dbPath = directory;
+  config.QueryThreadsNum = 1;
+  CCoinInfo coinInfo;
+  coinInfo.Name = "TEST";
+
+  int result = 0;
+  {
+    asyncBase *base = createAsyncBase(amOSDefault);
+    StatisticServer server(base, config, coinInfo);
+    server.start();
+
+    std::promise<std::string> poolStats;
+    server.statisticDb()->queryPoolStats([&poolStats](const StatisticDb::CStats&) {
+      poolStats.set_value(threadName());
+    });
+
+    // Unknown user, empty page expected
+    std::promise<std::string> userStats;
+    server.statisticDb()->queryUserStats("user", [&userStats](const StatisticDb::CStats&, const std::vector<StatisticDb::CStats> &workers) {
+      userStats.set_value(workers.empty() ? threadName() : std::string("unexpected workers"));
+    }, 0, 10, StatisticDb::EStatsColumnName, false);
+
+    std::future<std::string> poolStatsThread = poolStats.get_future();
+    std::future<std::string> userStatsThread = userStats.get_future();
+    if (poolStatsThread.wait_for(std::chrono::seconds(10)) != std::future_status::ready ||
+        userStatsThread.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+      fprintf(stderr, "query callbacks not called\n");
+      result = 1;
+    } else {
+      for (const std::string &name: {poolStatsThread.get(), userStatsThread.get()}) {
+        if (name.compare(0, 6, "worker") != 0) {
+          fprintf(stderr, "query served by thread '%s', not by query thread pool\n", name.c_str());
+          result = 1;
+        }
+      }
+    }
+
+    server.stop();
+  }
+
+  std::filesystem::remove_all(directory);
+  if (result == 0)
+    printf("query thread pool ok\n");
+  return result;
+}